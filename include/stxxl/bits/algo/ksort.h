@@ -38,6 +38,7 @@
 #include <stxxl/bits/algo/run_cursor.h>
 #include <stxxl/bits/algo/sort_base.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/huge_page_arena.h>
 #include <stxxl/bits/common/is_sorted.h>
 
 //#define INTERLEAVED_ALLOC
@@ -199,11 +200,14 @@ create_runs(
     using request_ptr = foxxll::request_ptr;
 
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-    BlockType* Blocks1 = new BlockType[m2];
-    BlockType* Blocks2 = new BlockType[m2];
+    // both run buffers and the key references are taken from the arena
+    huge_page_array<BlockType> blocks(2 * m2);
+    BlockType* Blocks1 = blocks.data();
+    BlockType* Blocks2 = Blocks1 + m2;
     bid_type* bids = new bid_type[m2];
-    type_key_* refs1 = new type_key_[m2 * Blocks1->size];
-    type_key_* refs2 = new type_key_[m2 * Blocks1->size];
+    huge_page_array<type_key_> refs(2 * m2 * BlockType::size);
+    type_key_* refs1 = refs.data();
+    type_key_* refs2 = refs1 + m2 * BlockType::size;
     request_ptr* read_reqs = new request_ptr[m2];
     request_ptr* write_reqs = new request_ptr[m2];
     write_completion_handler<BlockType, bid_type>* next_run_reads =
@@ -295,10 +299,6 @@ create_runs(
 
     delete[] bucket1;
     delete[] bucket2;
-    delete[] refs1;
-    delete[] refs2;
-    delete[] Blocks1;
-    delete[] Blocks2;
     delete[] bids;
     delete[] next_run_reads;
     delete[] read_reqs;
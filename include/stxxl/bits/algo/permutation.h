@@ -0,0 +1,417 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/permutation.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_PERMUTATION_HEADER
+#define STXXL_ALGO_PERMUTATION_HEADER
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger.hpp>
+#include <tlx/meta/call_foreach.hpp>
+#include <tlx/simple_vector.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/stream/stream.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*! \internal
+ */
+namespace permutation_local {
+
+//! Element sorted by sort_permutation() instead of the (large) record.
+template <typename KeyType, typename IndexType>
+struct key_index_pair
+{
+    KeyType key;
+    IndexType index;
+};
+
+//! Orders key_index_pair by key and breaks ties by position. This makes the
+//! resulting permutation stable. The sentinels are derived from the record
+//! sentinels of the key extractor.
+template <typename KeyType, typename IndexType>
+class key_index_cmp
+{
+public:
+    using value_type = key_index_pair<KeyType, IndexType>;
+
+    key_index_cmp(const KeyType& min_key, const KeyType& max_key)
+    {
+        m_min.key = min_key;
+        m_min.index = std::numeric_limits<IndexType>::min();
+        m_max.key = max_key;
+        m_max.index = std::numeric_limits<IndexType>::max();
+    }
+
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        if (a.key < b.key) return true;
+        if (b.key < a.key) return false;
+        return a.index < b.index;
+    }
+
+    value_type min_value() const { return m_min; }
+    value_type max_value() const { return m_max; }
+
+private:
+    value_type m_min, m_max;
+};
+
+//! Orders key_index_pair by a comparator on the keys and breaks ties by
+//! position, used by sort_columns(). The sentinels are derived from the
+//! comparator's sentinels.
+template <typename KeyType, typename IndexType, typename CompareType>
+class key_index_cmp_adapter
+{
+public:
+    using value_type = key_index_pair<KeyType, IndexType>;
+
+    explicit key_index_cmp_adapter(const CompareType& cmp)
+        : m_cmp(cmp)
+    { }
+
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        if (m_cmp(a.key, b.key)) return true;
+        if (m_cmp(b.key, a.key)) return false;
+        return a.index < b.index;
+    }
+
+    value_type min_value() const
+    {
+        value_type v;
+        v.key = m_cmp.min_value();
+        v.index = std::numeric_limits<IndexType>::min();
+        return v;
+    }
+
+    value_type max_value() const
+    {
+        value_type v;
+        v.key = m_cmp.max_value();
+        v.index = std::numeric_limits<IndexType>::max();
+        return v;
+    }
+
+private:
+    CompareType m_cmp;
+};
+
+} // namespace permutation_local
+
+/*!
+ * Computes the sorted order of records without moving the records.
+ *
+ * stxxl::sort_permutation extracts (key, position) pairs from the range
+ * [first, last), sorts only these pairs and writes the positions in sorted key
+ * order into \c out_index_vector, which is resized to <tt>last - first</tt>
+ * elements. Positions are relative to \c first. Records with equal keys keep
+ * their relative order, i.e. the permutation is stable.
+ *
+ * For large records this moves only <tt>sizeof(key) + sizeof(index)</tt>
+ * bytes per record through the sorter. The records can later be gathered
+ * with stxxl::apply_permutation().
+ *
+ * \param first object of model of \c ext_random_access_iterator concept
+ * \param last object of model of \c ext_random_access_iterator concept
+ * \param keyobj \link design_algo_ksort_key_extractor key extractor \endlink object
+ * \param out_index_vector \c stxxl::vector of an unsigned integral type receiving the permutation
+ * \param M amount of memory for internal use (in bytes)
+ */
+template <typename ExtIterator, typename KeyExtractorWithMinMax, typename IndexVector>
+void sort_permutation(ExtIterator first, ExtIterator last,
+                      KeyExtractorWithMinMax keyobj,
+                      IndexVector& out_index_vector, size_t M)
+{
+    using key_type = typename KeyExtractorWithMinMax::key_type;
+    using index_type = typename IndexVector::value_type;
+    using pair_type = permutation_local::key_index_pair<key_type, index_type>;
+    using pair_cmp_type = permutation_local::key_index_cmp<key_type, index_type>;
+    using pair_sorter_type = stxxl::sorter<pair_type, pair_cmp_type>;
+    using input_stream_type = typename stream::streamify_traits<ExtIterator>::stream_type;
+
+    const typename IndexVector::size_type n = last - first;
+    out_index_vector.resize(n);
+
+    if (n == 0)
+        return;
+
+    pair_cmp_type cmp(keyobj(keyobj.min_value()), keyobj(keyobj.max_value()));
+    pair_sorter_type pair_sorter(cmp, M);
+
+    {
+        input_stream_type in(first, last);
+
+        for (index_type i = 0; !in.empty(); ++in, ++i)
+        {
+            pair_type p;
+            p.key = keyobj(*in);
+            p.index = i;
+            pair_sorter.push(p);
+        }
+    }
+
+    pair_sorter.sort();
+
+    typename IndexVector::bufwriter_type writer(out_index_vector.begin());
+    for ( ; !pair_sorter.empty(); ++pair_sorter)
+        writer << pair_sorter->index;
+
+    writer.finish();
+}
+
+/*!
+ * Gathers records in the order given by a permutation.
+ *
+ * stxxl::apply_permutation writes <tt>*(first + perm[i])</tt> to
+ * <tt>out + i</tt> for every position \c i of the permutation range
+ * [perm_first, perm_last), e.g. as computed by stxxl::sort_permutation(). The
+ * permutation is processed in batches that fit into \c M bytes. For each batch
+ * the distinct source blocks are read in ascending block order, \a 2D blocks
+ * at a time, and each block is read at most once per batch.
+ *
+ * The output range must not overlap the source range.
+ *
+ * \param first object of model of \c ext_random_access_iterator concept, source records
+ * \param last object of model of \c ext_random_access_iterator concept, end of source records
+ * \param perm_first object of model of \c ext_random_access_iterator concept, begin of permutation
+ * \param perm_last object of model of \c ext_random_access_iterator concept, end of permutation
+ * \param out \c stxxl::vector iterator receiving the gathered records
+ * \param M amount of memory for internal use (in bytes)
+ * \return iterator pointing beyond the last written record
+ */
+template <typename ExtIterator, typename IndexExtIterator, typename OutExtIterator>
+OutExtIterator apply_permutation(ExtIterator first, ExtIterator last,
+                                 IndexExtIterator perm_first, IndexExtIterator perm_last,
+                                 OutExtIterator out, size_t M)
+{
+    constexpr bool debug = false;
+
+    using value_type = typename ExtIterator::value_type;
+    using block_type = typename ExtIterator::block_type;
+    using index_type = typename IndexExtIterator::value_type;
+    using gather_entry = std::pair<index_type, size_t>;
+    using bufwriter_type = typename OutExtIterator::vector_type::bufwriter_type;
+
+    const size_t nperm = static_cast<size_t>(perm_last - perm_first);
+    if (nperm == 0)
+        return out;
+
+    const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+
+    if (M < 2 * nbuffers * block_type::raw_size) {
+        throw foxxll::bad_parameter(
+                  "stxxl::apply_permutation(): INSUFFICIENT MEMORY provided, please increase parameter 'M'");
+    }
+
+    // the remaining memory holds the gathered records and the sorted requests
+    const size_t batch_size = std::min(
+        nperm, std::max<size_t>(
+            1, (M - nbuffers * block_type::raw_size)
+            / (sizeof(value_type) + sizeof(gather_entry))));
+
+    LOG << "apply_permutation() nperm=" << nperm << " batch_size=" << batch_size;
+
+    typename ExtIterator::const_iterator(first).flush();
+
+    tlx::simple_vector<value_type> batch(batch_size);
+    std::vector<gather_entry> entries;
+    entries.reserve(batch_size);
+
+    tlx::simple_vector<block_type> blocks(nbuffers);
+    std::vector<foxxll::request_ptr> reqs(nbuffers);
+
+    auto perm = stream::streamify(perm_first, perm_last);
+    bufwriter_type writer(out);
+
+    while (!perm.empty())
+    {
+        // fetch next batch of permutation entries, sort them by source position
+        entries.clear();
+        for (size_t i = 0; i < batch_size && !perm.empty(); ++i, ++perm)
+        {
+            assert(static_cast<size_t>(*perm) < static_cast<size_t>(last - first));
+            entries.emplace_back(*perm, i);
+        }
+        std::sort(entries.begin(), entries.end());
+
+        auto e = entries.begin();
+        while (e != entries.end())
+        {
+            // issue reads for the next nbuffers distinct source blocks
+            auto group_end = e;
+            size_t nblocks = 0;
+            auto prev_bid = (first + e->first).bid();
+
+            for ( ; group_end != entries.end(); ++group_end)
+            {
+                auto bid = (first + group_end->first).bid();
+                if (nblocks == 0 || bid != prev_bid)
+                {
+                    if (nblocks == nbuffers)
+                        break;
+                    reqs[nblocks] = blocks[nblocks].read(*bid);
+                    prev_bid = bid;
+                    ++nblocks;
+                }
+            }
+
+            wait_all(reqs.data(), nblocks);
+
+            // scatter the requested records into the batch buffer
+            size_t k = 0;
+            prev_bid = (first + e->first).bid();
+            for ( ; e != group_end; ++e)
+            {
+                const ExtIterator src = first + e->first;
+                if (src.bid() != prev_bid) {
+                    prev_bid = src.bid();
+                    ++k;
+                }
+                batch[e->second] = blocks[k][src.block_offset()];
+            }
+            assert(k + 1 == nblocks);
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i)
+            writer << batch[i];
+    }
+
+    writer.finish();
+
+    return out + nperm;
+}
+
+/*!
+ * Sorts a table stored as separate column vectors by its key column.
+ *
+ * stxxl::sort_columns sorts (key, row) pairs of \c key_column, writes the
+ * sorted keys back to \c key_column and then gathers each payload column
+ * into the sorted row order with stxxl::apply_permutation(), one column after
+ * another. Only the key column takes part in the comparisons, and each
+ * payload column is read and written once in addition to the permutation.
+ * Rows with equal keys keep their relative order.
+ *
+ * All columns must be \c stxxl::vector instances of equal size. The payload
+ * columns are replaced by sorted copies, invalidating their iterators, except
+ * for file-backed columns, into which the sorted copy is written back. If the
+ * sizes differ or \c M is too small to gather a payload column, all columns
+ * are left unchanged.
+ *
+ * \param key_column \c stxxl::vector of keys
+ * \param cmp comparison object with min_value() and max_value() sentinels, see \c stxxl::sort
+ * \param M amount of memory for internal use (in bytes)
+ * \param payload_columns \c stxxl::vector instances permuted like the key column
+ */
+template <typename KeyVector, typename CompareType, typename... PayloadVectors>
+void sort_columns(KeyVector& key_column, CompareType cmp, size_t M,
+                  PayloadVectors& ... payload_columns)
+{
+    using key_type = typename KeyVector::value_type;
+    using index_type = external_size_type;
+    using index_vector_type = stxxl::vector<index_type>;
+    using pair_type = permutation_local::key_index_pair<key_type, index_type>;
+    using pair_cmp_type = permutation_local::key_index_cmp_adapter<
+              key_type, index_type, CompareType>;
+    using pair_sorter_type = stxxl::sorter<pair_type, pair_cmp_type>;
+
+    const external_size_type n = key_column.size();
+
+    tlx::call_foreach(
+        [n](const auto& column) {
+            if (column.size() != n)
+                throw foxxll::bad_parameter(
+                          "stxxl::sort_columns(): all columns must have the same size");
+        },
+        payload_columns ...);
+
+    if (n == 0)
+        return;
+
+    // fail before the key column is overwritten
+    const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+    tlx::call_foreach(
+        [M, nbuffers](const auto& column) {
+            using column_type = typename std::decay<decltype(column)>::type;
+            if (M < 2 * nbuffers * column_type::block_type::raw_size)
+                throw foxxll::bad_parameter(
+                          "stxxl::sort_columns(): INSUFFICIENT MEMORY provided, please increase parameter 'M'");
+        },
+        payload_columns ...);
+
+    index_vector_type perm(n);
+    {
+        pair_sorter_type pair_sorter(pair_cmp_type(cmp), M);
+        {
+            typename KeyVector::bufreader_type reader(key_column);
+            for (index_type i = 0; !reader.empty(); ++reader, ++i)
+            {
+                pair_type p;
+                p.key = *reader;
+                p.index = i;
+                pair_sorter.push(p);
+            }
+        }
+
+        pair_sorter.sort();
+
+        // the key column is overwritten with the sorted keys
+        typename KeyVector::bufwriter_type key_writer(key_column.begin());
+        typename index_vector_type::bufwriter_type perm_writer(perm.begin());
+        for ( ; !pair_sorter.empty(); ++pair_sorter)
+        {
+            key_writer << pair_sorter->key;
+            perm_writer << pair_sorter->index;
+        }
+        key_writer.finish();
+        perm_writer.finish();
+    }
+
+    tlx::call_foreach(
+        [&perm, M](auto& column) {
+            using column_type = typename std::decay<decltype(column)>::type;
+            column_type sorted(column.size());
+            apply_permutation(column.cbegin(), column.cend(),
+                              perm.cbegin(), perm.cend(), sorted.begin(), M);
+
+            if (!column.get_file()) {
+                column.swap(sorted);
+                return;
+            }
+
+            // a file-backed column keeps its file, the sorted copy is
+            // written back into it
+            typename column_type::bufreader_type reader(sorted);
+            typename column_type::bufwriter_type writer(column.begin());
+            for ( ; !reader.empty(); ++reader)
+                writer << *reader;
+            writer.finish();
+        },
+        payload_columns ...);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_PERMUTATION_HEADER
@@ -0,0 +1,428 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/prefix_scan.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_PREFIX_SCAN_HEADER
+#define STXXL_ALGO_PREFIX_SCAN_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_ostream.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/algo/scan.h>
+#include <stxxl/bits/parallel.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*! \internal
+ */
+namespace prefix_scan_local {
+
+/*!
+ * A scan is described by a scanner: each element x is lifted to a state,
+ * states are combined by an associative operation, and the output replacing x
+ * is derived from the states before and after x. The state before the first
+ * element is absent, unless an initial value is given.
+ */
+template <typename ValueType, typename BinaryOperation>
+class inclusive_scanner
+{
+    BinaryOperation m_op;
+
+public:
+    using value_type = ValueType;
+    using state_type = ValueType;
+
+    explicit inclusive_scanner(BinaryOperation op) : m_op(op) { }
+
+    state_type lift(const value_type& x) { return x; }
+
+    state_type combine(const state_type& a, const state_type& b)
+    {
+        return m_op(a, b);
+    }
+
+    value_type output(const state_type* /* before */, const state_type& after)
+    {
+        return after;
+    }
+};
+
+//! Scanner replacing each element by the combination of all preceding ones.
+template <typename ValueType, typename BinaryOperation>
+class exclusive_scanner : public inclusive_scanner<ValueType, BinaryOperation>
+{
+public:
+    using value_type = ValueType;
+    using state_type = ValueType;
+
+    explicit exclusive_scanner(BinaryOperation op)
+        : inclusive_scanner<ValueType, BinaryOperation>(op) { }
+
+    value_type output(const state_type* before, const state_type& /* after */)
+    {
+        assert(before);
+        return *before;
+    }
+};
+
+//! Scanner restarting the inclusive scan at each element for which the
+//! predicate holds. The state carries whether a segment starts within it.
+template <typename ValueType, typename BinaryOperation, typename Predicate>
+class segmented_scanner
+{
+    BinaryOperation m_op;
+    Predicate m_is_segment_start;
+
+public:
+    using value_type = ValueType;
+    using state_type = std::pair<bool, ValueType>;
+
+    segmented_scanner(BinaryOperation op, Predicate is_segment_start)
+        : m_op(op), m_is_segment_start(is_segment_start) { }
+
+    state_type lift(const value_type& x)
+    {
+        return state_type(m_is_segment_start(x), x);
+    }
+
+    state_type combine(const state_type& a, const state_type& b)
+    {
+        if (b.first)
+            return b;
+        return state_type(a.first, m_op(a.second, b.second));
+    }
+
+    value_type output(const state_type* /* before */, const state_type& after)
+    {
+        return after.second;
+    }
+};
+
+//! Function object for stxxl::for_each_m() replacing each element by the
+//! output of the scanner and carrying the state to the next element.
+template <typename Scanner>
+class scan_functor
+{
+public:
+    using value_type = typename Scanner::value_type;
+    using state_type = typename Scanner::state_type;
+
+    //! start without a state before the first element
+    explicit scan_functor(Scanner scanner)
+        : m_scanner(scanner), m_has_carry(false), m_carry() { }
+
+    //! start with the given state before the first element
+    scan_functor(Scanner scanner, const state_type& init)
+        : m_scanner(scanner), m_has_carry(true), m_carry(init) { }
+
+    void operator () (value_type& x)
+    {
+        state_type after = m_has_carry
+                           ? m_scanner.combine(m_carry, m_scanner.lift(x))
+                           : m_scanner.lift(x);
+        x = m_scanner.output(m_has_carry ? &m_carry : nullptr, after);
+        m_carry = after;
+        m_has_carry = true;
+    }
+
+    //! append the state of a range of elements to the carry
+    void add(const state_type& s)
+    {
+        m_carry = m_has_carry ? m_scanner.combine(m_carry, s) : s;
+        m_has_carry = true;
+    }
+
+    Scanner scanner() const { return m_scanner; }
+
+    bool has_carry() const { return m_has_carry; }
+
+    const state_type& carry() const { return m_carry; }
+
+private:
+    Scanner m_scanner;
+    bool m_has_carry;
+    state_type m_carry;
+};
+
+//! Combines the lifted states of all elements of the (non-empty) complete
+//! blocks [bid_begin, bid_end).
+template <typename BlockType, typename BidIterator, typename Scanner>
+typename Scanner::state_type
+reduce_blocks(BidIterator bid_begin, BidIterator bid_end,
+              Scanner scanner, size_t nbuffers)
+{
+    using buf_istream_type = foxxll::buf_istream<BlockType, BidIterator>;
+
+    assert(bid_begin != bid_end);
+    const size_t n = static_cast<size_t>(bid_end - bid_begin) * BlockType::size;
+
+    buf_istream_type in(bid_begin, bid_end, nbuffers);
+
+    typename Scanner::state_type s = scanner.lift(*in);
+    ++in;
+    for (size_t i = 1; i < n; ++i, ++in)
+        s = scanner.combine(s, scanner.lift(*in));
+
+    return s;
+}
+
+//! Applies the scan functor in place to all elements of the complete blocks
+//! [bid_begin, bid_end).
+template <typename BlockType, typename BidIterator, typename Scanner>
+void scan_blocks(BidIterator bid_begin, BidIterator bid_end,
+                 scan_functor<Scanner>& functor, size_t nbuffers)
+{
+    using buf_istream_type = foxxll::buf_istream<BlockType, BidIterator>;
+    using buf_ostream_type = foxxll::buf_ostream<BlockType, BidIterator>;
+
+    const size_t n = static_cast<size_t>(bid_end - bid_begin) * BlockType::size;
+
+    buf_istream_type in(bid_begin, bid_end, nbuffers);
+    buf_ostream_type out(bid_begin, nbuffers);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        typename BlockType::value_type tmp;
+        in >> tmp;
+        functor(tmp);
+        out << tmp;
+    }
+}
+
+/*!
+ * Two pass parallel scan. The complete blocks of the range are split into
+ * nparts parts. The first pass reduces each part concurrently, the carries
+ * into the parts are then combined sequentially, and the second pass rewrites
+ * each part concurrently. The at most two partial blocks at the ends are
+ * scanned sequentially.
+ */
+template <typename ExtIterator, typename Scanner>
+scan_functor<Scanner>
+parallel_scan(ExtIterator begin, ExtIterator end,
+              scan_functor<Scanner> functor, size_t nparts, size_t nbuffers)
+{
+    constexpr bool debug = false;
+
+    using block_type = typename ExtIterator::block_type;
+    using state_type = typename Scanner::state_type;
+
+    const size_t n = static_cast<size_t>(end - begin);
+    const size_t block_size = block_type::size;
+
+    // ranks [0, head) and [tail, n) are not block aligned
+    const size_t head = std::min<size_t>(
+        n, (block_size - begin.block_offset()) % block_size);
+    const size_t nblocks = (n - head) / block_size;
+    const size_t tail = head + nblocks * block_size;
+
+    nparts = std::min(nparts, nblocks);
+
+    std::vector<size_t> rank(nparts + 1);
+    for (size_t k = 0; k <= nparts; ++k)
+        rank[k] = head + block_size * (nblocks * k / nparts);
+
+    LOG << "parallel_scan() n=" << n << " nparts=" << nparts
+        << " head=" << head << " tail=" << n - tail;
+
+    // make all blocks on disk current, the parts bypass the cache
+    begin.flush();
+
+    // lambdas are not assignable, hence functors are only copy constructed
+    const scan_functor<Scanner> head_functor
+        = for_each_m(begin, begin + head, functor, nbuffers);
+
+    std::vector<state_type> partial(nparts);
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+    for (long k = 0; k < static_cast<long>(nparts); ++k)
+    {
+        partial[k] = reduce_blocks<block_type>(
+            (begin + rank[k]).bid(), (begin + rank[k + 1]).bid(),
+            head_functor.scanner(), nbuffers);
+    }
+
+    // carry into each part and behind the last
+    std::vector<scan_functor<Scanner> > parts;
+    parts.reserve(nparts + 1);
+    parts.push_back(head_functor);
+    for (size_t k = 0; k < nparts; ++k)
+    {
+        parts.push_back(parts[k]);
+        parts.back().add(partial[k]);
+    }
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+    for (long k = 0; k < static_cast<long>(nparts); ++k)
+    {
+        scan_blocks<block_type>(
+            (begin + rank[k]).bid(), (begin + rank[k + 1]).bid(),
+            parts[k], nbuffers);
+    }
+
+    return for_each_m(begin + tail, end, parts[nparts], nbuffers);
+}
+
+//! Scans the range [begin, end) in place, in parallel if enabled and the
+//! range contains enough complete blocks.
+template <typename ExtIterator, typename Scanner>
+scan_functor<Scanner>
+scan(ExtIterator begin, ExtIterator end,
+     scan_functor<Scanner> functor, size_t nbuffers)
+{
+    if (nbuffers == 0)
+        nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+
+#if STXXL_PARALLEL
+    const size_t nparts = static_cast<size_t>(omp_get_max_threads());
+    const size_t n = static_cast<size_t>(end - begin);
+
+    if (nparts > 1 && n >= 2 * nparts * ExtIterator::block_type::size)
+        return parallel_scan(begin, end, functor, nparts, nbuffers);
+#endif
+
+    return for_each_m(begin, end, functor, nbuffers);
+}
+
+} // namespace prefix_scan_local
+
+/*!
+ * External equivalent of std::inclusive_scan, computed in place.
+ *
+ * stxxl::inclusive_scan replaces each element of the range [begin, end) by
+ * the combination of itself and all preceding elements of the range using the
+ * associative operation \c op, e.g. by prefix sums with std::plus.
+ *
+ * If parallelism is enabled, the complete blocks of the range are split into
+ * as many parts as there are threads. A first pass reduces all parts
+ * concurrently, then the carries into the parts are combined and a second
+ * pass rewrites all parts concurrently. I/O is overlapped with computation in
+ * both passes. The order in which \c op is applied is unspecified, hence it
+ * must be associative.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param op associative binary function object
+ * \param nbuffers number of buffers (blocks) per stream and thread (should be at least 2*D, or zero for automatic 2*D)
+ */
+template <typename ExtIterator, typename BinaryOperation>
+void inclusive_scan(ExtIterator begin, ExtIterator end,
+                    BinaryOperation op, size_t nbuffers = 0)
+{
+    using scanner_type = prefix_scan_local::inclusive_scanner<
+              typename ExtIterator::value_type, BinaryOperation>;
+
+    prefix_scan_local::scan(
+        begin, end,
+        prefix_scan_local::scan_functor<scanner_type>(scanner_type(op)),
+        nbuffers);
+}
+
+//! External equivalent of std::inclusive_scan with std::plus, computed in
+//! place. See the overload with an operation.
+template <typename ExtIterator>
+void inclusive_scan(ExtIterator begin, ExtIterator end)
+{
+    inclusive_scan(begin, end, std::plus<typename ExtIterator::value_type>());
+}
+
+/*!
+ * External equivalent of std::exclusive_scan, computed in place.
+ *
+ * stxxl::exclusive_scan replaces each element of the range [begin, end) by
+ * the combination of \c init and all preceding elements of the range using
+ * the associative operation \c op. For example, with std::plus and init = 0 it
+ * turns counts into offsets, such as the row pointers of a CSR matrix. The
+ * computation is parallelized like stxxl::inclusive_scan().
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param init value combined in front of the first element
+ * \param op associative binary function object
+ * \param nbuffers number of buffers (blocks) per stream and thread (should be at least 2*D, or zero for automatic 2*D)
+ * \return combination of \c init and all elements of the range, i.e. the
+ *         value which would follow the last element
+ */
+template <typename ExtIterator, typename BinaryOperation>
+typename ExtIterator::value_type
+exclusive_scan(ExtIterator begin, ExtIterator end,
+               typename ExtIterator::value_type init,
+               BinaryOperation op, size_t nbuffers = 0)
+{
+    using scanner_type = prefix_scan_local::exclusive_scanner<
+              typename ExtIterator::value_type, BinaryOperation>;
+
+    return prefix_scan_local::scan(
+        begin, end,
+        prefix_scan_local::scan_functor<scanner_type>(scanner_type(op), init),
+        nbuffers).carry();
+}
+
+//! External equivalent of std::exclusive_scan with std::plus, computed in
+//! place. See the overload with an operation.
+template <typename ExtIterator>
+typename ExtIterator::value_type
+exclusive_scan(ExtIterator begin, ExtIterator end,
+               typename ExtIterator::value_type init)
+{
+    return exclusive_scan(
+        begin, end, init, std::plus<typename ExtIterator::value_type>());
+}
+
+/*!
+ * Segmented inclusive scan, computed in place.
+ *
+ * stxxl::segmented_scan performs an inclusive scan with the associative
+ * operation \c op which restarts at every element for which
+ * \c is_segment_start holds, i.e. each element is replaced by the combination
+ * of itself and all preceding elements of its segment. The predicate is
+ * evaluated on the original values. The computation is parallelized like
+ * stxxl::inclusive_scan(), segments may span parts.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param is_segment_start unary predicate marking the first element of each segment
+ * \param op associative binary function object
+ * \param nbuffers number of buffers (blocks) per stream and thread (should be at least 2*D, or zero for automatic 2*D)
+ */
+template <typename ExtIterator, typename UnaryPredicate, typename BinaryOperation>
+void segmented_scan(ExtIterator begin, ExtIterator end,
+                    UnaryPredicate is_segment_start,
+                    BinaryOperation op, size_t nbuffers = 0)
+{
+    using scanner_type = prefix_scan_local::segmented_scanner<
+              typename ExtIterator::value_type, BinaryOperation, UnaryPredicate>;
+
+    prefix_scan_local::scan(
+        begin, end,
+        prefix_scan_local::scan_functor<scanner_type>(
+            scanner_type(op, is_segment_start)),
+        nbuffers);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_PREFIX_SCAN_HEADER
@@ -61,7 +61,8 @@ UnaryFunction for_each(ExtIterator begin, ExtIterator end,
               typename ExtIterator::bids_container_iterator
               >;
 
-    begin.flush();     // flush container
+    // flush container, reading does not require exclusive blocks
+    typename ExtIterator::const_iterator(begin).flush();
 
     if (nbuffers == 0)
         nbuffers = 2 * foxxll::config::get_instance()->disks_number();
@@ -294,7 +295,8 @@ ExtIterator find(ExtIterator begin, ExtIterator end,
               typename ExtIterator::bids_container_iterator
               >;
 
-    begin.flush();     // flush container
+    // flush container, reading does not require exclusive blocks
+    typename ExtIterator::const_iterator(begin).flush();
 
     if (nbuffers == 0)
         nbuffers = 2 * foxxll::config::get_instance()->disks_number();
@@ -0,0 +1,400 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/set_operations.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SET_OPERATIONS_HEADER
+#define STXXL_ALGO_SET_OPERATIONS_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include <tlx/define.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_ostream.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/parallel.h>
+#include <stxxl/bits/stream/set_operations.h>
+#include <stxxl/bits/stream/stream.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*! \internal
+ */
+namespace set_operations_local {
+
+//! Stream over the range [begin, end) of an external vector which reads the
+//! blocks directly. Unlike stream::vector_iterator2stream it does not flush
+//! the vector, hence several readers may run concurrently once the vector has
+//! been flushed.
+template <typename ExtIterator>
+class block_reader
+{
+    using buf_istream_type = foxxll::buf_istream<
+              typename ExtIterator::block_type,
+              typename ExtIterator::bids_container_iterator>;
+
+    size_t m_remaining;
+    std::unique_ptr<buf_istream_type> m_in;
+
+public:
+    using value_type = typename ExtIterator::value_type;
+
+    block_reader(ExtIterator begin, ExtIterator end, size_t nbuffers)
+        : m_remaining(static_cast<size_t>(end - begin))
+    {
+        if (empty())
+            return;
+
+        typename ExtIterator::bids_container_iterator end_iter
+            = end.bid() + ((end.block_offset()) ? 1 : 0);
+
+        m_in.reset(new buf_istream_type(begin.bid(), end_iter, nbuffers));
+
+        // skip the beginning of the block
+        for (size_t i = 0; i < begin.block_offset(); ++i)
+            ++(*m_in);
+    }
+
+    const value_type& operator * () const
+    {
+        return **m_in;
+    }
+
+    block_reader& operator ++ ()
+    {
+        assert(!empty());
+        --m_remaining;
+        ++(*m_in);
+        if (TLX_UNLIKELY(empty()))
+            m_in.reset();
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_remaining == 0;
+    }
+};
+
+//! Writes the stable merge of two sorted streams to out, which is either an
+//! external vector iterator or a foxxll::buf_ostream.
+template <typename Input1, typename Input2, typename Output, typename Cmp>
+void merge_streams(Input1& in1, Input2& in2, Output& out, Cmp cmp)
+{
+    stream::two_way_merge<Input1, Input2, Cmp> merger(in1, in2, cmp);
+    for ( ; !merger.empty(); ++merger, ++out)
+        *out = *merger;
+}
+
+//! Merges the ranges [first1, last1) and [first2, last2) into out using the
+//! iterators' own caches, for ranges shorter than a block.
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename Cmp>
+void merge_small(ExtIterator1 first1, ExtIterator1 last1,
+                 ExtIterator2 first2, ExtIterator2 last2,
+                 OutExtIterator out, Cmp cmp)
+{
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+    merge_streams(in1, in2, out, cmp);
+}
+
+/*!
+ * Returns the number of elements i taken from the first range among the
+ * first \c rank elements of the stable merge of [first1, first1 + n1) and
+ * [first2, first2 + n2). The remaining rank - i elements come from the second
+ * range. Uses O(log n1) element accesses.
+ */
+template <typename ConstIterator1, typename ConstIterator2, typename Cmp>
+size_t merge_corank(ConstIterator1 first1, size_t n1,
+                    ConstIterator2 first2, size_t n2,
+                    size_t rank, Cmp cmp)
+{
+    size_t lo = (rank > n2) ? rank - n2 : 0;
+    size_t hi = std::min(rank, n1);
+
+    while (lo < hi)
+    {
+        const size_t i = lo + (hi - lo) / 2;
+        const size_t j = rank - i;
+
+        // first1[i] <= first2[j - 1]: first1[i] is among the first rank
+        if (!cmp(*(first2 + (j - 1)), *(first1 + i)))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+
+    return lo;
+}
+
+/*!
+ * Parallel merge of two sorted external ranges. The output is split at
+ * nparts + 1 block aligned ranks, and the input ranges are split at the
+ * corresponding co-ranks. Each part is then merged concurrently, reading and
+ * writing the blocks directly, such that the parts fill disjoint sets of
+ * output blocks and need not be concatenated. The at most two partial output
+ * blocks at the ends are merged sequentially through the vector's cache.
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename Cmp>
+OutExtIterator parallel_merge(ExtIterator1 first1, ExtIterator1 last1,
+                              ExtIterator2 first2, ExtIterator2 last2,
+                              OutExtIterator out, Cmp cmp, size_t nparts)
+{
+    constexpr bool debug = false;
+
+    using const_iterator1 = typename ExtIterator1::const_iterator;
+    using const_iterator2 = typename ExtIterator2::const_iterator;
+    using out_block_type = typename OutExtIterator::block_type;
+    using buf_ostream_type = foxxll::buf_ostream<
+              out_block_type, typename OutExtIterator::bids_container_iterator>;
+
+    const size_t n1 = static_cast<size_t>(last1 - first1);
+    const size_t n2 = static_cast<size_t>(last2 - first2);
+    const size_t n = n1 + n2;
+    const size_t block_size = out_block_type::size;
+
+    // output ranks [0, head) and [tail, n) are not block aligned
+    const size_t head = std::min<size_t>(
+        n, (block_size - out.block_offset()) % block_size);
+    const size_t nblocks = (n - head) / block_size;
+    const size_t tail = head + nblocks * block_size;
+
+    nparts = std::min(nparts, nblocks);
+
+    const_iterator1 cfirst1 = first1;
+    const_iterator2 cfirst2 = first2;
+
+    // output ranks and co-ranks in the first input of the parts
+    std::vector<size_t> rank(nparts + 1), split1(nparts + 1);
+    for (size_t k = 0; k <= nparts; ++k)
+    {
+        rank[k] = head + block_size * (nblocks * k / nparts);
+        split1[k] = merge_corank(cfirst1, n1, cfirst2, n2, rank[k], cmp);
+    }
+
+    LOG << "parallel_merge() n=" << n << " nparts=" << nparts
+        << " head=" << head << " tail=" << n - tail;
+
+    merge_small(cfirst1, cfirst1 + split1[0],
+                cfirst2, cfirst2 + (rank[0] - split1[0]), out, cmp);
+
+    // make all blocks on disk current, the parts bypass the caches
+    cfirst1.flush();
+    cfirst2.flush();
+    out.flush();
+
+    const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+    for (long k = 0; k < static_cast<long>(nparts); ++k)
+    {
+        const size_t i0 = split1[k], i1 = split1[k + 1];
+        const size_t j0 = rank[k] - i0, j1 = rank[k + 1] - i1;
+
+        block_reader<ExtIterator1> in1(first1 + i0, first1 + i1, nbuffers);
+        block_reader<ExtIterator2> in2(first2 + j0, first2 + j1, nbuffers);
+
+        // the part ends at a block boundary, nothing is left to flush
+        buf_ostream_type outstream((out + rank[k]).bid(), nbuffers);
+        merge_streams(in1, in2, outstream, cmp);
+    }
+
+    // inform the vector about the blocks written by the parts
+    for (size_t r = head; r < tail; r += block_size)
+        (out + r).block_externally_updated();
+
+    merge_small(cfirst1 + split1[nparts], cfirst1 + n1,
+                cfirst2 + (tail - split1[nparts]), cfirst2 + n2,
+                out + tail, cmp);
+
+    return out + n;
+}
+
+} // namespace set_operations_local
+
+/*!
+ * Merges two sorted external ranges, equivalent to std::merge.
+ *
+ * stxxl::merge writes the elements of [first1, last1) and [first2, last2),
+ * both sorted with respect to \c cmp, in sorted order to the range beginning
+ * at \c out. The merge is stable: equal elements of the first range precede
+ * those of the second.
+ *
+ * If parallelism is enabled, the output is split into as many block aligned
+ * parts as there are threads. The inputs are split at the co-ranked positions
+ * found by binary search, and the parts are merged concurrently into disjoint
+ * output blocks.
+ *
+ * The output range must be large enough and must not overlap the inputs.
+ *
+ * \param first1 begin of the first range, \c stxxl::vector iterator
+ * \param last1 end of the first range, \c stxxl::vector iterator
+ * \param first2 begin of the second range, \c stxxl::vector iterator
+ * \param last2 end of the second range, \c stxxl::vector iterator
+ * \param out \c stxxl::vector iterator receiving the merged elements
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \return iterator pointing beyond the last written element
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename StrictWeakOrdering>
+OutExtIterator merge(ExtIterator1 first1, ExtIterator1 last1,
+                     ExtIterator2 first2, ExtIterator2 last2,
+                     OutExtIterator out, StrictWeakOrdering cmp)
+{
+#if STXXL_PARALLEL
+    const size_t nparts = static_cast<size_t>(omp_get_max_threads());
+    const size_t n = static_cast<size_t>((last1 - first1) + (last2 - first2));
+
+    if (do_parallel_merge() && nparts > 1 &&
+        n >= 2 * nparts * OutExtIterator::block_type::size)
+    {
+        return set_operations_local::parallel_merge(
+            first1, last1, first2, last2, out, cmp, nparts);
+    }
+#endif
+
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+    stream::two_way_merge<decltype(in1), decltype(in2), StrictWeakOrdering>
+    merger(in1, in2, cmp);
+
+    return stream::materialize(merger, out);
+}
+
+/*!
+ * Union of two sorted external ranges, equivalent to std::set_union.
+ *
+ * An element occurring \a m times in [first1, last1) and \a n times in
+ * [first2, last2) is written max(m, n) times, the first \a m of them taken
+ * from the first range. The output range must be large enough and must not
+ * overlap the inputs.
+ *
+ * \param first1 begin of the first range, \c stxxl::vector iterator
+ * \param last1 end of the first range, \c stxxl::vector iterator
+ * \param first2 begin of the second range, \c stxxl::vector iterator
+ * \param last2 end of the second range, \c stxxl::vector iterator
+ * \param out \c stxxl::vector iterator receiving the result
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \return iterator pointing beyond the last written element
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename StrictWeakOrdering>
+OutExtIterator set_union(ExtIterator1 first1, ExtIterator1 last1,
+                         ExtIterator2 first2, ExtIterator2 last2,
+                         OutExtIterator out, StrictWeakOrdering cmp)
+{
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+    stream::set_union<decltype(in1), decltype(in2), StrictWeakOrdering>
+    op(in1, in2, cmp);
+
+    return stream::materialize(op, out);
+}
+
+/*!
+ * Intersection of two sorted external ranges, equivalent to
+ * std::set_intersection.
+ *
+ * An element occurring \a m times in [first1, last1) and \a n times in
+ * [first2, last2) is written min(m, n) times, taken from the first range.
+ * The output range must be large enough and must not overlap the inputs.
+ *
+ * \param first1 begin of the first range, \c stxxl::vector iterator
+ * \param last1 end of the first range, \c stxxl::vector iterator
+ * \param first2 begin of the second range, \c stxxl::vector iterator
+ * \param last2 end of the second range, \c stxxl::vector iterator
+ * \param out \c stxxl::vector iterator receiving the result
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \return iterator pointing beyond the last written element
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename StrictWeakOrdering>
+OutExtIterator set_intersection(ExtIterator1 first1, ExtIterator1 last1,
+                                ExtIterator2 first2, ExtIterator2 last2,
+                                OutExtIterator out, StrictWeakOrdering cmp)
+{
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+    stream::set_intersection<decltype(in1), decltype(in2), StrictWeakOrdering>
+    op(in1, in2, cmp);
+
+    return stream::materialize(op, out);
+}
+
+/*!
+ * Difference of two sorted external ranges, equivalent to
+ * std::set_difference.
+ *
+ * An element occurring \a m times in [first1, last1) and \a n times in
+ * [first2, last2) is written max(m - n, 0) times, taken from the first range.
+ * The output range must be large enough and must not overlap the inputs.
+ *
+ * \param first1 begin of the first range, \c stxxl::vector iterator
+ * \param last1 end of the first range, \c stxxl::vector iterator
+ * \param first2 begin of the second range, \c stxxl::vector iterator
+ * \param last2 end of the second range, \c stxxl::vector iterator
+ * \param out \c stxxl::vector iterator receiving the result
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \return iterator pointing beyond the last written element
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename OutExtIterator, typename StrictWeakOrdering>
+OutExtIterator set_difference(ExtIterator1 first1, ExtIterator1 last1,
+                              ExtIterator2 first2, ExtIterator2 last2,
+                              OutExtIterator out, StrictWeakOrdering cmp)
+{
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+    stream::set_difference<decltype(in1), decltype(in2), StrictWeakOrdering>
+    op(in1, in2, cmp);
+
+    return stream::materialize(op, out);
+}
+
+/*!
+ * Tests whether a sorted external range contains another one, equivalent to
+ * std::includes.
+ *
+ * \param first1 begin of the first range, \c stxxl::vector iterator
+ * \param last1 end of the first range, \c stxxl::vector iterator
+ * \param first2 begin of the second range, \c stxxl::vector iterator
+ * \param last2 end of the second range, \c stxxl::vector iterator
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \return true if every element of [first2, last2) occurs in [first1, last1),
+ * counting multiplicities
+ */
+template <typename ExtIterator1, typename ExtIterator2,
+          typename StrictWeakOrdering>
+bool includes(ExtIterator1 first1, ExtIterator1 last1,
+              ExtIterator2 first2, ExtIterator2 last2,
+              StrictWeakOrdering cmp)
+{
+    auto in1 = stream::streamify(first1, last1);
+    auto in2 = stream::streamify(first2, last2);
+
+    return stream::includes(in1, in2, cmp);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SET_OPERATIONS_HEADER
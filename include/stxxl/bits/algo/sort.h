@@ -40,6 +40,7 @@
 #include <stxxl/bits/algo/sort_base.h>
 #include <stxxl/bits/algo/sort_helper.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/huge_page_arena.h>
 #include <stxxl/bits/common/is_sorted.h>
 #include <stxxl/bits/common/settings.h>
 #include <stxxl/bits/parallel.h>
@@ -90,8 +91,10 @@ create_runs(
 
     const size_t m2 = _m / 2;
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-    block_type* Blocks1 = new block_type[m2];
-    block_type* Blocks2 = new block_type[m2];
+    // both run buffers are taken from the arena
+    huge_page_array<block_type> blocks(2 * m2);
+    block_type* Blocks1 = blocks.data();
+    block_type* Blocks2 = Blocks1 + m2;
     bid_type* bids1 = new bid_type[m2];
     bid_type* bids2 = new bid_type[m2];
     request_ptr* read_reqs1 = new request_ptr[m2];
@@ -204,8 +207,6 @@ create_runs(
     wait_all(write_reqs, run_size);
     LOG << "stxxl::create_runs finish waiting write_reqs";
 
-    delete[] Blocks1;
-    delete[] Blocks2;
     delete[] bids1;
     delete[] bids2;
     delete[] read_reqs1;
@@ -315,9 +316,15 @@ bool check_sorted_runs(RunType** runs,
     return true;
 }
 
-template <typename BlockType, typename RunType, typename CompareWithMin>
+//! Merges nruns runs into out_run. If a recycler is given, input blocks are
+//! handed to it as soon as the prefetcher has delivered them, and output
+//! blocks which have no BID assigned yet are taken from it.
+template <typename BlockType, typename RunType, typename CompareWithMin,
+          typename BidRecycler = sort_helper::bid_recycler<
+              typename BlockType::bid_type, foxxll::default_alloc_strategy> >
 void merge_runs(RunType** in_runs, size_t nruns,
-                RunType* out_run, size_t _m, CompareWithMin cmp)
+                RunType* out_run, size_t _m, CompareWithMin cmp,
+                BidRecycler* recycler = nullptr)
 {
     using block_type = BlockType;
     using run_type = RunType;
@@ -380,6 +387,21 @@ void merge_runs(RunType** in_runs, size_t nruns,
 
     block_type* out_buffer = writer.get_free_block();
 
+    // number of blocks at the front of consume_seq handed to the recycler
+    size_t recycled = 0;
+
+    // recycle all blocks delivered by the prefetcher and assign the output BID
+    auto prepare_output_bid =
+        [&](typename block_type::bid_type& bid) {
+            if (!recycler)
+                return;
+            recycler->push(consume_seq.begin() + recycled,
+                           consume_seq.begin() + prefetcher.pos());
+            recycled = prefetcher.pos();
+            if (!bid.valid())
+                recycler->pop(bid);
+        };
+
 //If parallelism is activated, one can still fall back to the
 //native merge routine by setting stxxl::SETTINGS::native_merge= true, //otherwise, it is used anyway.
 
@@ -464,6 +486,7 @@ void merge_runs(RunType** in_runs, size_t nruns,
 
             (*out_run)[j].value = (*out_buffer)[0];                                  // save smallest value
 
+            prepare_output_bid((*out_run)[j].bid);
             out_buffer = writer.write(out_buffer, (*out_run)[j].bid);
         }
 
@@ -498,6 +521,7 @@ void merge_runs(RunType** in_runs, size_t nruns,
             last_elem = (*out_buffer).elem[block_type::size - 1];
 #endif
 
+            prepare_output_bid((*out_run)[i].bid);
             out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
         }
 
@@ -506,6 +530,16 @@ void merge_runs(RunType** in_runs, size_t nruns,
 
     delete[] prefetch_seq;
 
+    if (recycler)
+    {
+        // all input blocks have been read, the ones not yet reused stay in
+        // the recycler for the next merge
+        recycler->push(consume_seq.begin() + recycled, consume_seq.end());
+        for (size_t i = 0; i < nruns; ++i)
+            delete in_runs[i];
+        return;
+    }
+
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
     for (size_t i = 0; i < nruns; ++i)
     {
@@ -574,6 +608,10 @@ sort_blocks(InputBidIterator input_bids,
     const size_t merge_factor = optimal_merge_factor(nruns, _m);
     run_type** new_runs;
 
+    // pool of consumed input blocks, used only if recycle_merge_blocks is set
+    sort_helper::bid_recycler<bid_type, alloc_strategy> recycler;
+    const bool recycle = SETTINGS::recycle_merge_blocks;
+
     while (nruns > 1)
     {
         size_t new_nruns = foxxll::div_ceil(nruns, merge_factor);
@@ -622,7 +660,7 @@ sort_blocks(InputBidIterator input_bids,
                 mng->new_block(foxxll::fully_random(), lastBID);
             }
         }
-        else
+        else if (!recycle)
         {
             mng->new_blocks(
                 interleaved_alloc_strategy(new_nruns, alloc_strategy()),
@@ -642,7 +680,8 @@ sort_blocks(InputBidIterator input_bids,
 #endif
             LOG1 << "Merging " << runs2merge << " runs";
             merge_runs<block_type, run_type>(runs + nruns - runs_left,
-                                             runs2merge, *(new_runs + (cur_out_run++)), _m, cmp);
+                                             runs2merge, *(new_runs + (cur_out_run++)), _m, cmp,
+                                             recycle ? &recycler : nullptr);
             runs_left -= runs2merge;
         }
 
@@ -654,6 +693,9 @@ sort_blocks(InputBidIterator input_bids,
     run_type* result = *runs;
     delete[] runs;
 
+    LOG << "Blocks left in recycler: " << recycler.size();
+    recycler.clear();
+
     end = foxxll::timestamp();
 
     LOG1 << "Elapsed time        : " << end - begin << " s. Run creation time: " << (after_runs_creation - begin) << " s";
@@ -16,11 +16,15 @@
 
 #include <algorithm>
 #include <functional>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/logger.hpp>
 #include <tlx/unused.hpp>
 
+#include <foxxll/io/file.hpp>
+#include <foxxll/mng/block_manager.hpp>
+
 #include <stxxl/bits/algo/run_cursor.h>
 
 namespace stxxl {
@@ -150,6 +154,113 @@ refill_or_remove_empty_sequences(SequenceVector& seqs,
     }
 }
 
+/*!
+ * Pool of blocks whose contents have been consumed by a merger, used to store
+ * the merge output in place of newly allocated blocks. Free blocks are kept
+ * per file and handed out round-robin over the files, such that the output
+ * stays striped across the disks if the input was. If the pool runs dry, a new
+ * block is allocated with the given allocation strategy. Blocks remaining in
+ * the pool are deallocated by the destructor.
+ */
+template <typename BidType, typename AllocStrategy>
+class bid_recycler
+{
+public:
+    using bid_type = BidType;
+    using alloc_strategy = AllocStrategy;
+
+    explicit bid_recycler(const alloc_strategy& alloc = alloc_strategy())
+        : m_alloc(alloc), m_next(0), m_alloc_offset(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    bid_recycler(const bid_recycler&) = delete;
+    //! non-copyable: delete assignment operator
+    bid_recycler& operator = (const bid_recycler&) = delete;
+
+    ~bid_recycler()
+    {
+        clear();
+    }
+
+    //! Returns a block which is no longer needed to the pool.
+    void push(const bid_type& bid)
+    {
+        assert(bid.valid());
+
+        size_t i = 0;
+        while (i < m_files.size() && m_files[i] != bid.storage)
+            ++i;
+
+        if (i == m_files.size()) {
+            m_files.push_back(bid.storage);
+            m_pools.emplace_back();
+        }
+
+        m_pools[i].push_back(bid);
+    }
+
+    //! Returns all blocks in the consume sequence range [begin, end) to the
+    //! pool, i.e. blocks of trigger entries that were already read.
+    template <typename TriggerEntryIterator>
+    void push(TriggerEntryIterator begin, TriggerEntryIterator end)
+    {
+        for ( ; begin != end; ++begin)
+            push(begin->bid);
+    }
+
+    //! Fetches a block from the pool, which is allocated if the pool is empty.
+    void pop(bid_type& bid)
+    {
+        for (size_t k = 0; k < m_pools.size(); ++k)
+        {
+            const size_t i = (m_next + k) % m_pools.size();
+            if (m_pools[i].empty())
+                continue;
+
+            bid = m_pools[i].back();
+            m_pools[i].pop_back();
+            m_next = i + 1;
+            return;
+        }
+
+        foxxll::block_manager::get_instance()->new_block(
+            m_alloc, bid, m_alloc_offset++);
+    }
+
+    //! Deallocates all blocks in the pool.
+    void clear()
+    {
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        for (size_t i = 0; i < m_pools.size(); ++i)
+        {
+            bm->delete_blocks(m_pools[i].begin(), m_pools[i].end());
+            m_pools[i].clear();
+        }
+    }
+
+    //! Number of blocks currently in the pool.
+    size_t size() const
+    {
+        size_t s = 0;
+        for (size_t i = 0; i < m_pools.size(); ++i)
+            s += m_pools[i].size();
+        return s;
+    }
+
+private:
+    //! allocation strategy for blocks not available in the pool
+    alloc_strategy m_alloc;
+    //! files seen so far, index into m_pools
+    std::vector<foxxll::file*> m_files;
+    //! free blocks of each file
+    std::vector<std::vector<bid_type> > m_pools;
+    //! file to take the next block from
+    size_t m_next;
+    //! allocation offset passed to the strategy for new blocks
+    size_t m_alloc_offset;
+};
+
 } // namespace sort_helper
 } // namespace stxxl
 
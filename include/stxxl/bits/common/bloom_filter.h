@@ -0,0 +1,160 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/bloom_filter.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_BLOOM_FILTER_HEADER
+#define STXXL_COMMON_BLOOM_FILTER_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <foxxll/common/utils.hpp>
+
+namespace stxxl {
+
+/*!
+ * Blocked Bloom filter with one cache line per key.
+ *
+ * The hash of a key selects one 64 byte block of eight 64-bit words, and a
+ * second hash sets or tests one bit in each of the eight words. Hence a
+ * lookup touches a single cache line, and the eight bit positions are
+ * computed independently by multiplications with fixed odd constants, which
+ * compilers turn into vector instructions. With the default of 10 bits per
+ * key the false positive rate is about 1-2%. There are no false negatives.
+ *
+ * \tparam KeyType type of the keys
+ * \tparam Hash hash function object for KeyType
+ */
+template <typename KeyType, typename Hash = std::hash<KeyType> >
+class blocked_bloom_filter
+{
+public:
+    using key_type = KeyType;
+
+    //! number of 64-bit words of a block, i.e. bits set per key
+    static constexpr size_t block_words = 8;
+    //! size of a block in bytes, one cache line
+    static constexpr size_t block_bytes = block_words * sizeof(uint64_t);
+
+    /*!
+     * Creates an empty filter for the expected number of keys.
+     *
+     * \param expected_keys number of keys to be inserted
+     * \param bits_per_key memory used per key in bits, determines the false
+     *        positive rate
+     * \param hash hash function object
+     */
+    explicit blocked_bloom_filter(size_t expected_keys,
+                                  size_t bits_per_key = 10,
+                                  const Hash& hash = Hash())
+        : m_num_blocks(std::max<size_t>(
+                           1, foxxll::div_ceil(expected_keys * bits_per_key,
+                                               8 * block_bytes))),
+          m_data(m_num_blocks * block_words + block_words - 1, 0),
+          m_hash(hash)
+    {
+        // align the blocks to cache lines
+        const uintptr_t addr = reinterpret_cast<uintptr_t>(m_data.data());
+        m_blocks = m_data.data()
+                   + (block_bytes - addr % block_bytes) % block_bytes / sizeof(uint64_t);
+    }
+
+    //! non-copyable: m_blocks points into m_data
+    blocked_bloom_filter(const blocked_bloom_filter&) = delete;
+    //! non-copyable: delete assignment operator
+    blocked_bloom_filter& operator = (const blocked_bloom_filter&) = delete;
+
+    //! Inserts a key.
+    void insert(const key_type& key)
+    {
+        const uint64_t h = mix(m_hash(key));
+        uint64_t* block = block_of(h);
+        uint64_t mask[block_words];
+        make_mask(static_cast<uint32_t>(h), mask);
+
+        for (size_t i = 0; i < block_words; ++i)
+            block[i] |= mask[i];
+    }
+
+    //! Inserts all elements of a stream of keys, consuming the stream.
+    template <typename StreamAlgorithm>
+    void insert_stream(StreamAlgorithm& in)
+    {
+        for ( ; !in.empty(); ++in)
+            insert(*in);
+    }
+
+    //! Returns false if the key was definitely not inserted.
+    bool contains(const key_type& key) const
+    {
+        const uint64_t h = mix(m_hash(key));
+        const uint64_t* block = block_of(h);
+        uint64_t mask[block_words];
+        make_mask(static_cast<uint32_t>(h), mask);
+
+        // branch-free test of all words
+        uint64_t missing = 0;
+        for (size_t i = 0; i < block_words; ++i)
+            missing |= mask[i] & ~block[i];
+
+        return missing == 0;
+    }
+
+    //! Memory occupied by the filter in bytes.
+    size_t size_bytes() const
+    {
+        return m_num_blocks * block_bytes;
+    }
+
+private:
+    //! number of blocks
+    size_t m_num_blocks;
+    //! storage of the blocks, with slack for alignment
+    std::vector<uint64_t> m_data;
+    //! first word of the cache line aligned blocks within m_data
+    uint64_t* m_blocks;
+    //! hash function object
+    Hash m_hash;
+
+    //! finalizer of MurmurHash3, spreads weak hashes such as std::hash of
+    //! integers, which is often the identity, over all bits
+    static uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    //! selects the block by the upper 32 bits of the hash
+    uint64_t* block_of(uint64_t h) const
+    {
+        return m_blocks + ((h >> 32) * m_num_blocks >> 32) * block_words;
+    }
+
+    //! computes one bit per word from the lower 32 bits of the hash
+    static void make_mask(uint32_t h, uint64_t* mask)
+    {
+        static const uint32_t salt[block_words] = {
+            0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+            0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u
+        };
+
+        for (size_t i = 0; i < block_words; ++i)
+            mask[i] = uint64_t(1) << ((h * salt[i]) >> 26);
+    }
+};
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_BLOOM_FILTER_HEADER
@@ -0,0 +1,379 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/file_block_store.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_FILE_BLOCK_STORE_HEADER
+#define STXXL_COMMON_FILE_BLOCK_STORE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/types.hpp>
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/file.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Block allocator of a persistent container which keeps all its blocks in a
+ * single file, together with the container's metadata.
+ *
+ * The first 4 KiB of the file hold a superblock, which points to the most
+ * recent metadata written by commit(). The metadata consists of the free
+ * space of the file and of a binary_buffer supplied by the container, e.g.
+ * its root node or bucket directory. A new store constructed on the file
+ * reads the metadata back, such that the container is usable without
+ * rebuilding it.
+ *
+ * Blocks are allocated at the end of the file or reused from per-size free
+ * lists, the BIDs refer to the file. The metadata of a commit is written to
+ * a fresh extent before the superblock is overwritten, hence an interrupted
+ * commit leaves the previous metadata intact. Blocks modified after a commit
+ * are not protected, and durability of the writes depends on the mode the
+ * file was opened with, e.g. file::SYNC.
+ */
+class file_block_store
+{
+    static constexpr bool debug = false;
+
+public:
+    using offset_type = foxxll::external_size_type;
+
+    //! size of the superblock, also the alignment of the metadata extents
+    static constexpr size_t superblock_size = 4096;
+
+    /*!
+     * Opens the store in the given file.
+     *
+     * \param file the file containing the blocks
+     * \param tag identifies the type of the container and its parameters,
+     *        an existing superblock with a different tag is rejected
+     * \param create if true, existing contents of the file are discarded
+     */
+    file_block_store(foxxll::file_ptr file, const std::string& tag,
+                     bool create = false)
+        : m_file(file), m_tag(tag),
+          m_hwm(superblock_size), m_file_size(0),
+          m_meta_offset(0), m_meta_size(0), m_reopened(false)
+    {
+        if (!create && m_file->size() > 0)
+            load();
+        else
+            m_file_size = 0;
+    }
+
+    //! non-copyable: delete copy-constructor
+    file_block_store(const file_block_store&) = delete;
+    //! non-copyable: delete assignment operator
+    file_block_store& operator = (const file_block_store&) = delete;
+
+    //! Returns true if the store was read from an existing superblock.
+    bool reopened() const
+    {
+        return m_reopened;
+    }
+
+    //! Returns a reader for the container's part of the last committed
+    //! metadata. Only valid if reopened().
+    binary_reader metadata() const
+    {
+        return binary_reader(m_metadata.data() + m_metadata_begin,
+                             m_metadata.size() - m_metadata_begin);
+    }
+
+    //! The file containing the blocks.
+    const foxxll::file_ptr & file() const
+    {
+        return m_file;
+    }
+
+    //! Returns the BID of the block at offset in the file.
+    template <typename BidType>
+    BidType bid_at(offset_type offset) const
+    {
+        BidType bid;
+        bid.storage = m_file.get();
+        bid.offset = offset;
+        return bid;
+    }
+
+    //! Allocates a block in the file.
+    template <typename BidType>
+    void new_block(BidType& bid)
+    {
+        bid = bid_at<BidType>(allocate(BidType::size, m_hwm));
+    }
+
+    //! Allocates blocks in the file.
+    template <typename BidIterator>
+    void new_blocks(BidIterator begin, BidIterator end)
+    {
+        for ( ; begin != end; ++begin)
+            new_block(*begin);
+    }
+
+    //! Returns a block to the free space of the file.
+    template <typename BidType>
+    void delete_block(const BidType& bid)
+    {
+        if (!bid.valid())
+            return;
+        assert(bid.storage == m_file.get());
+        m_free[BidType::size].push_back(bid.offset);
+    }
+
+    //! Returns blocks to the free space of the file.
+    template <typename BidIterator>
+    void delete_blocks(BidIterator begin, BidIterator end)
+    {
+        for ( ; begin != end; ++begin)
+            delete_block(*begin);
+    }
+
+    /*!
+     * Writes the container's metadata and the free space of the file to a
+     * new extent, then the superblock pointing to it. The container must
+     * have written all its blocks before.
+     */
+    void commit(const binary_buffer& container_metadata)
+    {
+        // the previous extent is free once the new superblock is written, it
+        // is listed as free space but not reused for the new metadata
+        const offset_type old_offset = m_meta_offset;
+        if (m_meta_size != 0)
+            m_free[m_meta_size].push_back(old_offset);
+
+        binary_buffer meta;
+        meta.put<uint64_t>(m_hwm);
+        meta.put<uint64_t>(m_free.size());
+        for (const auto& list : m_free)
+        {
+            meta.put<uint64_t>(list.first);
+            meta.put<uint64_t>(list.second.size());
+            for (const offset_type& offset : list.second)
+                meta.put<uint64_t>(offset);
+        }
+        meta.append(container_metadata);
+
+        // the extent may be taken from the free lists just serialized, it is
+        // removed from them when reading the metadata back
+        const size_t extent_size = round_up(meta.size());
+        const offset_type offset = allocate(extent_size, old_offset);
+
+        write(offset, meta.data(), meta.size(), extent_size);
+
+        binary_buffer sb;
+        sb.put<uint64_t>(magic);
+        sb.put<uint32_t>(version);
+        sb.put_string(m_tag);
+        sb.put<uint64_t>(offset);
+        sb.put<uint64_t>(meta.size());
+        sb.put<uint64_t>(checksum(meta.data(), meta.size()));
+        if (sb.size() > superblock_size)
+        {
+            FOXXLL_THROW2(std::runtime_error, "file_block_store::commit",
+                          "Container tag too long for the superblock.");
+        }
+
+        write(0, sb.data(), sb.size(), superblock_size);
+
+        LOG << "file_block_store::commit metadata at " << offset
+            << " size " << meta.size() << " file size " << m_hwm;
+
+        m_meta_offset = offset;
+        m_meta_size = extent_size;
+    }
+
+private:
+    //! "STXXLFBS" as an integer
+    static constexpr uint64_t magic = 0x5342464C58585453ull;
+    //! version of the file format
+    static constexpr uint32_t version = 1;
+
+    //! the file containing the blocks
+    foxxll::file_ptr m_file;
+    //! type of the container
+    std::string m_tag;
+    //! end of the allocated part of the file
+    offset_type m_hwm;
+    //! size the file was extended to
+    offset_type m_file_size;
+    //! free blocks by size in bytes
+    std::map<size_t, std::vector<offset_type> > m_free;
+    //! extent of the current metadata
+    offset_type m_meta_offset;
+    //! size of the extent of the current metadata
+    size_t m_meta_size;
+    //! metadata read when reopening
+    binary_buffer m_metadata;
+    //! start of the container's part of m_metadata
+    size_t m_metadata_begin = 0;
+    //! whether the store was read from an existing superblock
+    bool m_reopened;
+
+    static size_t round_up(size_t n)
+    {
+        return std::max<size_t>(1, foxxll::div_ceil(n, superblock_size))
+               * superblock_size;
+    }
+
+    //! FNV-1a hash of the metadata
+    static uint64_t checksum(const char* data, size_t n)
+    {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    //! takes a free extent of the given size other than exclude, or appends
+    //! one to the file
+    offset_type allocate(size_t size, offset_type exclude)
+    {
+        auto it = m_free.find(size);
+        if (it != m_free.end())
+        {
+            std::vector<offset_type>& list = it->second;
+            for (size_t i = list.size(); i-- > 0; )
+            {
+                if (list[i] == exclude)
+                    continue;
+                const offset_type offset = list[i];
+                list[i] = list.back();
+                list.pop_back();
+                return offset;
+            }
+        }
+
+        const offset_type offset = m_hwm;
+        m_hwm += size;
+        if (m_hwm > m_file_size)
+        {
+            // extend the file geometrically to save on truncate calls
+            m_file_size = std::max(m_hwm, 2 * m_file_size);
+            m_file->set_size(m_file_size);
+        }
+        return offset;
+    }
+
+    //! writes n bytes padded to size bytes at offset
+    void write(offset_type offset, const char* data, size_t n, size_t size)
+    {
+        char* buffer = static_cast<char*>(
+            foxxll::aligned_alloc<superblock_size>(size));
+        std::memcpy(buffer, data, n);
+        std::memset(buffer + n, 0, size - n);
+        try {
+            m_file->awrite(buffer, offset, size)->wait();
+        }
+        catch (...) {
+            foxxll::aligned_dealloc<superblock_size>(buffer);
+            throw;
+        }
+        foxxll::aligned_dealloc<superblock_size>(buffer);
+    }
+
+    //! reads size bytes at offset into the binary_buffer
+    void read(offset_type offset, size_t size, binary_buffer& out)
+    {
+        char* buffer = static_cast<char*>(
+            foxxll::aligned_alloc<superblock_size>(size));
+        try {
+            m_file->aread(buffer, offset, size)->wait();
+        }
+        catch (...) {
+            foxxll::aligned_dealloc<superblock_size>(buffer);
+            throw;
+        }
+        out.assign(buffer, size);
+        foxxll::aligned_dealloc<superblock_size>(buffer);
+    }
+
+    //! reads the superblock and the metadata it points to
+    void load()
+    {
+        m_file_size = m_file->size();
+
+        binary_buffer sb_data;
+        read(0, superblock_size, sb_data);
+        binary_reader sb(sb_data);
+
+        if (sb.get<uint64_t>() != magic || sb.get<uint32_t>() != version)
+        {
+            FOXXLL_THROW2(std::runtime_error, "file_block_store::load",
+                          "The file contains no container superblock.");
+        }
+        if (sb.get_string() != m_tag)
+        {
+            FOXXLL_THROW2(std::runtime_error, "file_block_store::load",
+                          "The file contains a container of another type: " << m_tag);
+        }
+
+        const offset_type offset = sb.get<uint64_t>();
+        const size_t size = static_cast<size_t>(sb.get<uint64_t>());
+        const uint64_t sum = sb.get<uint64_t>();
+
+        read(offset, round_up(size), m_metadata);
+        m_metadata.set_size(size);
+        if (checksum(m_metadata.data(), size) != sum)
+        {
+            FOXXLL_THROW2(std::runtime_error, "file_block_store::load",
+                          "Checksum mismatch in the container metadata.");
+        }
+
+        binary_reader meta(m_metadata);
+        m_hwm = meta.get<uint64_t>();
+        const size_t num_lists = static_cast<size_t>(meta.get<uint64_t>());
+        for (size_t i = 0; i < num_lists; ++i)
+        {
+            const size_t block_size = static_cast<size_t>(meta.get<uint64_t>());
+            std::vector<offset_type>& list = m_free[block_size];
+            list.resize(static_cast<size_t>(meta.get<uint64_t>()));
+            for (offset_type& free_offset : list)
+                free_offset = meta.get<uint64_t>();
+        }
+        m_metadata_begin = meta.curr();
+
+        // the metadata extent itself is in use
+        m_meta_offset = offset;
+        m_meta_size = round_up(size);
+        std::vector<offset_type>& list = m_free[m_meta_size];
+        list.erase(std::remove(list.begin(), list.end(), offset), list.end());
+        m_hwm = std::max(m_hwm, offset + m_meta_size);
+
+        m_reopened = true;
+
+        LOG << "file_block_store::load metadata at " << offset
+            << " size " << size << " file size " << m_hwm;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_FILE_BLOCK_STORE_HEADER
@@ -0,0 +1,410 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/huge_page_arena.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_HUGE_PAGE_ARENA_HEADER
+#define STXXL_COMMON_HUGE_PAGE_ARENA_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include <tlx/logger.hpp>
+#include <tlx/unused.hpp>
+
+#include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/singleton.hpp>
+
+#include <stxxl/bits/config.h>
+
+#if STXXL_HAVE_HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Arena for large, long-lived buffers like the run buffers of the sorters.
+ * Buffers are rounded up to whole 2 MiB huge pages and mapped with
+ * MAP_HUGETLB if the system has reserved huge pages, otherwise they are
+ * mapped normally and marked for transparent huge pages with madvise(). Freed
+ * buffers are kept up to cache_limit() bytes and handed out again for
+ * requests of the same rounded size, such that repeated sorts neither map
+ * nor fault in their buffers again.
+ *
+ * Requests smaller than a huge page and all requests on platforms without
+ * mmap() use foxxll::aligned_alloc(). All methods are thread-safe.
+ */
+class huge_page_arena : public foxxll::singleton<huge_page_arena>
+{
+    static constexpr bool debug = false;
+
+public:
+    //! size of a huge page, the unit of the arena's buffers
+    static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+    //! alignment of buffers not taken from the arena
+    static constexpr size_t small_alignment = 4096;
+
+    huge_page_arena() = default;
+    huge_page_arena(const huge_page_arena&) = delete;
+
+    ~huge_page_arena()
+    {
+        release();
+    }
+
+    //! Returns a buffer of at least bytes bytes aligned to 4 KiB.
+    void * allocate(size_t bytes)
+    {
+        if (!use_arena(bytes))
+            return foxxll::aligned_alloc<small_alignment>(bytes);
+
+        const size_t size = round_up(bytes);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto it = m_cache.find(size);
+            if (it != m_cache.end())
+            {
+                void* ptr = it->second;
+                m_cache.erase(it);
+                m_cached_bytes -= size;
+                ++m_reused;
+                return ptr;
+            }
+        }
+
+        return map(size);
+    }
+
+    //! Returns a buffer obtained from allocate() with the same size.
+    void deallocate(void* ptr, size_t bytes)
+    {
+        if (!ptr)
+            return;
+
+        if (!use_arena(bytes))
+            return foxxll::aligned_dealloc<small_alignment>(ptr);
+
+        const size_t size = round_up(bytes);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_cached_bytes + size <= m_cache_limit)
+            {
+                m_cache.emplace(size, ptr);
+                m_cached_bytes += size;
+                return;
+            }
+        }
+
+        unmap(ptr, size);
+    }
+
+    //! Unmaps all cached buffers.
+    void release()
+    {
+        std::multimap<size_t, void*> cache;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            std::swap(cache, m_cache);
+            m_cached_bytes = 0;
+        }
+        for (const auto& it : cache)
+            unmap(it.second, it.first);
+    }
+
+    //! Maximum number of bytes of freed buffers kept for reuse.
+    size_t cache_limit() const
+    {
+        return m_cache_limit;
+    }
+
+    //! Sets the maximum number of bytes of freed buffers kept for reuse,
+    //! unmapping cached buffers beyond it.
+    void set_cache_limit(size_t bytes)
+    {
+        std::multimap<size_t, void*> evicted;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cache_limit = bytes;
+            while (m_cached_bytes > m_cache_limit)
+            {
+                auto it = std::prev(m_cache.end());
+                m_cached_bytes -= it->first;
+                evicted.insert(*it);
+                m_cache.erase(it);
+            }
+        }
+        for (const auto& it : evicted)
+            unmap(it.second, it.first);
+    }
+
+    //! Whether large buffers are taken from the arena. If disabled, all
+    //! buffers are allocated with foxxll::aligned_alloc().
+    bool enabled() const
+    {
+        return m_enabled;
+    }
+
+    //! Enables or disables the arena. Must not be changed while buffers
+    //! obtained from the arena are in use.
+    void set_enabled(bool enable)
+    {
+        m_enabled = enable;
+    }
+
+    //! Number of bytes currently cached for reuse.
+    size_t cached_bytes() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cached_bytes;
+    }
+
+    //! Number of buffers mapped with MAP_HUGETLB.
+    size_t num_hugetlb() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_num_hugetlb;
+    }
+
+    //! Number of buffers mapped with transparent huge pages advised.
+    size_t num_transparent() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_num_transparent;
+    }
+
+    //! Number of requests served from the cache.
+    size_t num_reused() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_reused;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+
+    //! cached buffers by size
+    std::multimap<size_t, void*> m_cache;
+    size_t m_cached_bytes = 0;
+    size_t m_cache_limit = size_t(1) << 30;
+    bool m_enabled = true;
+
+    size_t m_num_hugetlb = 0;
+    size_t m_num_transparent = 0;
+    size_t m_reused = 0;
+
+    static size_t round_up(size_t bytes)
+    {
+        return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    }
+
+    bool use_arena(size_t bytes) const
+    {
+#if STXXL_HAVE_HUGE_PAGES
+        return m_enabled && bytes >= huge_page_size;
+#else
+        tlx::unused(bytes);
+        return false;
+#endif
+    }
+
+#if STXXL_HAVE_HUGE_PAGES
+    void * map(size_t size)
+    {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+            LOG << "huge_page_arena: mapped " << size << " bytes with MAP_HUGETLB";
+            std::unique_lock<std::mutex> lock(m_mutex);
+            ++m_num_hugetlb;
+            return ptr;
+        }
+
+        // map an extra huge page to align the buffer to a huge page boundary
+        const size_t mapped = size + huge_page_size;
+        char* base = static_cast<char*>(
+            mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (base == MAP_FAILED)
+            throw std::bad_alloc();
+
+        const uintptr_t addr = reinterpret_cast<uintptr_t>(base);
+        char* aligned = base + (huge_page_size - addr % huge_page_size) % huge_page_size;
+        if (aligned != base)
+            munmap(base, static_cast<size_t>(aligned - base));
+        if (aligned + size != base + mapped)
+            munmap(aligned + size, static_cast<size_t>(base + mapped - (aligned + size)));
+
+        madvise(aligned, size, MADV_HUGEPAGE);
+        LOG << "huge_page_arena: mapped " << size << " bytes with MADV_HUGEPAGE";
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_num_transparent;
+        return aligned;
+    }
+
+    void unmap(void* ptr, size_t size)
+    {
+        munmap(ptr, size);
+    }
+#else
+    void * map(size_t size)
+    {
+        return foxxll::aligned_alloc<small_alignment>(size);
+    }
+
+    void unmap(void* ptr, size_t /* size */)
+    {
+        foxxll::aligned_dealloc<small_alignment>(ptr);
+    }
+#endif
+};
+
+/*!
+ * Array of default constructed objects in a buffer of the huge_page_arena,
+ * replacing new Type[size] for large buffers. The buffer is returned to the
+ * arena on destruction.
+ */
+template <typename Type>
+class huge_page_array
+{
+public:
+    using value_type = Type;
+
+    huge_page_array() = default;
+
+    explicit huge_page_array(size_t size)
+    {
+        allocate(size);
+    }
+
+    //! non-copyable: delete copy-constructor
+    huge_page_array(const huge_page_array&) = delete;
+    //! non-copyable: delete assignment operator
+    huge_page_array& operator = (const huge_page_array&) = delete;
+
+    ~huge_page_array()
+    {
+        deallocate();
+    }
+
+    //! Replaces the array by size default constructed objects.
+    void allocate(size_t size)
+    {
+        deallocate();
+        if (size == 0)
+            return;
+
+        m_data = static_cast<Type*>(
+            huge_page_arena::get_instance()->allocate(size * sizeof(Type)));
+        for (size_t i = 0; i < size; ++i)
+            new (m_data + i)Type();
+        m_size = size;
+    }
+
+    //! Destroys the objects and returns the buffer to the arena.
+    void deallocate()
+    {
+        if (!m_data)
+            return;
+
+        for (size_t i = 0; i < m_size; ++i)
+            m_data[i].~Type();
+        huge_page_arena::get_instance()->deallocate(m_data, m_size * sizeof(Type));
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    Type * data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    Type& operator [] (size_t i) const
+    {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+    void swap(huge_page_array& other)
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+    }
+
+private:
+    Type* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+/*!
+ * Stateless allocator for std::vector and other containers, which takes
+ * buffers of at least a huge page from the huge_page_arena and smaller ones
+ * from operator new. As all instances are equal, containers using it keep
+ * their move and swap semantics.
+ */
+template <typename Type>
+class huge_page_allocator
+{
+public:
+    using value_type = Type;
+
+    huge_page_allocator() = default;
+
+    template <typename Other>
+    huge_page_allocator(const huge_page_allocator<Other>&) { }
+
+    Type * allocate(size_t n)
+    {
+        const size_t bytes = n * sizeof(Type);
+        if (bytes < huge_page_arena::huge_page_size)
+            return static_cast<Type*>(::operator new (bytes));
+        return static_cast<Type*>(huge_page_arena::get_instance()->allocate(bytes));
+    }
+
+    void deallocate(Type* ptr, size_t n)
+    {
+        const size_t bytes = n * sizeof(Type);
+        if (bytes < huge_page_arena::huge_page_size)
+            return ::operator delete (ptr);
+        huge_page_arena::get_instance()->deallocate(ptr, bytes);
+    }
+
+    template <typename Other>
+    bool operator == (const huge_page_allocator<Other>&) const
+    {
+        return true;
+    }
+
+    template <typename Other>
+    bool operator != (const huge_page_allocator<Other>&) const
+    {
+        return false;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_HUGE_PAGE_ARENA_HEADER
@@ -0,0 +1,223 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/io_account.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_IO_ACCOUNT_HEADER
+#define STXXL_COMMON_IO_ACCOUNT_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/singleton.hpp>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Counts the I/O caused by the containers and algorithms it is attached to,
+ * in contrast to foxxll::stats, which counts the I/O of the whole process.
+ *
+ * Accounts are obtained by name from io_accounts, such that all instances
+ * using the same name are counted together, and are attached using the
+ * instances' set_io_account() methods. An account counts blocks read,
+ * written and prefetched, prefetched blocks which were never used, and the
+ * time the instances waited for I/O. All methods are thread-safe.
+ */
+class io_account
+{
+public:
+    explicit io_account(const std::string& name)
+        : m_name(name) { }
+
+    //! non-copyable: delete copy-constructor
+    io_account(const io_account&) = delete;
+    //! non-copyable: delete assignment operator
+    io_account& operator = (const io_account&) = delete;
+
+    //! Name of the account.
+    const std::string & name() const
+    {
+        return m_name;
+    }
+
+    //! Counts blocks read with a total size of bytes.
+    void add_read(uint64_t blocks, uint64_t bytes)
+    {
+        m_blocks_read += blocks;
+        m_bytes_read += bytes;
+    }
+
+    //! Counts blocks written with a total size of bytes.
+    void add_write(uint64_t blocks, uint64_t bytes)
+    {
+        m_blocks_written += blocks;
+        m_bytes_written += bytes;
+    }
+
+    //! Counts blocks read ahead of their use.
+    void add_prefetch(uint64_t blocks)
+    {
+        m_blocks_prefetched += blocks;
+    }
+
+    //! Counts prefetched blocks which were dropped without being used.
+    void add_wasted(uint64_t blocks)
+    {
+        m_blocks_wasted += blocks;
+    }
+
+    //! Counts time spent waiting for I/O.
+    void add_wait(double seconds)
+    {
+        m_wait_us += static_cast<uint64_t>(seconds * 1e6);
+    }
+
+    uint64_t blocks_read() const { return m_blocks_read; }
+    uint64_t bytes_read() const { return m_bytes_read; }
+    uint64_t blocks_written() const { return m_blocks_written; }
+    uint64_t bytes_written() const { return m_bytes_written; }
+    uint64_t blocks_prefetched() const { return m_blocks_prefetched; }
+    uint64_t blocks_wasted() const { return m_blocks_wasted; }
+
+    //! Time spent waiting for I/O in seconds.
+    double wait_time() const
+    {
+        return static_cast<double>(m_wait_us) / 1e6;
+    }
+
+    //! Sets all counters to zero.
+    void reset()
+    {
+        m_blocks_read = m_bytes_read = 0;
+        m_blocks_written = m_bytes_written = 0;
+        m_blocks_prefetched = m_blocks_wasted = 0;
+        m_wait_us = 0;
+    }
+
+    /*!
+     * Adds the time from construction to destruction to the wait time of an
+     * account, if one is given. Containers use it with their optional
+     * account, which costs a single branch if none is attached.
+     */
+    class wait_timer
+    {
+    public:
+        explicit wait_timer(io_account* account)
+            : m_account(account),
+              m_begin(account ? foxxll::timestamp() : 0.0) { }
+
+        //! non-copyable: delete copy-constructor
+        wait_timer(const wait_timer&) = delete;
+        //! non-copyable: delete assignment operator
+        wait_timer& operator = (const wait_timer&) = delete;
+
+        ~wait_timer()
+        {
+            if (m_account)
+                m_account->add_wait(foxxll::timestamp() - m_begin);
+        }
+
+    private:
+        io_account* m_account;
+        double m_begin;
+    };
+
+    friend std::ostream& operator << (std::ostream& os, const io_account& a)
+    {
+        return os << a.name()
+                  << ": read " << a.blocks_read() << " blocks ("
+                  << a.bytes_read() << " bytes)"
+                  << ", written " << a.blocks_written() << " blocks ("
+                  << a.bytes_written() << " bytes)"
+                  << ", prefetched " << a.blocks_prefetched()
+                  << ", wasted " << a.blocks_wasted()
+                  << ", waited " << std::fixed << std::setprecision(3)
+                  << a.wait_time() << " s";
+    }
+
+private:
+    std::string m_name;
+
+    std::atomic<uint64_t> m_blocks_read { 0 };
+    std::atomic<uint64_t> m_bytes_read { 0 };
+    std::atomic<uint64_t> m_blocks_written { 0 };
+    std::atomic<uint64_t> m_bytes_written { 0 };
+    std::atomic<uint64_t> m_blocks_prefetched { 0 };
+    std::atomic<uint64_t> m_blocks_wasted { 0 };
+    std::atomic<uint64_t> m_wait_us { 0 };
+};
+
+/*!
+ * Registry of the named io_account objects, which live until the program
+ * exits. At exit, the accounts are reported unless print_at_exit(false) was
+ * called. All methods are thread-safe.
+ */
+class io_accounts : public foxxll::singleton<io_accounts>
+{
+public:
+    io_accounts() = default;
+    io_accounts(const io_accounts&) = delete;
+
+    ~io_accounts()
+    {
+        if (!m_print_at_exit || m_accounts.empty())
+            return;
+
+        std::ostringstream oss;
+        print(oss);
+        LOG1 << "I/O accounts:\n" << oss.str();
+    }
+
+    //! Returns the account with the given name, creating it on first use.
+    io_account * get(const std::string& name)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::unique_ptr<io_account>& account = m_accounts[name];
+        if (!account)
+            account.reset(new io_account(name));
+        return account.get();
+    }
+
+    //! Writes one line per account, ordered by name.
+    void print(std::ostream& os) const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto& account : m_accounts)
+            os << "  " << *account.second << '\n';
+    }
+
+    //! Whether the accounts are reported when the program exits.
+    void print_at_exit(bool enable)
+    {
+        m_print_at_exit = enable;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<io_account> > m_accounts;
+    bool m_print_at_exit = true;
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_IO_ACCOUNT_HEADER
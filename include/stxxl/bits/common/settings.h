@@ -25,11 +25,18 @@ class settings
 {
 public:
     static bool native_merge;
+    //! Free the input blocks of external merges as soon as they have been
+    //! read and reuse them for the output. This bounds the scratch disk
+    //! space of sorts to the data size plus O(M).
+    static bool recycle_merge_blocks;
 };
 
 template <typename MustBeInt>
 bool settings<MustBeInt>::native_merge = false;
 
+template <typename MustBeInt>
+bool settings<MustBeInt>::recycle_merge_blocks = false;
+
 using SETTINGS = settings<>;
 
 } // namespace stxxl
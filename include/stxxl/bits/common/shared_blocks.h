@@ -0,0 +1,96 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/shared_blocks.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_SHARED_BLOCKS_HEADER
+#define STXXL_COMMON_SHARED_BLOCKS_HEADER
+
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <foxxll/common/types.hpp>
+#include <foxxll/singleton.hpp>
+
+namespace stxxl {
+
+/*!
+ * Reference counts of external memory blocks owned by more than one
+ * container, used for copy-on-write sharing of blocks. Blocks not contained
+ * in the registry have exactly one owner, hence containers which never share
+ * blocks do not pay for it. All methods are thread-safe.
+ */
+class shared_blocks : public foxxll::singleton<shared_blocks>
+{
+public:
+    shared_blocks() = default;
+    shared_blocks(const shared_blocks&) = delete;
+
+    //! Registers an additional owner of the block.
+    template <typename BidType>
+    void add_ref(const BidType& bid)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto it = refs_.find(key(bid));
+        if (it == refs_.end())
+            refs_.emplace(key(bid), 2);
+        else
+            ++it->second;
+    }
+
+    //! Drops one owner of the block.
+    //! \return true if the caller was the last owner and must delete the block
+    template <typename BidType>
+    bool release(const BidType& bid)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto it = refs_.find(key(bid));
+        if (it == refs_.end())
+            return true;
+
+        assert(it->second >= 2);
+        if (--it->second == 1)
+            refs_.erase(it);
+        return false;
+    }
+
+    //! Returns true if the block has more than one owner.
+    template <typename BidType>
+    bool is_shared(const BidType& bid) const
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        return refs_.find(key(bid)) != refs_.end();
+    }
+
+    //! Number of blocks with more than one owner.
+    size_t size() const
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        return refs_.size();
+    }
+
+private:
+    using key_type = std::pair<const void*, foxxll::external_size_type>;
+
+    template <typename BidType>
+    static key_type key(const BidType& bid)
+    {
+        return key_type(bid.storage, bid.offset);
+    }
+
+    mutable std::mutex mtx_;
+
+    //! number of owners of each shared block, always at least two
+    std::map<key_type, size_t> refs_;
+};
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_SHARED_BLOCKS_HEADER
@@ -14,11 +14,19 @@
 #define STXXL_CONTAINERS_BTREE_BTREE_HEADER
 
 #include <algorithm>
+#include <cstdint>
 #include <limits>
 #include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/file_block_store.h>
+#include <stxxl/bits/containers/btree/cursor.h>
 #include <stxxl/bits/containers/btree/iterator.h>
 #include <stxxl/bits/containers/btree/iterator_map.h>
 #include <stxxl/bits/containers/btree/leaf.h>
@@ -35,7 +43,8 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics = false
           >
 class btree
 {
@@ -47,7 +56,11 @@ public:
     using key_compare = KeyCompareWithMaxType;
 
     using self_type = btree<KeyType, DataType, KeyCompareWithMaxType,
-                            RawNodeSize, RawLeafSize, PDAllocStrategy>;
+                            RawNodeSize, RawLeafSize, PDAllocStrategy,
+                            OrderStatistics>;
+
+    //! whether the node entries keep the element counts of their subtrees
+    static constexpr bool order_statistics = OrderStatistics;
 
     using alloc_strategy_type = PDAllocStrategy;
 
@@ -70,6 +83,9 @@ public:
     using iterator = btree_iterator<self_type>;
     using const_iterator = btree_const_iterator<self_type>;
     friend class btree_iterator_base<self_type>;
+    // unregistered cursor type
+    using cursor_type = btree_cursor<self_type>;
+    friend class btree_cursor<self_type>;
     // iterator map type
     using iterator_map_type = iterator_map<self_type>;
     // node type declarations
@@ -77,6 +93,7 @@ public:
     using node_block_type = typename node_type::block_type;
     friend class normal_node<key_type, key_compare, RawNodeSize, self_type>;
     using node_bid_type = typename node_type::bid_type;
+    using node_child_type = typename node_type::child_type;
     using node_cache_type = node_cache<node_type, self_type>;
     friend class node_cache<node_type, self_type>;
 
@@ -91,24 +108,33 @@ public:
 
 private:
     key_compare m_key_compare;
+    //! allocator and superblock of the file the btree is bound to, or
+    //! nullptr if the blocks are temporary
+    std::unique_ptr<file_block_store> m_store;
     mutable node_cache_type m_node_cache;
     mutable leaf_cache_type m_leaf_cache;
+    //! account counting the I/O of both caches, or nullptr
+    io_account* m_io_account = nullptr;
     iterator_map_type m_iterator_map;
     size_type m_size;
     unsigned int m_height;
     bool m_prefetching_enabled;
+    //! source of the modification epochs of the leaves
+    uint64_t m_leaf_epoch;
+    //! epoch at which the last leaf was deallocated
+    uint64_t m_leaf_dealloc_epoch;
     foxxll::block_manager* m_bm;
     alloc_strategy_type m_alloc_strategy;
 
-    using root_node_type = std::map<key_type, node_bid_type, key_compare>;
+    using root_node_type = std::map<key_type, node_child_type, key_compare>;
     using root_node_iterator_type = typename root_node_type::iterator;
     using root_node_const_iterator_type = typename root_node_type::const_iterator;
-    using root_node_pair_type = std::pair<key_type, node_bid_type>;
+    using root_node_pair_type = std::pair<key_type, node_child_type>;
 
     root_node_type m_root_node;
     iterator m_end_iterator;
 
-    void insert_into_root(const std::pair<key_type, node_bid_type>& splitter)
+    void insert_into_root(const root_node_pair_type& splitter)
     {
         std::pair<root_node_iterator_type, bool> result = m_root_node.insert(splitter);
         assert(result.second);
@@ -158,8 +184,10 @@ private:
 
             // create new root node
             m_root_node.clear();
-            m_root_node.insert(root_node_pair_type(left_key, left_bid));
-            m_root_node.insert(root_node_pair_type(right_key, right_bid));
+            m_root_node.insert(root_node_pair_type(
+                                   left_key, node_child_type(left_bid, left_node->subtree_size())));
+            m_root_node.insert(root_node_pair_type(
+                                   right_key, node_child_type(right_bid, right_node->subtree_size())));
 
             ++m_height;
             LOG << "btree Increasing height to " << m_height;
@@ -198,6 +226,9 @@ private:
         local_node_type* left_node = cache.get_node(left_bid, true);
         local_node_type* right_node = cache.get_node(right_bid, true);
 
+        const size_type total_count =
+            left_it->second.count() + right_it->second.count();
+
         const size_t total_size = left_node->size() + right_node->size();
         if (total_size <= right_node->max_nelements())
         {
@@ -205,6 +236,7 @@ private:
 
             // add the content of left_node to right_node
             right_node->fuse(*left_node);
+            right_it->second.set_count(total_count);
 
             cache.unfix_node(right_bid);
             // 'delete_node' unfixes left_bid also
@@ -218,18 +250,86 @@ private:
             // --- balance ---
 
             key_type new_splitter = right_node->balance(*left_node);
+            const size_type left_count = left_node->subtree_size();
+            right_it->second.set_count(total_count - left_count);
 
             // delete left BID from the root
             m_root_node.erase(left_it);
 
             // reinsert with the new key
-            m_root_node.insert(root_node_pair_type(new_splitter, static_cast<node_bid_type>(left_bid)));
+            m_root_node.insert(root_node_pair_type(
+                                   new_splitter, node_child_type(static_cast<node_bid_type>(left_bid), left_count)));
 
             cache.unfix_node(left_bid);
             cache.unfix_node(right_bid);
         }
     }
 
+    //! returns a new modification epoch for a leaf
+    uint64_t next_leaf_epoch()
+    {
+        return ++m_leaf_epoch;
+    }
+
+    //! invalidates all cursors, which must not read deallocated leaves
+    void leaves_deallocated()
+    {
+        m_leaf_dealloc_epoch = ++m_leaf_epoch;
+    }
+
+    //! returns the leaf in which lower_bound(k) starts searching
+    leaf_bid_type find_leaf(const key_type& k) const
+    {
+        root_node_const_iterator_type it = m_root_node.lower_bound(k);
+        assert(it != m_root_node.end());
+
+        if (m_height == 2)                // 'it' points to a leaf
+            return static_cast<leaf_bid_type>(it->second);
+
+        // 'it' points to a node
+        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
+        assert(node);
+        leaf_bid_type result = node->find_leaf(k, m_height - 1);
+        m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
+        return result;
+    }
+
+    //! identifies the layout of the btree in the superblock of its file
+    static std::string store_tag()
+    {
+        std::ostringstream tag;
+        tag << "stxxl::btree key=" << sizeof(key_type)
+            << " data=" << sizeof(data_type)
+            << " node=" << RawNodeSize << " leaf=" << RawLeafSize
+            << " order_statistics=" << OrderStatistics;
+        return tag.str();
+    }
+
+    //! restores the root node and the counters from the file's metadata
+    void read_metadata()
+    {
+        binary_reader meta = m_store->metadata();
+        m_size = meta.get<uint64_t>();
+        m_height = meta.get<uint32_t>();
+        m_leaf_epoch = meta.get<uint64_t>();
+
+        const size_t root_size = static_cast<size_t>(meta.get<uint64_t>());
+        for (size_t i = 0; i < root_size; ++i)
+        {
+            const key_type key = meta.get<key_type>();
+            const node_bid_type bid =
+                m_store->bid_at<node_bid_type>(meta.get<uint64_t>());
+            const size_type count = meta.get<uint64_t>();
+            m_root_node.insert(m_root_node.end(),
+                               root_node_pair_type(key, node_child_type(bid, count)));
+        }
+
+        // the end iterator points into the last leaf
+        leaf_type* leaf = m_leaf_cache.get_node(find_leaf(m_key_compare.max_value()));
+        assert(leaf);
+        m_end_iterator = leaf->end();
+    }
+
     void create_empty_leaf()
     {
         leaf_bid_type new_bid;
@@ -274,7 +374,7 @@ private:
         assert(leaf_fill_factor >= 0.5);
         key_type last_key = m_key_compare.max_value();
 
-        using key_bid_pair = std::pair<key_type, node_bid_type>;
+        using key_bid_pair = std::pair<key_type, node_child_type>;
         using key_bid_vector_type = typename stxxl::vector<
                   key_bid_pair, 1, stxxl::random_pager<1>, node_block_type::raw_size
                   >;
@@ -297,7 +397,9 @@ private:
                 if (leaf->size() == max_leaf_elements)
                 {
                     // overflow, need a new block
-                    bids.push_back(key_bid_pair(leaf->back().first, static_cast<node_bid_type>(new_bid)));
+                    bids.push_back(key_bid_pair(
+                                       leaf->back().first,
+                                       node_child_type(static_cast<node_bid_type>(new_bid), leaf->size())));
 
                     leaf_type* new_leaf = m_leaf_cache.get_new_node(new_bid);
                     assert(new_leaf);
@@ -331,6 +433,7 @@ private:
                 // need to rebalance
                 const key_type new_splitter = leaf->balance(*left_leaf);
                 bids.back().first = new_splitter;
+                bids.back().second.set_count(left_leaf->size());
                 assert(!left_leaf->overflows() && !left_leaf->underflows());
             }
         }
@@ -339,7 +442,9 @@ private:
 
         m_end_iterator = leaf->end();                 // initialize end() iterator
 
-        bids.push_back(key_bid_pair(m_key_compare.max_value(), static_cast<node_bid_type>(new_bid)));
+        bids.push_back(key_bid_pair(
+                           m_key_compare.max_value(),
+                           node_child_type(static_cast<node_bid_type>(new_bid), leaf->size())));
 
         const auto max_node_elements = static_cast<size_t>(
             max_node_size * node_fill_factor);
@@ -400,6 +505,7 @@ private:
 
                         const key_type new_splitter = node->balance(*left_node, false);
                         parent_bids.back().first = new_splitter;
+                        parent_bids.back().second.set_count(left_node->subtree_size());
 
                         LOG << "btree bulk construct after rebalance:"
                             << " left_node.size=" << left_node->size()
@@ -410,7 +516,9 @@ private:
                 }
                 assert(!node->overflows() && !node->underflows());
 
-                parent_bids.push_back(key_bid_pair(node->back().first, new_bid));
+                parent_bids.push_back(key_bid_pair(
+                                          node->back().first,
+                                          node_child_type(new_bid, node->subtree_size())));
             }
 
             LOG << "btree parent_bids.size()=" << parent_bids.size()
@@ -443,6 +551,8 @@ public:
           m_size(0),
           m_height(2),
           m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
           m_bm(foxxll::block_manager::get_instance())
     {
         LOG << "Creating a btree, addr=" << this;
@@ -466,6 +576,8 @@ public:
           m_size(0),
           m_height(2),
           m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
           m_bm(foxxll::block_manager::get_instance())
     {
         LOG << "Creating a btree, addr=" << this;
@@ -475,6 +587,33 @@ public:
         create_empty_leaf();
     }
 
+    //! Creates a btree whose blocks and metadata are kept in the given file.
+    //! If the file contains a btree written by sync(), it is reopened,
+    //! otherwise the btree starts empty.
+    btree(foxxll::file_ptr file,
+          const key_compare& key_compare,
+          const size_t node_cache_size_in_bytes,
+          const size_t leaf_cache_size_in_bytes)
+        : m_key_compare(key_compare),
+          m_store(new file_block_store(file, store_tag())),
+          m_node_cache(node_cache_size_in_bytes, this, m_key_compare),
+          m_leaf_cache(leaf_cache_size_in_bytes, this, m_key_compare),
+          m_iterator_map(this),
+          m_size(0),
+          m_height(2),
+          m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        LOG << "Creating a btree in a file, addr=" << this;
+
+        if (m_store->reopened())
+            read_metadata();
+        else
+            create_empty_leaf();
+    }
+
     //! non-copyable: delete copy-constructor
     btree(const btree&) = delete;
     //! non-copyable: delete assignment operator
@@ -484,7 +623,11 @@ public:
     {
         try
         {
-            deallocate_children();
+            // the blocks of a btree bound to a file stay allocated
+            if (m_store)
+                sync();
+            else
+                deallocate_children();
         }
         catch (...)
         {
@@ -520,8 +663,12 @@ public:
             assert(leaf);
             std::pair<key_type, leaf_bid_type> splitter;
             std::pair<iterator, bool> result = leaf->insert(x, splitter);
+            const size_type right_count = leaf->subtree_size();
             if (result.second)
+            {
                 ++m_size;
+                it->second.set_count(it->second.count() + 1);
+            }
 
             m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
             //if(key_compare::max_value() == Splitter.first)
@@ -532,7 +679,11 @@ public:
 
             LOG << "Inserting new value into root node";
 
-            insert_into_root(std::make_pair(splitter.first, node_bid_type(splitter.second)));
+            // the new left leaf gets the smaller part of the elements
+            const size_type left_count = it->second.count() - right_count;
+            it->second.set_count(right_count);
+            insert_into_root(root_node_pair_type(
+                                 splitter.first, node_child_type(node_bid_type(splitter.second), left_count)));
 
             assert(m_leaf_cache.nfixed() == 0);
             assert(m_node_cache.nfixed() == 0);
@@ -541,12 +692,16 @@ public:
 
         // 'it' points to a node
         LOG << "Inserting new value into a node";
-        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         std::pair<key_type, node_bid_type> splitter;
         std::pair<iterator, bool> result = node->insert(x, m_height - 1, splitter);
+        const size_type right_count = node->subtree_size();
         if (result.second)
+        {
             ++m_size;
+            it->second.set_count(it->second.count() + 1);
+        }
 
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
         //if(key_compare::max_value() == Splitter.first)
@@ -557,7 +712,11 @@ public:
 
         LOG << "Inserting new value into root node";
 
-        insert_into_root(splitter);
+        // the new left node gets the smaller part of the entries
+        const size_type left_count = it->second.count() - right_count;
+        it->second.set_count(right_count);
+        insert_into_root(root_node_pair_type(
+                             splitter.first, node_child_type(splitter.second, left_count)));
 
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
@@ -583,7 +742,7 @@ public:
 
         // 'it' points to a node
         LOG << "btree: retrieving begin() from the first node";
-        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         iterator result = node->begin(m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -611,7 +770,7 @@ public:
 
         // 'it' points to a node
         LOG << "btree: retrieving begin() from the first node";
-        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true);
+        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         const_iterator result = node->begin(m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -655,7 +814,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching in a node";
-        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         iterator result = node->find(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -686,7 +845,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching in a node";
-        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true);
+        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         const_iterator result = node->find(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -716,7 +875,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching lower bound in a node";
-        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         iterator result = node->lower_bound(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -746,7 +905,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching lower bound in a node";
-        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true);
+        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         const_iterator result = node->lower_bound(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -776,7 +935,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching upper bound in a node";
-        node_type* Node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* Node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(Node);
         iterator result = Node->upper_bound(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -806,7 +965,7 @@ public:
 
         // 'it' points to a node
         LOG << "Searching upper bound in a node";
-        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true);
+        const node_type* node = m_node_cache.get_const_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         const_iterator result = node->upper_bound(k, m_height - 1);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
@@ -816,6 +975,266 @@ public:
         return result;
     }
 
+    //! Returns an unregistered cursor at the first element not less than k.
+    cursor_type lower_bound_cursor(const key_type& k) const
+    {
+        cursor_type result(this, k);
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return result;
+    }
+
+    /*!
+     * Calls fn(value) for all elements with lo <= key < hi in ascending
+     * order. The leaves are walked directly, without any iterator
+     * bookkeeping, and the successor of each leaf is prefetched while it is
+     * processed. fn must not modify the btree.
+     */
+    template <typename Functor>
+    void for_range(const key_type& lo, const key_type& hi, Functor fn) const
+    {
+        leaf_bid_type bid = find_leaf(lo);
+        const leaf_type* leaf = m_leaf_cache.get_const_node(bid, true);
+        assert(leaf);
+        unsigned pos = leaf->lower_bound_pos(lo);
+
+        while (true)
+        {
+            const leaf_bid_type succ = leaf->succ();
+            if (m_prefetching_enabled && succ.valid())
+                m_leaf_cache.prefetch_node(succ);
+
+            for ( ; pos < leaf->size(); ++pos)
+            {
+                const_reference value = reinterpret_cast<const_reference>((*leaf)[pos]);
+                if (!m_key_compare(value.first, hi))
+                {
+                    m_leaf_cache.unfix_node(bid);
+                    return;
+                }
+                fn(value);
+            }
+
+            m_leaf_cache.unfix_node(bid);
+            if (!succ.valid())
+                return;
+
+            bid = succ;
+            leaf = m_leaf_cache.get_const_node(bid, true);
+            assert(leaf);
+            pos = 0;
+        }
+    }
+
+    /*!
+     * Looks up a batch of keys, which must be sorted ascendingly. out[i] is
+     * set to (true, data) if sorted_keys[i] is contained and to (false,
+     * data_type()) otherwise.
+     *
+     * Instead of descending once per key, the keys are routed through the
+     * tree level by level: all distinct nodes, and finally leaves, of a level
+     * are prefetched together before the keys are split among their
+     * children. Hence every node is read at most once and the reads of a
+     * level overlap. The number of blocks requested at once is bounded by
+     * half of the node or leaf cache.
+     */
+    void find_batch(const std::vector<key_type>& sorted_keys,
+                    std::vector<std::pair<bool, data_type> >& out) const
+    {
+        assert(std::is_sorted(sorted_keys.begin(), sorted_keys.end(), m_key_compare));
+
+        const size_t nkeys = sorted_keys.size();
+        out.assign(nkeys, std::pair<bool, data_type>(false, data_type()));
+        if (nkeys == 0)
+            return;
+
+        // children of the current level, each with the index of its first
+        // key, its keys range up to the first key of the next entry
+        using batch_entry = std::pair<node_bid_type, size_t>;
+        std::vector<batch_entry> level, next_level;
+
+        // route the keys through the root
+        root_node_const_iterator_type it = m_root_node.begin();
+        for (size_t i = 0; i < nkeys; ++i)
+        {
+            root_node_const_iterator_type prev = it;
+            while (m_key_compare(it->first, sorted_keys[i]))
+                ++it;
+            assert(it != m_root_node.end());
+            if (i == 0 || it != prev)
+                level.push_back(batch_entry(it->second, i));
+        }
+
+        // route the keys through the levels of inner nodes
+        const size_t node_window = std::max<size_t>(1, m_node_cache.size() / 2);
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            next_level.clear();
+            for (size_t w = 0; w < level.size(); w += node_window)
+            {
+                const size_t w_end = std::min(w + node_window, level.size());
+                if (m_prefetching_enabled)
+                {
+                    for (size_t e = w; e < w_end; ++e)
+                        m_node_cache.prefetch_node(level[e].first, height - 1);
+                }
+
+                for (size_t e = w; e < w_end; ++e)
+                {
+                    const size_t keys_end = (e + 1 < level.size()) ? level[e + 1].second : nkeys;
+                    const node_type* node = m_node_cache.get_const_node(level[e].first, true, height - 1);
+                    assert(node);
+
+                    int child = 0, prev = -1;
+                    for (size_t i = level[e].second; i < keys_end; ++i)
+                    {
+                        while (m_key_compare((*node)[child].first, sorted_keys[i]))
+                            ++child;
+                        assert(child < static_cast<int>(node->size()));
+                        if (child != prev)
+                        {
+                            next_level.push_back(batch_entry((*node)[child].second, i));
+                            prev = child;
+                        }
+                    }
+
+                    m_node_cache.unfix_node(level[e].first);
+                }
+            }
+            std::swap(level, next_level);
+        }
+
+        // answer the keys leaf by leaf
+        const size_t leaf_window = std::max<size_t>(1, m_leaf_cache.size() / 2);
+        for (size_t w = 0; w < level.size(); w += leaf_window)
+        {
+            const size_t w_end = std::min(w + leaf_window, level.size());
+            if (m_prefetching_enabled)
+            {
+                for (size_t e = w; e < w_end; ++e)
+                    m_leaf_cache.prefetch_node(static_cast<leaf_bid_type>(level[e].first));
+            }
+
+            for (size_t e = w; e < w_end; ++e)
+            {
+                const size_t keys_end = (e + 1 < level.size()) ? level[e + 1].second : nkeys;
+                const leaf_bid_type bid = static_cast<leaf_bid_type>(level[e].first);
+                const leaf_type* leaf = m_leaf_cache.get_const_node(bid, true);
+                assert(leaf);
+
+                for (size_t i = level[e].second; i < keys_end; ++i)
+                {
+                    const unsigned pos = leaf->lower_bound_pos(sorted_keys[i]);
+                    if (pos < leaf->size() &&
+                        !m_key_compare(sorted_keys[i], (*leaf)[pos].first))
+                    {
+                        out[i].first = true;
+                        out[i].second = (*leaf)[pos].second;
+                    }
+                }
+
+                m_leaf_cache.unfix_node(bid);
+            }
+        }
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+    }
+
+    //! \name Order Statistics
+    //! Only available if the btree keeps the element counts of the subtrees
+    //! in the node entries, each query reads one node per level.
+    //! \{
+
+    //! Returns the number of elements with keys less than k.
+    template <bool Enabled = order_statistics>
+    typename std::enable_if<Enabled, size_type>::type
+    rank(const key_type& k) const
+    {
+        size_type result = 0;
+
+        root_node_const_iterator_type it = m_root_node.begin();
+        for ( ; m_key_compare(it->first, k); ++it)
+            result += it->second.count();
+        assert(it != m_root_node.end());
+
+        node_bid_type bid = it->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid, true, height - 1);
+            assert(node);
+
+            int i = 0;
+            for ( ; m_key_compare((*node)[i].first, k); ++i)
+                result += (*node)[i].second.count();
+            assert(i < static_cast<int>(node->size()));
+
+            const node_bid_type child = (*node)[i].second;
+            m_node_cache.unfix_node(bid);
+            bid = child;
+        }
+
+        const leaf_type* leaf = m_leaf_cache.get_const_node(static_cast<leaf_bid_type>(bid));
+        assert(leaf);
+        result += leaf->lower_bound_pos(k);
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return result;
+    }
+
+    //! Returns an iterator to the element with rank n, i.e. the n-th smallest
+    //! key counting from zero, or end() if n >= size().
+    template <bool Enabled = order_statistics>
+    typename std::enable_if<Enabled, const_iterator>::type
+    nth(size_type n) const
+    {
+        if (n >= size())
+            return end();
+
+        root_node_const_iterator_type it = m_root_node.begin();
+        for ( ; n >= it->second.count(); ++it)
+            n -= it->second.count();
+        assert(it != m_root_node.end());
+
+        node_bid_type bid = it->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid, true, height - 1);
+            assert(node);
+
+            int i = 0;
+            for ( ; n >= (*node)[i].second.count(); ++i)
+                n -= (*node)[i].second.count();
+            assert(i < static_cast<int>(node->size()));
+
+            const node_bid_type child = (*node)[i].second;
+            m_node_cache.unfix_node(bid);
+            bid = child;
+        }
+
+        const leaf_type* leaf = m_leaf_cache.get_const_node(static_cast<leaf_bid_type>(bid));
+        assert(leaf);
+        const_iterator result = leaf->iterator_at(static_cast<unsigned>(n));
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return result;
+    }
+
+    //! Returns the number of elements with lo <= key < hi.
+    template <bool Enabled = order_statistics>
+    typename std::enable_if<Enabled, size_type>::type
+    count_range(const key_type& lo, const key_type& hi) const
+    {
+        if (!m_key_compare(lo, hi))
+            return 0;
+
+        return rank(hi) - rank(lo);
+    }
+
+    //! \}
+
     std::pair<iterator, iterator> equal_range(const key_type& k)
     {
         // l->first >= k
@@ -869,6 +1288,7 @@ public:
             assert(Leaf);
             size_type result = Leaf->erase(k);
             m_size -= result;
+            it->second.set_count(it->second.count() - result);
             m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
             assert(m_leaf_cache.nfixed() == 0);
             assert(m_node_cache.nfixed() == 0);
@@ -889,10 +1309,11 @@ public:
         // 'it' points to a node
         LOG << "Deleting key from a node";
         assert(m_root_node.size() >= 2);
-        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+        node_type* node = m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, m_height - 1);
         assert(node);
         size_type result = node->erase(k, m_height - 1);
         m_size -= result;
+        it->second.set_count(it->second.count() - result);
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
@@ -957,6 +1378,7 @@ public:
     void clear()
     {
         deallocate_children();
+        leaves_deallocated();
 
         m_root_node.clear();
 
@@ -993,6 +1415,8 @@ public:
           m_size(0),
           m_height(2),
           m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
           m_bm(foxxll::block_manager::get_instance())
     {
         LOG << "Creating a btree, addr=" << this;
@@ -1027,6 +1451,8 @@ public:
           m_size(0),
           m_height(2),
           m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
           m_bm(foxxll::block_manager::get_instance())
     {
         LOG << "Creating a btree, addr=" << this;
@@ -1047,6 +1473,45 @@ public:
         assert(m_node_cache.nfixed() == 0);
     }
 
+    //! Constructs a btree from a range in the given file, discarding the
+    //! previous contents of the file.
+    template <class InputIterator>
+    btree(foxxll::file_ptr file,
+          InputIterator begin,
+          InputIterator end,
+          const key_compare& c_,
+          const size_t node_cache_size_in_bytes,
+          const size_t leaf_cache_size_in_bytes,
+          bool range_sorted = false,
+          double node_fill_factor = 0.75,
+          double leaf_fill_factor = 0.6)
+        : m_key_compare(c_),
+          m_store(new file_block_store(file, store_tag(), true)),
+          m_node_cache(node_cache_size_in_bytes, this, m_key_compare),
+          m_leaf_cache(leaf_cache_size_in_bytes, this, m_key_compare),
+          m_iterator_map(this),
+          m_size(0),
+          m_height(2),
+          m_prefetching_enabled(true),
+          m_leaf_epoch(0),
+          m_leaf_dealloc_epoch(0),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        LOG << "Creating a btree in a file, addr=" << this;
+
+        if (range_sorted == false)
+        {
+            create_empty_leaf();
+            insert(begin, end);
+        }
+        else
+        {
+            bulk_construction(begin, end, node_fill_factor, leaf_fill_factor);
+        }
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+    }
+
     void erase(iterator first, iterator last)
     {
         if (first == begin() && last == end())
@@ -1071,14 +1536,49 @@ public:
 
         std::swap(m_node_cache, obj.m_node_cache);     // OK
         std::swap(m_leaf_cache, obj.m_leaf_cache);     // OK
+        std::swap(m_io_account, obj.m_io_account);
 
         std::swap(m_iterator_map, obj.m_iterator_map); // must update all iterators
 
         std::swap(m_end_iterator, obj.m_end_iterator);
         std::swap(m_size, obj.m_size);
         std::swap(m_height, obj.m_height);
+        std::swap(m_leaf_epoch, obj.m_leaf_epoch);
+        std::swap(m_leaf_dealloc_epoch, obj.m_leaf_dealloc_epoch);
         std::swap(m_alloc_strategy, obj.m_alloc_strategy);
         std::swap(m_root_node, obj.m_root_node);
+        std::swap(m_store, obj.m_store);
+    }
+
+    //! Writes all cached nodes and leaves, the root node and the free space
+    //! to the file the btree is bound to, such that it can be reopened. Does
+    //! nothing if the btree's blocks are temporary.
+    void sync()
+    {
+        if (!m_store)
+            return;
+
+        m_node_cache.flush();
+        m_leaf_cache.flush();
+
+        binary_buffer meta;
+        meta.put<uint64_t>(m_size);
+        meta.put<uint32_t>(m_height);
+        meta.put<uint64_t>(m_leaf_epoch);
+        meta.put<uint64_t>(m_root_node.size());
+        for (const auto& entry : m_root_node)
+        {
+            meta.put<key_type>(entry.first);
+            meta.put<uint64_t>(entry.second.offset);
+            meta.put<uint64_t>(entry.second.count());
+        }
+        m_store->commit(meta);
+    }
+
+    //! Returns true if the btree is bound to a file.
+    bool persistent() const
+    {
+        return m_store != nullptr;
     }
 
     void enable_prefetching()
@@ -1094,6 +1594,48 @@ public:
         return m_prefetching_enabled;
     }
 
+    //! Changes the sizes of the node and leaf caches, written back nodes
+    //! and leaves in excess are dropped.
+    void resize_caches(const size_t node_cache_size_in_bytes,
+                       const size_t leaf_cache_size_in_bytes)
+    {
+        if (node_cache_size_in_bytes / node_block_type::raw_size < m_height - 1)
+        {
+            FOXXLL_THROW2(std::runtime_error, "btree::resize_caches",
+                          "The height of the tree (" << m_height << ") exceeds the capacity of the node cache.");
+        }
+        m_node_cache.resize(node_cache_size_in_bytes);
+        m_leaf_cache.resize(leaf_cache_size_in_bytes);
+    }
+
+    //! Returns the fraction of the node cache reserved for the upper levels
+    double pinned_fraction() const
+    {
+        return m_node_cache.pinned_fraction();
+    }
+
+    //! Sets the fraction of the node cache reserved for the upper levels of
+    //! the tree, which are kept in the cache as far as they fit.
+    void pinned_fraction(double fraction)
+    {
+        m_node_cache.pinned_fraction(fraction);
+    }
+
+    //! Sets the account counting the I/O of the node and leaf caches, or
+    //! nullptr
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+        m_node_cache.set_io_account(account);
+        m_leaf_cache.set_io_account(account);
+    }
+
+    //! Returns the attached I/O account, or nullptr
+    io_account * get_io_account() const
+    {
+        return m_io_account;
+    }
+
     void print_statistics(std::ostream& o) const
     {
         o << "Node cache statistics:" << std::endl;
@@ -1113,13 +1655,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator ==
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
 }
@@ -1129,13 +1672,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator !=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return !(a == b);
 }
@@ -1145,13 +1689,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator <
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
 }
@@ -1161,13 +1706,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator >
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return b < a;
 }
@@ -1177,13 +1723,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator <=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return !(b < a);
 }
@@ -1193,13 +1740,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 inline bool operator >=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return !(a < b);
 }
@@ -1214,12 +1762,13 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 void swap(stxxl::btree::btree<KeyType, DataType, KeyCompareWithMaxType,
-                              LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                              LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& a,
           stxxl::btree::btree<KeyType, DataType, KeyCompareWithMaxType,
-                              LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                              LogNodeSize, LogLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     if (&a != &b)
         a.swap(b);
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/btree/cursor.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BTREE_CURSOR_HEADER
+#define STXXL_CONTAINERS_BTREE_CURSOR_HEADER
+
+#include <cassert>
+#include <cstdint>
+
+namespace stxxl {
+namespace btree {
+
+/*!
+ * Read-only cursor over the elements of a btree, which is not registered in
+ * the btree's iterator_map.
+ *
+ * Unlike btree iterators, which are fixed by the leaves on every
+ * modification, creating, copying and destroying a cursor costs no
+ * bookkeeping. Instead, the cursor remembers the modification epoch of its
+ * leaf. If the leaf was changed since, or any leaf was deallocated, the
+ * cursor finds its position again by searching for its current key. If the
+ * element the cursor points to was erased, it moves on to the next greater
+ * one. A cursor which reached the end stays there.
+ *
+ * The cursor is a model of stream, hence it can be used as input of the
+ * stream package. References obtained from it are valid until the btree is
+ * accessed again.
+ */
+template <class BTreeType>
+class btree_cursor
+{
+public:
+    using btree_type = BTreeType;
+    using bid_type = typename btree_type::leaf_bid_type;
+    using key_type = typename btree_type::key_type;
+    using leaf_type = typename btree_type::leaf_type;
+
+    //! Standard stream typedef.
+    using value_type = typename btree_type::value_type;
+    using const_reference = typename btree_type::const_reference;
+    using const_pointer = typename btree_type::const_pointer;
+
+    //! Creates a cursor which is at the end.
+    btree_cursor()
+        : m_btree(nullptr), m_pos(0), m_epoch(0), m_seen(0), m_end(true)
+    { }
+
+    //! Creates a cursor at the first element not less than k.
+    btree_cursor(const btree_type* btree, const key_type& k)
+        : m_btree(btree), m_pos(0), m_epoch(0), m_seen(0), m_end(true)
+    {
+        seek(k);
+    }
+
+    //! Standard stream method.
+    const_reference operator * () const
+    {
+        const leaf_type* leaf = current_leaf();
+        assert(leaf);
+        return reinterpret_cast<const_reference>((*leaf)[m_pos]);
+    }
+
+    //! Standard stream method.
+    const_pointer operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    btree_cursor& operator ++ ()
+    {
+        const leaf_type* leaf = current_leaf();
+        assert(leaf);
+        settle(leaf, m_pos + 1);
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        current_leaf();
+        return m_end;
+    }
+
+private:
+    //! the btree, accessed through its leaf cache only
+    const btree_type* m_btree;
+    //! leaf containing the current element
+    mutable bid_type m_bid;
+    //! position of the current element in the leaf
+    mutable unsigned m_pos;
+    //! epoch of the leaf when the position was determined
+    mutable uint64_t m_epoch;
+    //! epoch of the btree when the position was determined
+    mutable uint64_t m_seen;
+    //! key of the current element, to find it again after modifications
+    mutable key_type m_key;
+    //! whether the cursor is past the last element
+    mutable bool m_end;
+
+    //! positions the cursor at the first element not less than k
+    void seek(const key_type& k) const
+    {
+        m_bid = m_btree->find_leaf(k);
+        const leaf_type* leaf = m_btree->m_leaf_cache.get_const_node(m_bid);
+        assert(leaf);
+        settle(leaf, leaf->lower_bound_pos(k));
+    }
+
+    //! positions the cursor at pos in the given leaf, which is m_bid, or at
+    //! the first element of the successors if pos is past the leaf's end
+    void settle(const leaf_type* leaf, unsigned pos) const
+    {
+        while (pos == leaf->size())
+        {
+            if (!leaf->succ().valid())
+            {
+                m_end = true;
+                return;
+            }
+            m_bid = leaf->succ();
+            leaf = m_btree->m_leaf_cache.get_const_node(m_bid);
+            assert(leaf);
+            pos = 0;
+        }
+
+        m_pos = pos;
+        m_epoch = leaf->epoch();
+        m_seen = m_btree->m_leaf_epoch;
+        m_key = (*leaf)[pos].first;
+        m_end = false;
+    }
+
+    //! returns the leaf of the current element, after finding the position
+    //! again if the btree was modified, or nullptr at the end
+    const leaf_type * current_leaf() const
+    {
+        if (m_end)
+            return nullptr;
+
+        // the leaf may not be read if it was deallocated
+        if (m_btree->m_leaf_dealloc_epoch <= m_seen)
+        {
+            const leaf_type* leaf = m_btree->m_leaf_cache.get_const_node(m_bid);
+            assert(leaf);
+            if (leaf->epoch() == m_epoch)
+                return leaf;
+        }
+
+        seek(m_key);
+        if (m_end)
+            return nullptr;
+
+        return m_btree->m_leaf_cache.get_const_node(m_bid);
+    }
+};
+
+} // namespace btree
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BTREE_CURSOR_HEADER
@@ -14,6 +14,7 @@
 #define STXXL_CONTAINERS_BTREE_LEAF_HEADER
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <utility>
 #include <vector>
@@ -54,6 +55,8 @@ public:
     {
         bid_type me, pred, succ;
         unsigned cur_size;
+        //! modification epoch, changes whenever elements move
+        uint64_t epoch;
     };
 
     using block_type = foxxll::typed_block<raw_size, value_type, 0, metainfo_type>;
@@ -91,6 +94,13 @@ private:
     key_compare m_cmp;
     value_compare m_vcmp;
 
+    //! assigns a new modification epoch, which invalidates the positions
+    //! held by btree_cursor objects in this leaf
+    void touch()
+    {
+        m_block->info.epoch = m_btree->next_leaf_epoch();
+    }
+
     void split(std::pair<key_type, bid_type>& splitter)
     {
         bid_type new_bid;
@@ -130,6 +140,8 @@ private:
                   m_block->begin() + old_size, m_block->begin());
         m_block->info.cur_size = old_size - end_of_smaller_part;
         assert(size() + new_leaf->size() == old_size);
+        touch();
+        new_leaf->touch();
 
         // fix iterators
         for (typename iterators2fix_type::iterator it2fix = iterators2fix.begin();
@@ -226,11 +238,22 @@ public:
         return m_block->info.cur_size;
     }
 
+    //! number of elements, for uniform treatment with normal_node
+    size_type subtree_size() const
+    {
+        return size();
+    }
+
     const bid_type & my_bid() const
     {
         return m_block->info.me;
     }
 
+    uint64_t epoch() const
+    {
+        return m_block->info.epoch;
+    }
+
     void save()
     {
         foxxll::request_ptr req = m_block->write(my_bid());
@@ -241,10 +264,22 @@ public:
     {
         foxxll::request_ptr req = m_block->read(bid);
         req->wait();
+        if (m_btree->m_store)
+            relocate(bid.storage);
         assert(bid == my_bid());
         return req;
     }
 
+    //! points the BIDs of a leaf read from a reopened file at the file
+    void relocate(foxxll::file* storage)
+    {
+        m_block->info.me.storage = storage;
+        if (m_block->info.pred.valid())
+            m_block->info.pred.storage = storage;
+        if (m_block->info.succ.valid())
+            m_block->info.succ.storage = storage;
+    }
+
     foxxll::request_ptr prefetch(const bid_type& bid)
     {
         return m_block->read(bid);
@@ -256,6 +291,7 @@ public:
         m_block->info.succ = bid_type();
         m_block->info.pred = bid_type();
         m_block->info.cur_size = 0;
+        touch();
     }
 
     reference operator [] (const size_t i)
@@ -332,6 +368,7 @@ public:
         }
 
         ++(m_block->info.cur_size);
+        touch();
 
         std::pair<iterator, bool> result(iterator(m_btree, my_bid(), unsigned(it - m_block->begin())), true);
 
@@ -469,6 +506,24 @@ public:
         return const_iterator(m_btree, my_bid(), unsigned(lb - m_block->begin()));
     }
 
+    //! iterator to the element at position pos of this leaf
+    const_iterator iterator_at(unsigned pos) const
+    {
+        assert(pos < size());
+        return const_iterator(m_btree, my_bid(), pos);
+    }
+
+    //! position of the first element not less than k in this leaf, which
+    //! is size() if all elements are less
+    unsigned lower_bound_pos(const key_type& k) const
+    {
+        value_type search_val(k, data_type());
+        typename block_type::iterator lb =
+            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+
+        return unsigned(lb - m_block->begin());
+    }
+
     iterator upper_bound(const key_type& k)
     {
         value_type search_val(k, data_type());
@@ -524,6 +579,7 @@ public:
         }
 
         --(m_block->info.cur_size);
+        touch();
 
         return 1;
     }
@@ -568,6 +624,9 @@ public:
         }
 
         m_block->info.cur_size += src_size;
+        touch();
+        // src is deallocated by the caller
+        m_btree->leaves_deallocated();
 
         // update links
         pred() = src.pred();
@@ -677,6 +736,8 @@ public:
 
         m_block->info.cur_size = new_right_size;                             // update size
         left.m_block->info.cur_size = new_left_size;                         // update size
+        touch();
+        left.touch();
 
         return left.back().first;
     }
@@ -685,6 +746,7 @@ public:
     {
         (*this)[size()] = x;
         ++(m_block->info.cur_size);
+        touch();
     }
 };
 
@@ -19,6 +19,7 @@
 
 #include <stxxl/bits/containers/btree/iterator.h>
 #include <stxxl/bits/containers/btree/node_cache.h>
+#include <stxxl/types>
 
 namespace stxxl {
 namespace btree {
@@ -26,6 +27,46 @@ namespace btree {
 template <class NodeType, class BTreeType>
 class node_cache;
 
+/*!
+ * BID of a child in the entries of normal_node and of the root node, which
+ * also holds the number of elements in the child's subtree if the btree keeps
+ * order statistics.
+ */
+template <class BidType, bool Counted>
+class counted_bid : public BidType
+{
+public:
+    counted_bid()
+        : BidType(), m_count(0) { }
+
+    counted_bid(const BidType& bid, external_size_type count = 0)
+        : BidType(bid), m_count(count) { }
+
+    //! number of elements in the subtree
+    external_size_type count() const { return m_count; }
+
+    void set_count(external_size_type count) { m_count = count; }
+
+private:
+    external_size_type m_count;
+};
+
+//! Child BID without a subtree count, the counts are always zero.
+template <class BidType>
+class counted_bid<BidType, false> : public BidType
+{
+public:
+    counted_bid()
+        : BidType() { }
+
+    counted_bid(const BidType& bid, external_size_type /* count */ = 0)
+        : BidType(bid) { }
+
+    external_size_type count() const { return 0; }
+
+    void set_count(external_size_type /* count */) { }
+};
+
 template <class KeyType, class KeyCompareWithMax, unsigned RawSize, class BTreeType>
 class normal_node
 {
@@ -45,7 +86,8 @@ public:
     using bid_type = foxxll::BID<raw_size>;
     using node_bid_type = bid_type;
     using node_type = self_type;
-    using value_type = std::pair<key_type, bid_type>;
+    using child_type = counted_bid<bid_type, BTreeType::order_statistics>;
+    using value_type = std::pair<key_type, child_type>;
     using reference = value_type &;
     using const_reference = const value_type &;
 
@@ -93,7 +135,7 @@ private:
     key_compare m_cmp;
     value_compare m_vcmp;
 
-    std::pair<key_type, bid_type> insert(const std::pair<key_type, bid_type>& splitter,
+    std::pair<key_type, bid_type> insert(const value_type& splitter,
                                          const block_iterator& place2insert)
     {
         std::pair<key_type, bid_type> result(m_cmp.max_value(), bid_type());
@@ -168,6 +210,9 @@ private:
         local_node_type* left_node = cache.get_node(left_bid, true);
         local_node_type* right_node = cache.get_node(right_bid, true);
 
+        const external_size_type total_count =
+            leftIt->second.count() + rightIt->second.count();
+
         const unsigned total_size = left_node->size() + right_node->size();
         if (total_size <= right_node->max_nelements())
         {
@@ -175,6 +220,7 @@ private:
 
             // add the content of left_node to right_node
             right_node->fuse(*left_node);
+            rightIt->second.set_count(total_count);
 
             cache.unfix_node(right_bid);
             // 'delete_node' unfixes left-bid also
@@ -194,6 +240,10 @@ private:
             leftIt->first = new_splitter;
             assert(m_vcmp(*leftIt, *rightIt));
 
+            const external_size_type left_count = left_node->subtree_size();
+            leftIt->second.set_count(left_count);
+            rightIt->second.set_count(total_count - left_count);
+
             cache.unfix_node(left_bid);
             cache.unfix_node(right_bid);
         }
@@ -264,6 +314,16 @@ public:
         return m_block->info.cur_size;
     }
 
+    //! number of elements in the subtree, which is always zero if the btree
+    //! keeps no order statistics
+    external_size_type subtree_size() const
+    {
+        external_size_type result = 0;
+        for (unsigned i = 0; i < size(); ++i)
+            result += (*m_block)[i].second.count();
+        return result;
+    }
+
     bid_type my_bid() const
     {
         return m_block->info.me;
@@ -279,10 +339,20 @@ public:
     {
         foxxll::request_ptr req = m_block->read(bid);
         req->wait();
+        if (m_btree->m_store)
+            relocate(bid.storage);
         assert(bid == my_bid());
         return req;
     }
 
+    //! points the BIDs of a node read from a reopened file at the file
+    void relocate(foxxll::file* storage)
+    {
+        m_block->info.me.storage = storage;
+        for (unsigned i = 0; i < size(); ++i)
+            (*m_block)[i].second.storage = storage;
+    }
+
     foxxll::request_ptr prefetch(const bid_type& bid)
     {
         return m_block->read(bid);
@@ -346,7 +416,10 @@ public:
             assert(leaf);
             std::pair<key_type, leaf_bid_type> bot_splitter;
             std::pair<iterator, bool> result = leaf->insert(x, bot_splitter);
+            const external_size_type right_count = leaf->subtree_size();
             m_btree->m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
+            if (result.second)
+                it->second.set_count(it->second.count() + 1);
             //if(key_compare::max_value() == BotSplitter.first)
             if (!(m_cmp(m_cmp.max_value(), bot_splitter.first) ||
                   m_cmp(bot_splitter.first, m_cmp.max_value())))
@@ -355,18 +428,24 @@ public:
 
             LOG << "btree::normal_node Inserting new value in *this";
 
-            splitter = insert(std::make_pair(bot_splitter.first, bid_type(bot_splitter.second)), it);
+            // the new left leaf gets the smaller part of the elements
+            const external_size_type left_count = it->second.count() - right_count;
+            it->second.set_count(right_count);
+            splitter = insert(value_type(bot_splitter.first,
+                                         child_type(bid_type(bot_splitter.second), left_count)), it);
 
             return result;
         }
         else
         {                               // found_bid points to a node
             LOG << "btree::normal_node Inserting new value into a node";
-            node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(it->second), true);
+            node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(it->second), true, height - 1);
             assert(node);
             std::pair<key_type, node_bid_type> bot_splitter;
             std::pair<iterator, bool> result = node->insert(x, height - 1, bot_splitter);
             m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
+            if (result.second)
+                it->second.set_count(it->second.count() + 1);
             //if(key_compare::max_value() == BotSplitter.first)
             if (!(m_cmp(m_cmp.max_value(), bot_splitter.first) ||
                   m_cmp(bot_splitter.first, m_cmp.max_value())))
@@ -375,7 +454,13 @@ public:
 
             LOG << "btree::normal_node Inserting new value in *this";
 
-            splitter = insert(bot_splitter, it);
+            // the child was unfixed, but no other node was loaded since
+            const external_size_type right_count = node->subtree_size();
+            // the new left node gets the smaller part of the entries
+            const external_size_type left_count = it->second.count() - right_count;
+            it->second.set_count(right_count);
+            splitter = insert(value_type(bot_splitter.first,
+                                         child_type(bot_splitter.second, left_count)), it);
 
             return result;
         }
@@ -395,7 +480,7 @@ public:
         else
         {                         // FirstBid points to a node
             LOG << "btree: retrieveing begin() from the first node";
-            node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(first_bid), true);
+            node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(first_bid), true, height - 1);
             assert(node);
             iterator result = node->begin(height - 1);
             m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(first_bid));
@@ -417,7 +502,7 @@ public:
         else
         {                         // FirstBid points to a node
             LOG << "btree: retrieveing begin() from the first node";
-            const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(FirstBid), true);
+            const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(FirstBid), true, height - 1);
             assert(node);
             const_iterator result = node->begin(height - 1);
             m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(FirstBid));
@@ -449,7 +534,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching in a node";
-        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true);
+        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         iterator result = node->find(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -481,7 +566,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching in a node";
-        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true);
+        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         const_iterator result = node->find(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -513,7 +598,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching lower bound in a node";
-        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true);
+        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         iterator result = node->lower_bound(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -545,7 +630,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching lower bound in a node";
-        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true);
+        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         const_iterator result = node->lower_bound(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -553,6 +638,31 @@ public:
         return result;
     }
 
+    //! returns the leaf in which lower_bound(k) starts searching, without
+    //! creating an iterator
+    leaf_bid_type find_leaf(const key_type& k, unsigned height) const
+    {
+        value_type key2search(k, bid_type());
+        assert(!m_vcmp(back(), key2search));
+        block_iterator it =
+            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+
+        assert(it != (m_block->begin() + size()));
+
+        bid_type found_bid = it->second;
+
+        if (height == 2)                // found_bid points to a leaf
+            return static_cast<leaf_bid_type>(found_bid);
+
+        // found_bid points to a node
+        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true, height - 1);
+        assert(node);
+        leaf_bid_type result = node->find_leaf(k, height - 1);
+        m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
+
+        return result;
+    }
+
     iterator upper_bound(const key_type& k, unsigned height)
     {
         value_type key2search(k, bid_type());
@@ -577,7 +687,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching upper bound in a node";
-        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true);
+        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         iterator result = node->upper_bound(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -609,7 +719,7 @@ public:
 
         // found_bid points to a node
         LOG << "Searching upper bound in a node";
-        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true);
+        const node_type* node = m_btree->m_node_cache.get_const_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         const_iterator result = node->upper_bound(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
@@ -706,6 +816,7 @@ public:
             assert(leaf);
             size_type result = leaf->erase(k);
             m_btree->m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
+            it->second.set_count(it->second.count() - result);
             if (!leaf->underflows())
                 return result;
             // no underflow or root has a special degree 1 (too few elements)
@@ -718,10 +829,11 @@ public:
 
         // 'found_bid' points to a node
         LOG << "btree::normal_node Deleting key from a node";
-        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true);
+        node_type* node = m_btree->m_node_cache.get_node(static_cast<node_bid_type>(found_bid), true, height - 1);
         assert(node);
         size_type result = node->erase(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
+        it->second.set_count(it->second.count() - result);
         if (!node->underflows())
             return result;
         // no underflow happened
@@ -25,6 +25,7 @@
 #include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
+#include <stxxl/bits/common/io_account.h>
 #include <stxxl/bits/config.h>
 #include <stxxl/bits/containers/pager.h>
 
@@ -49,6 +50,9 @@ public:
     using alloc_strategy_type = typename btree_type::alloc_strategy_type;
     using pager_type = stxxl::lru_pager<>;
 
+    //! default fraction of the cache reserved for the upper levels
+    static constexpr double default_pinned_fraction = 0.5;
+
 private:
     btree_type* m_btree;
     key_compare m_cmp;
@@ -94,6 +98,30 @@ private:
     uint64_t n_written { 0 };
     uint64_t n_clean_forced { 0 };
 
+    //! level of each cached node above the leaves (leaves are level 1), or
+    //! 0 if unknown
+    std::vector<unsigned> m_level;
+    //! number of cached nodes per level
+    std::vector<size_t> m_level_nodes;
+    //! fraction of the cache reserved for the upper levels of the tree
+    double m_pinned_fraction;
+    //! the cached nodes of this and all higher levels are pinned
+    unsigned m_pin_level;
+
+    struct level_stats
+    {
+        uint64_t n_found { 0 };
+        uint64_t n_not_found { 0 };
+    };
+
+    //! hits and misses per level
+    std::vector<level_stats> m_level_stats;
+
+    //! account counting the I/O of the cache, or nullptr
+    io_account* m_io_account = nullptr;
+    //! true iff the node was prefetched and not accessed since
+    std::vector<bool> m_prefetched;
+
     // changes btree pointer in all contained iterators
     void change_btree_pointers(btree_type* b)
     {
@@ -104,30 +132,175 @@ private:
         }
     }
 
-public:
-    node_cache(const size_t cache_size_in_bytes,
-               btree_type* btree,
-               key_compare cmp)
-        : m_btree(btree),
-          m_cmp(cmp),
-          m_bm(foxxll::block_manager::get_instance())
+    // allocates a block in the btree's file or on the disks
+    void new_block(bid_type& bid)
+    {
+        if (m_btree->m_store)
+            m_btree->m_store->new_block(bid);
+        else
+            m_bm->new_block(m_alloc_strategy, bid);
+    }
+
+    void delete_block(const bid_type& bid)
+    {
+        if (m_btree->m_store)
+            m_btree->m_store->delete_block(bid);
+        else
+            m_bm->delete_block(bid);
+    }
+
+    // waits for a pending read of the node, BIDs read from a reopened file
+    // are pointed at the btree's file
+    void complete_read(size_t nodeindex)
+    {
+        if (!m_reqs[nodeindex].valid())
+            return;
+
+        {
+            io_account::wait_timer wait(m_io_account);
+            m_reqs[nodeindex]->wait();
+        }
+        m_reqs[nodeindex] = foxxll::request_ptr();
+        if (m_btree->m_store)
+            m_nodes[nodeindex]->relocate(m_btree->m_store->file().get());
+    }
+
+    void account_write()
+    {
+        if (m_io_account)
+            m_io_account->add_write(1, block_type::raw_size);
+    }
+
+    void account_read()
+    {
+        if (m_io_account)
+            m_io_account->add_read(1, block_type::raw_size);
+    }
+
+    void account_prefetch(size_t nodeindex)
+    {
+        m_prefetched[nodeindex] = true;
+        if (m_io_account)
+        {
+            m_io_account->add_prefetch(1);
+            m_io_account->add_read(1, block_type::raw_size);
+        }
+    }
+
+    // the node leaves the cache, counts it if it was prefetched in vain
+    void drop_prefetched(size_t nodeindex)
+    {
+        if (!m_prefetched[nodeindex])
+            return;
+        m_prefetched[nodeindex] = false;
+        if (m_io_account)
+            m_io_account->add_wasted(1);
+    }
+
+    // whether the node belongs to the upper levels kept in the cache
+    bool pinned(size_t nodeindex) const
+    {
+        return m_level[nodeindex] != 0 && m_level[nodeindex] >= m_pin_level;
+    }
+
+    // pins the levels from the top down as long as all their cached nodes
+    // fit into the reserved fraction of the cache
+    void update_pin_level()
+    {
+        const size_t budget =
+            static_cast<size_t>(m_pinned_fraction * static_cast<double>(size()));
+        size_t npinned = 0;
+        unsigned level = static_cast<unsigned>(m_level_nodes.size());
+        while (level > 1 && npinned + m_level_nodes[level - 1] <= budget)
+            npinned += m_level_nodes[--level];
+        m_pin_level = level;
+    }
+
+    // sets the level of a cache slot, 0 if the level is unknown or the slot
+    // is released
+    void set_level(size_t nodeindex, unsigned level)
+    {
+        if (m_level[nodeindex] == level)
+            return;
+
+        if (m_level[nodeindex] != 0)
+            --m_level_nodes[m_level[nodeindex]];
+        if (level != 0)
+        {
+            if (level >= m_level_nodes.size())
+                m_level_nodes.resize(level + 1, 0);
+            ++m_level_nodes[level];
+        }
+        m_level[nodeindex] = level;
+
+        update_pin_level();
+    }
+
+    void count_access(unsigned level, bool found)
+    {
+        if (level >= m_level_stats.size())
+            m_level_stats.resize(level + 1);
+        if (found)
+            ++m_level_stats[level].n_found;
+        else
+            ++m_level_stats[level].n_not_found;
+    }
+
+    // picks a node to kick out of the full cache: the least recently used
+    // one which is neither fixed nor pinned, or the least recently used
+    // pinned one if there is none. Returns size() if all nodes are fixed.
+    size_t kick_node()
+    {
+        size_t fallback = size();
+        for (size_t i = 0; i < size(); ++i)
+        {
+            const size_t node2kick = m_pager.kick();
+            m_pager.hit(node2kick);
+            if (m_fixed[node2kick])
+                continue;
+            if (!pinned(node2kick))
+                return node2kick;
+            if (fallback == size())
+                fallback = node2kick;
+        }
+        return fallback;
+    }
+
+    // allocates nnodes cache slots
+    void create_nodes(size_t nnodes)
     {
-        const size_t nnodes = cache_size_in_bytes / block_type::raw_size;
-        LOG << "btree::node_cache constructor nodes=" << nnodes;
         if (nnodes < 3)
         {
             FOXXLL_THROW2(std::runtime_error, "btree::node_cache::node_cache", "Too few memory for a node cache (<3)");
         }
+        const size_t old_size = m_nodes.size();
         m_nodes.reserve(nnodes);
         m_reqs.resize(nnodes);
+        m_prefetched.resize(nnodes, false);
         m_free_nodes.reserve(nnodes);
         m_fixed.resize(nnodes, false);
         m_dirty.resize(nnodes, true);
-        for (size_t i = 0; i < nnodes; ++i)
+        m_level.resize(nnodes, 0);
+        for (size_t i = old_size; i < nnodes; ++i)
         {
             m_nodes.push_back(new node_type(m_btree, m_cmp));
             m_free_nodes.push_back(i);
         }
+    }
+
+public:
+    node_cache(const size_t cache_size_in_bytes,
+               btree_type* btree,
+               key_compare cmp)
+        : m_btree(btree),
+          m_cmp(cmp),
+          m_bm(foxxll::block_manager::get_instance()),
+          m_pinned_fraction(default_pinned_fraction),
+          m_pin_level(0)
+    {
+        const size_t nnodes = cache_size_in_bytes / block_type::raw_size;
+        LOG << "btree::node_cache constructor nodes=" << nnodes;
+        create_nodes(nnodes);
 
         pager_type tmp_pager(nnodes);
         std::swap(m_pager, tmp_pager);
@@ -143,6 +316,109 @@ public:
         return m_nodes.size();
     }
 
+    /*!
+     * Changes the capacity of the cache. Nodes in the released slots are
+     * written back if dirty and dropped from the cache, they must not be
+     * fixed.
+     */
+    void resize(const size_t cache_size_in_bytes)
+    {
+        const size_t nnodes = cache_size_in_bytes / block_type::raw_size;
+        LOG << "btree::node_cache resize nodes=" << size() << " -> " << nnodes;
+
+        if (nnodes >= size())
+        {
+            create_nodes(nnodes);
+        }
+        else
+        {
+            if (nnodes < 3)
+            {
+                FOXXLL_THROW2(std::runtime_error, "btree::node_cache::resize", "Too few memory for a node cache (<3)");
+            }
+
+            std::vector<bool> is_free(size(), false);
+            for (const size_t& i : m_free_nodes)
+                is_free[i] = true;
+
+            for (size_t i = nnodes; i < size(); ++i)
+            {
+                if (!is_free[i])
+                {
+                    if (m_fixed[i])
+                    {
+                        FOXXLL_THROW2(std::runtime_error, "btree::node_cache::resize", "Cannot release a fixed node.");
+                    }
+                    complete_read(i);
+                    if (m_dirty[i])
+                    {
+                        m_nodes[i]->save();
+                        account_write();
+                        ++n_written;
+                    }
+                    drop_prefetched(i);
+                    m_bid2node.erase(m_nodes[i]->my_bid());
+                    set_level(i, 0);
+                }
+                delete m_nodes[i];
+            }
+
+            m_free_nodes.erase(
+                std::remove_if(m_free_nodes.begin(), m_free_nodes.end(),
+                               [nnodes](const size_t& i) { return i >= nnodes; }),
+                m_free_nodes.end());
+            m_nodes.resize(nnodes);
+            m_reqs.resize(nnodes);
+            m_prefetched.resize(nnodes);
+            m_fixed.resize(nnodes);
+            m_dirty.resize(nnodes);
+            m_level.resize(nnodes);
+        }
+
+        m_pager.resize(nnodes);
+        update_pin_level();
+
+        assert(size() == m_bid2node.size() + m_free_nodes.size());
+    }
+
+    //! Returns the fraction of the cache reserved for the upper levels
+    double pinned_fraction() const
+    {
+        return m_pinned_fraction;
+    }
+
+    /*!
+     * Sets the fraction of the cache reserved for the upper levels of the
+     * tree. Starting from the top, the nodes of each level are pinned as
+     * long as they and all nodes above fit into the fraction; pinned nodes
+     * are only kicked out if all other nodes are fixed. Only nodes requested
+     * with their level are considered.
+     */
+    void pinned_fraction(double fraction)
+    {
+        if (fraction < 0.0 || fraction > 1.0)
+        {
+            FOXXLL_THROW2(std::runtime_error, "btree::node_cache::pinned_fraction", "The fraction must be within [0, 1].");
+        }
+        m_pinned_fraction = fraction;
+        update_pin_level();
+    }
+
+    //! Sets the account counting the I/O of the cache, or nullptr
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+    }
+
+    //! Returns the number of cached nodes of the pinned levels
+    size_t npinned() const
+    {
+        size_t result = 0;
+        for (size_t l = m_pin_level; l < m_level_nodes.size(); ++l)
+            result += m_level_nodes[l];
+        return result;
+    }
+
     // returns the number of fixed pages
     size_t nfixed() const
     {
@@ -161,35 +437,30 @@ public:
                 m_reqs[p]->wait();
 
             if (m_dirty[p])
+            {
                 m_nodes[p]->save();
+                account_write();
+            }
         }
 
         for (size_t i = 0; i < size(); ++i)
             delete m_nodes[i];
     }
 
-    node_type * get_new_node(bid_type& new_bid)
+    node_type * get_new_node(bid_type& new_bid, unsigned level = 0)
     {
         ++n_created;
 
         if (m_free_nodes.empty())
         {
             // need to kick a node
-            size_t node2kick;
+            const size_t node2kick = kick_node();
+            if (node2kick == size())
             {
-                size_t i = 0;
-                const size_t max_tries = size() + 1;
-                do {
-                    ++i;
-                    node2kick = m_pager.kick();
-                    if (i == max_tries) {
-                        LOG1 <<
-                            "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
-                            "Returning nullptr node.";
-                        return nullptr;
-                    }
-                    m_pager.hit(node2kick);
-                } while (m_fixed[node2kick]);
+                LOG1 <<
+                    "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
+                    "Returning nullptr node.";
+                return nullptr;
             }
             if (m_reqs[node2kick].valid())
                 m_reqs[node2kick]->wait();
@@ -199,6 +470,7 @@ public:
             if (m_dirty[node2kick])
             {
                 node.save();
+                account_write();
                 ++n_written;
             }
             else
@@ -207,14 +479,16 @@ public:
             //reqs_[node2kick] = request_ptr(); // reset request
 
             assert(m_bid2node.find(node.my_bid()) != m_bid2node.end());
+            drop_prefetched(node2kick);
             m_bid2node.erase(node.my_bid());
-            m_bm->new_block(m_alloc_strategy, new_bid);
+            new_block(new_bid);
 
             m_bid2node[new_bid] = node2kick;
 
             node.init(new_bid);
 
             m_dirty[node2kick] = true;
+            set_level(node2kick, level);
 
             assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -227,7 +501,7 @@ public:
         m_free_nodes.pop_back();
         assert(m_fixed[free_node] == false);
 
-        m_bm->new_block(m_alloc_strategy, new_bid);
+        new_block(new_bid);
         m_bid2node[new_bid] = free_node;
         node_type& node = *(m_nodes[free_node]);
         node.init(new_bid);
@@ -237,6 +511,7 @@ public:
         m_pager.hit(free_node);
 
         m_dirty[free_node] = true;
+        set_level(free_node, level);
 
         assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -245,7 +520,11 @@ public:
         return &node;
     }
 
-    node_type * get_node(const bid_type& bid, bool fix = false)
+    //! Returns the node with the given BID, loading it if necessary.
+    //! \param fix keep the node in the cache until unfix_node() is called
+    //! \param level level of the node above the leaves, 0 if unknown
+    node_type * get_node(const bid_type& bid, bool fix = false,
+                         unsigned level = 0)
     {
         typename bid2node_type::const_iterator it = m_bid2node.find(bid);
         ++n_read;
@@ -259,34 +538,30 @@ public:
             m_pager.hit(nodeindex);
             m_dirty[nodeindex] = true;
 
-            if (m_reqs[nodeindex].valid() && !m_reqs[nodeindex]->poll())
-                m_reqs[nodeindex]->wait();
+            complete_read(nodeindex);
+            m_prefetched[nodeindex] = false;
+            if (level != 0)
+                set_level(nodeindex, level);
 
             ++n_found;
+            count_access(level, true);
             return m_nodes[nodeindex];
         }
 
         ++n_not_found;
+        count_access(level, false);
 
         // the node is not in cache
         if (m_free_nodes.empty())
         {
             // need to kick a node
-            size_t node2kick;
+            const size_t node2kick = kick_node();
+            if (node2kick == size())
             {
-                size_t i = 0;
-                const size_t max_tries = size() + 1;
-                do {
-                    ++i;
-                    node2kick = m_pager.kick();
-                    if (i == max_tries) {
-                        LOG1 <<
-                            "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
-                            "Returning nullptr node.";
-                        return nullptr;
-                    }
-                    m_pager.hit(node2kick);
-                } while (m_fixed[node2kick]);
+                LOG1 <<
+                    "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
+                    "Returning nullptr node.";
+                return nullptr;
             }
 
             if (m_reqs[node2kick].valid())
@@ -297,19 +572,24 @@ public:
             if (m_dirty[node2kick])
             {
                 node.save();
+                account_write();
                 ++n_written;
             }
             else
                 ++n_clean_forced;
 
+            drop_prefetched(node2kick);
             m_bid2node.erase(node.my_bid());
 
             m_reqs[node2kick] = node.load(bid);
+
+            account_read();
             m_bid2node[bid] = node2kick;
 
             m_fixed[node2kick] = fix;
 
             m_dirty[node2kick] = true;
+            set_level(node2kick, level);
 
             assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -324,6 +604,7 @@ public:
 
         node_type& node = *(m_nodes[free_node]);
         m_reqs[free_node] = node.load(bid);
+        account_read();
         m_bid2node[bid] = free_node;
 
         m_pager.hit(free_node);
@@ -331,6 +612,7 @@ public:
         m_fixed[free_node] = fix;
 
         m_dirty[free_node] = true;
+        set_level(free_node, level);
 
         assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -339,7 +621,8 @@ public:
         return &node;
     }
 
-    node_type const * get_const_node(const bid_type& bid, bool fix = false)
+    node_type const * get_const_node(const bid_type& bid, bool fix = false,
+                                     unsigned level = 0)
     {
         typename bid2node_type::const_iterator it = m_bid2node.find(bid);
         ++n_read;
@@ -352,35 +635,31 @@ public:
             m_fixed[nodeindex] = fix;
             m_pager.hit(nodeindex);
 
-            if (m_reqs[nodeindex].valid() && !m_reqs[nodeindex]->poll())
-                m_reqs[nodeindex]->wait();
+            complete_read(nodeindex);
+            m_prefetched[nodeindex] = false;
+            if (level != 0)
+                set_level(nodeindex, level);
 
             ++n_found;
+            count_access(level, true);
             return m_nodes[nodeindex];
         }
 
         ++n_not_found;
+        count_access(level, false);
 
         // the node is not in cache
         if (m_free_nodes.empty())
         {
             // need to kick a node
-            size_t node2kick;
-            size_t i = 0;
-            const size_t max_tries = size() + 1;
-            do
+            const size_t node2kick = kick_node();
+            if (node2kick == size())
             {
-                ++i;
-                node2kick = m_pager.kick();
-                if (i == max_tries)
-                {
-                    LOG1 <<
-                        "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
-                        "Returning nullptr node.";
-                    return nullptr;
-                }
-                m_pager.hit(node2kick);
-            } while (m_fixed[node2kick]);
+                LOG1 <<
+                    "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
+                    "Returning nullptr node.";
+                return nullptr;
+            }
 
             if (m_reqs[node2kick].valid())
                 m_reqs[node2kick]->wait();
@@ -389,19 +668,24 @@ public:
             if (m_dirty[node2kick])
             {
                 node.save();
+                account_write();
                 ++n_written;
             }
             else
                 ++n_clean_forced;
 
+            drop_prefetched(node2kick);
             m_bid2node.erase(node.my_bid());
 
             m_reqs[node2kick] = node.load(bid);
+
+            account_read();
             m_bid2node[bid] = node2kick;
 
             m_fixed[node2kick] = fix;
 
             m_dirty[node2kick] = false;
+            set_level(node2kick, level);
 
             assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -416,6 +700,7 @@ public:
 
         node_type& node = *(m_nodes[free_node]);
         m_reqs[free_node] = node.load(bid);
+        account_read();
         m_bid2node[bid] = free_node;
 
         m_pager.hit(free_node);
@@ -423,6 +708,7 @@ public:
         m_fixed[free_node] = fix;
 
         m_dirty[free_node] = false;
+        set_level(free_node, level);
 
         assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -445,20 +731,40 @@ public:
                     m_reqs[nodeindex]->wait();
 
                 //reqs_[nodeindex] = request_ptr(); // reset request
+                drop_prefetched(nodeindex);
                 m_free_nodes.push_back(nodeindex);
                 m_bid2node.erase(bid);
                 m_fixed[nodeindex] = false;
+                set_level(nodeindex, 0);
             }
             ++n_deleted;
         } catch (const foxxll::io_error& ex)
         {
-            m_bm->delete_block(bid);
+            delete_block(bid);
             throw foxxll::io_error(ex.what());
         }
-        m_bm->delete_block(bid);
+        delete_block(bid);
     }
 
-    void prefetch_node(const bid_type& bid)
+    //! writes all modified nodes, which stay in the cache
+    void flush()
+    {
+        for (const auto& it : m_bid2node)
+        {
+            const size_t& p = it.second;
+            complete_read(p);
+
+            if (m_dirty[p])
+            {
+                m_nodes[p]->save();
+                account_write();
+                m_dirty[p] = false;
+                ++n_written;
+            }
+        }
+    }
+
+    void prefetch_node(const bid_type& bid, unsigned level = 0)
     {
         if (m_bid2node.find(bid) != m_bid2node.end())
             return;
@@ -467,22 +773,14 @@ public:
         if (m_free_nodes.empty())
         {
             // need to kick a node
-            size_t node2kick;
-            size_t i = 0;
-            const size_t max_tries = size() + 1;
-            do
+            const size_t node2kick = kick_node();
+            if (node2kick == size())
             {
-                ++i;
-                node2kick = m_pager.kick();
-                if (i == max_tries)
-                {
-                    LOG1 <<
-                        "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
-                        "Returning nullptr node.";
-                    return;
-                }
-                m_pager.hit(node2kick);
-            } while (m_fixed[node2kick]);
+                LOG1 <<
+                    "The node cache is too small, no node can be kicked out (all nodes are fixed) !\n"
+                    "Returning nullptr node.";
+                return;
+            }
 
             if (m_reqs[node2kick].valid())
                 m_reqs[node2kick]->wait();
@@ -492,19 +790,24 @@ public:
             if (m_dirty[node2kick])
             {
                 node.save();
+                account_write();
                 ++n_written;
             }
             else
                 ++n_clean_forced;
 
+            drop_prefetched(node2kick);
             m_bid2node.erase(node.my_bid());
 
             m_reqs[node2kick] = node.prefetch(bid);
+
+            account_prefetch(node2kick);
             m_bid2node[bid] = node2kick;
 
             m_fixed[node2kick] = false;
 
             m_dirty[node2kick] = false;
+            set_level(node2kick, level);
 
             assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -519,6 +822,7 @@ public:
 
         node_type& node = *(m_nodes[free_node]);
         m_reqs[free_node] = node.prefetch(bid);
+        account_prefetch(free_node);
         m_bid2node[bid] = free_node;
 
         m_pager.hit(free_node);
@@ -526,6 +830,7 @@ public:
         m_fixed[free_node] = false;
 
         m_dirty[free_node] = false;
+        set_level(free_node, level);
 
         assert(size() == m_bid2node.size() + m_free_nodes.size());
 
@@ -560,6 +865,13 @@ public:
         std::swap(n_read, obj.n_read);
         std::swap(n_written, obj.n_written);
         std::swap(n_clean_forced, obj.n_clean_forced);
+        std::swap(m_level, obj.m_level);
+        std::swap(m_level_nodes, obj.m_level_nodes);
+        std::swap(m_pinned_fraction, obj.m_pinned_fraction);
+        std::swap(m_pin_level, obj.m_pin_level);
+        std::swap(m_level_stats, obj.m_level_stats);
+        std::swap(m_io_account, obj.m_io_account);
+        std::swap(m_prefetched, obj.m_prefetched);
     }
 
     void print_statistics(std::ostream& o) const
@@ -577,6 +889,18 @@ public:
         o << "Read blocks                       : " << n_read << std::endl;
         o << "Written blocks                    : " << n_written << std::endl;
         o << "Clean blocks forced from the cache: " << n_clean_forced << std::endl;
+        o << "Pinned blocks                     : " << npinned()
+          << " (levels >= " << m_pin_level << ")" << std::endl;
+
+        for (size_t l = m_level_stats.size(); l-- > 1; )
+        {
+            const level_stats& ls = m_level_stats[l];
+            const uint64_t n = ls.n_found + ls.n_not_found;
+            if (n == 0)
+                continue;
+            o << "Level " << l << " found blocks             : " << ls.n_found
+              << " (" << 100. * double(ls.n_found) / double(n) << "%)" << std::endl;
+        }
     }
     void reset_statistics()
     {
@@ -587,6 +911,7 @@ public:
         n_read = 0;
         n_written = 0;
         n_clean_forced = 0;
+        m_level_stats.clear();
     }
 };
 
@@ -0,0 +1,350 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/hash_map/async_finder.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_HASH_MAP_ASYNC_FINDER_HEADER
+#define STXXL_CONTAINERS_HASH_MAP_ASYNC_FINDER_HEADER
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger.hpp>
+#include <tlx/simple_vector.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/io/request.hpp>
+
+#include <stxxl/bits/common/io_account.h>
+
+namespace stxxl {
+namespace hash_map {
+
+/*!
+ * Asynchronous lookups in a hash_map, allowing a single thread to keep many
+ * subblock reads in flight.
+ *
+ * async_find() delivers a pointer to the found value, or nullptr if the key
+ * is not contained, to a callback. Lookups answered by the internal-memory
+ * buffer or the map's block cache call the callback immediately. Otherwise
+ * the bucket's subblocks are read one after another into the finder's own
+ * buffers, and the callback is called by poll() or wait_all() once the key
+ * was found or ruled out. If all buffers are in flight, async_find() first
+ * completes the oldest read. The value pointed to is a copy, which is only
+ * valid during the callback. Callbacks may issue further lookups.
+ *
+ * Callbacks are only called from the thread calling the finder's methods.
+ * The hash_map must not be modified while the finder is in use.
+ */
+template <class HashMap,
+          class Callback = std::function<void(const typename HashMap::value_type*)> >
+class async_finder
+{
+    static constexpr bool debug = false;
+
+public:
+    using hash_map_type = HashMap;
+    using key_type = typename hash_map_type::key_type;
+    using value_type = typename hash_map_type::value_type;
+    using callback_type = Callback;
+
+    using internal_size_type = typename hash_map_type::internal_size_type;
+    using external_size_type = typename hash_map_type::external_size_type;
+
+    using node_type = typename hash_map_type::node_type;
+    using bucket_type = typename hash_map_type::bucket_type;
+    using subblock_type = typename hash_map_type::subblock_type;
+    using subblock_bid_type = typename hash_map_type::subblock_bid_type;
+    using bid_type = typename hash_map_type::bid_type;
+
+    enum {
+        subblock_size = hash_map_type::subblock_size,
+        subblocks_per_block = hash_map_type::subblocks_per_block
+    };
+
+protected:
+    //! outcome of searching one subblock
+    enum search_result { search_next, search_found, search_missing };
+
+    //! state of a lookup searching a bucket's external values
+    struct lookup
+    {
+        key_type key;
+        //! the bucket's external values
+        external_size_type n_external;
+        internal_size_type i_block, i_subblock;
+        //! index of the subblock searched next
+        internal_size_type i_next;
+        callback_type callback;
+    };
+
+    //! the hash_map searched
+    const hash_map_type& m_map;
+
+    //! buffers for subblocks in flight
+    tlx::simple_vector<subblock_type> m_buffers;
+
+    //! the read requests by buffer index
+    tlx::simple_vector<foxxll::request_ptr> m_requests;
+
+    //! the lookups waiting by buffer index
+    tlx::simple_vector<lookup> m_lookups;
+
+    //! buffer indexes in flight, oldest first
+    std::deque<internal_size_type> m_in_flight;
+
+    //! free buffer indexes
+    std::vector<internal_size_type> m_free;
+
+public:
+    //! Create a finder keeping up to max_in_flight subblock reads in flight.
+    explicit async_finder(const hash_map_type& map,
+                          internal_size_type max_in_flight = 64)
+        : m_map(map),
+          m_buffers(max_in_flight),
+          m_requests(max_in_flight),
+          m_lookups(max_in_flight)
+    {
+        if (max_in_flight == 0)
+            throw foxxll::bad_parameter(
+                      "stxxl::hash_map::async_finder: max_in_flight must be positive");
+
+        for (internal_size_type i = max_in_flight; i-- > 0; )
+            m_free.push_back(i);
+    }
+
+    //! non-copyable: delete copy-constructor
+    async_finder(const async_finder&) = delete;
+    //! non-copyable: delete assignment operator
+    async_finder& operator = (const async_finder&) = delete;
+
+    //! Completes all lookups in flight.
+    ~async_finder()
+    {
+        wait_all();
+    }
+
+    //! Looks up key, cb(value) is called with a pointer to the value or
+    //! nullptr once the lookup has completed.
+    void async_find(const key_type& key, callback_type cb)
+    {
+        const bucket_type& bucket = m_map.buckets_[m_map._bkt_num(key)];
+        node_type* node = m_map._find_key_internal(bucket, key);
+
+        // found in internal-memory buffer
+        if (node && m_map._eq(node->value_.first, key))
+        {
+            m_map.n_found_internal++;
+            cb(node->deleted() ? nullptr : &node->value_);
+            return;
+        }
+
+        if (bucket.n_external_ == 0)
+        {
+            m_map.n_not_found++;
+            cb(nullptr);
+            return;
+        }
+
+        advance(lookup {
+                    key, bucket.n_external_, bucket.i_block_, bucket.i_subblock_,
+                    0, std::move(cb)
+                });
+    }
+
+    //! Continues all lookups whose reads have completed without waiting.
+    //! \return number of reads completed
+    internal_size_type poll()
+    {
+        internal_size_type done = 0;
+        for (internal_size_type k = 0; k < m_in_flight.size(); )
+        {
+            const internal_size_type i = m_in_flight[k];
+            if (m_requests[i]->poll())
+                complete(i), ++done;
+            else
+                ++k;
+        }
+        return done;
+    }
+
+    //! Waits until all lookups have completed.
+    //! \return number of reads completed
+    internal_size_type wait_all()
+    {
+        internal_size_type done = 0;
+        while (!m_in_flight.empty())
+            complete(m_in_flight.front()), ++done;
+        return done;
+    }
+
+    //! Number of subblock reads in flight.
+    internal_size_type in_flight() const
+    {
+        return m_in_flight.size();
+    }
+
+protected:
+    //! number of subblocks holding the lookup's bucket
+    static internal_size_type num_subblocks(const lookup& l)
+    {
+        return static_cast<internal_size_type>(
+            (l.n_external + subblock_size - 1) / subblock_size);
+    }
+
+    //! Searches subblocks of the lookup's bucket that are cached and issues a
+    //! read for the first one that is not.
+    void advance(lookup&& l)
+    {
+        const internal_size_type n_subblocks = num_subblocks(l);
+        for ( ; l.i_next < n_subblocks; ++l.i_next)
+        {
+            const external_size_type i_abs_subblock = l.i_subblock + l.i_next;
+            const bid_type& bid = m_map.bids_[
+                l.i_block + static_cast<internal_size_type>(i_abs_subblock / subblocks_per_block)];
+            const internal_size_type i_subblock_within =
+                static_cast<internal_size_type>(i_abs_subblock % subblocks_per_block);
+
+            subblock_type* subblock =
+                m_map.block_cache_.peek_subblock(bid, i_subblock_within);
+            if (subblock)
+            {
+                m_map.n_subblocks_loaded++;
+                internal_size_type pos;
+                const search_result r = search(l, *subblock, pos);
+                if (r == search_next)
+                    continue;
+
+                // copy the value, the callback may use the block cache
+                if (r == search_found)
+                    finish(l, value_type((*subblock)[pos]));
+                else
+                    finish_missing(l);
+                return;
+            }
+
+            while (m_free.empty())
+                complete(m_in_flight.front());
+
+            const internal_size_type i = m_free.back();
+            m_free.pop_back();
+
+            LOG << "async_finder: reading subblock " << l.i_next
+                << " of bucket at block " << l.i_block << " into buffer " << i;
+
+            // the block may have been evicted from the cache and still be
+            // written back
+            m_map.block_cache_.wait_write_back(bid);
+
+            subblock_bid_type subblock_bid(
+                bid.storage, bid.offset + i_subblock_within * subblock_type::raw_size);
+            m_requests[i] = m_buffers[i].read(subblock_bid);
+            m_lookups[i] = std::move(l);
+            m_in_flight.push_back(i);
+
+            if (m_map.io_account_)
+                m_map.io_account_->add_read(1, subblock_type::raw_size);
+            return;
+        }
+
+        finish_missing(l);
+    }
+
+    //! Searches the lookup's current subblock, sets pos to the value's index
+    //! if it was found.
+    search_result search(const lookup& l, const subblock_type& subblock,
+                         internal_size_type& pos)
+    {
+        const internal_size_type n_subblocks = num_subblocks(l);
+        // number of values in current subblock
+        const internal_size_type n_values =
+            (l.i_next + 1 < n_subblocks)
+            ? static_cast<internal_size_type>(subblock_size)
+            : static_cast<internal_size_type>(
+                l.n_external - l.i_next * subblock_size);
+
+        // biggest key in current subblock still too small => next subblock
+        if (m_map._lt(subblock[n_values - 1].first, l.key))
+            return search_next;
+
+        // binary search in current subblock
+        internal_size_type i_lower = 0, i_upper = n_values;
+        while (i_lower + 1 != i_upper)
+        {
+            internal_size_type i_middle = (i_lower + i_upper) / 2;
+            if (m_map._leq(subblock[i_middle].first, l.key))
+                i_lower = i_middle;
+            else
+                i_upper = i_middle;
+        }
+
+        if (!m_map._eq(subblock[i_lower].first, l.key))
+            return search_missing;
+
+        pos = i_lower;
+        return search_found;
+    }
+
+    //! calls the callback of a lookup that found value
+    void finish(lookup& l, const value_type& value)
+    {
+        m_map.n_found_external++;
+        l.callback(&value);
+    }
+
+    //! calls the callback of a lookup whose key is not contained
+    void finish_missing(lookup& l)
+    {
+        m_map.n_not_found++;
+        l.callback(nullptr);
+    }
+
+    //! waits for the read into buffer i and continues its lookup
+    void complete(internal_size_type i)
+    {
+        {
+            io_account::wait_timer wait(m_map.io_account_);
+            m_requests[i]->wait();
+        }
+        m_requests[i] = foxxll::request_ptr();
+        m_in_flight.erase(std::find(m_in_flight.begin(), m_in_flight.end(), i));
+        m_map.n_subblocks_loaded++;
+
+        // the buffer is freed before the callback is called, as callbacks may
+        // issue further lookups which need a buffer
+        lookup l = std::move(m_lookups[i]);
+        internal_size_type pos;
+        const search_result r = search(l, m_buffers[i], pos);
+
+        if (r == search_found)
+        {
+            const value_type value = m_buffers[i][pos];
+            m_free.push_back(i);
+            finish(l, value);
+        }
+        else
+        {
+            m_free.push_back(i);
+            if (r == search_missing)
+                finish_missing(l);
+            else
+            {
+                ++l.i_next;
+                advance(std::move(l));
+            }
+        }
+    }
+};
+
+} // namespace hash_map
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_HASH_MAP_ASYNC_FINDER_HEADER
@@ -23,6 +23,7 @@
 
 #include <foxxll/mng/block_manager.hpp>
 
+#include <stxxl/bits/common/io_account.h>
 #include <stxxl/bits/containers/pager.h>
 
 namespace stxxl {
@@ -39,8 +40,11 @@ public:
 protected:
     std::vector<block_type*> blocks_;
     std::vector<foxxll::request_ptr> reqs_;
+    std::vector<bid_type> bids_;
     std::vector<size_t> free_blocks_;
     std::list<size_t> busy_blocks_; // TODO make that a circular-buffer
+    //! account counting the writes, or nullptr
+    io_account* io_account_ = nullptr;
 
 public:
     explicit block_cache_write_buffer(const size_t size)
@@ -48,6 +52,7 @@ public:
         blocks_.reserve(size);
         free_blocks_.reserve(size);
         reqs_.resize(size);
+        bids_.resize(size);
 
         for (size_t i = 0; i < size; i++) {
             blocks_.push_back(new block_type());
@@ -68,8 +73,10 @@ public:
             const size_t i_buffer = busy_blocks_.front();
             busy_blocks_.pop_front();
 
-            if (reqs_[i_buffer].valid())
+            if (reqs_[i_buffer].valid()) {
+                io_account::wait_timer wait(io_account_);
                 reqs_[i_buffer]->wait();
+            }
 
             free_blocks_.push_back(i_buffer);
         }
@@ -79,14 +86,35 @@ public:
         block_type* buffer = blocks_[i_buffer];
 
         blocks_[i_buffer] = write_block;
+        bids_[i_buffer] = bid;
         reqs_[i_buffer] = blocks_[i_buffer]->write(bid);
         busy_blocks_.push_back(i_buffer);
+        if (io_account_)
+            io_account_->add_write(1, block_type::raw_size);
 
         return buffer;
     }
 
+    //! Waits for a pending write of the given block, such that it can be
+    //! read from disk again.
+    void wait_for(const bid_type& bid)
+    {
+        for (const size_t& i_buffer : busy_blocks_)
+        {
+            if (bids_[i_buffer].storage == bid.storage &&
+                bids_[i_buffer].offset == bid.offset &&
+                reqs_[i_buffer].valid() &&
+                reqs_[i_buffer]->poll() == false)
+            {
+                io_account::wait_timer wait(io_account_);
+                reqs_[i_buffer]->wait();
+            }
+        }
+    }
+
     void flush()
     {
+        io_account::wait_timer wait(io_account_);
         while (!busy_blocks_.empty()) {
             const size_t i_buffer = busy_blocks_.front();
             busy_blocks_.pop_front();
@@ -103,8 +131,16 @@ public:
     {
         std::swap(blocks_, obj.blocks_);
         std::swap(reqs_, obj.reqs_);
+        std::swap(bids_, obj.bids_);
         std::swap(free_blocks_, obj.free_blocks_);
         std::swap(busy_blocks_, obj.busy_blocks_);
+        std::swap(io_account_, obj.io_account_);
+    }
+
+    //! Sets the account counting the writes, or nullptr.
+    void set_io_account(io_account* account)
+    {
+        io_account_ = account;
     }
 
     ~block_cache_write_buffer()
@@ -186,6 +222,11 @@ protected:
     bid_map_type bid_map_;
     pager_type pager_;
 
+    //! account counting the I/O of the cache, or nullptr
+    io_account* io_account_ = nullptr;
+    //! true iff block was prefetched and not accessed since
+    std::vector<unsigned char> prefetched_;
+
     /* statistics */
     uint64_t n_found { 0 };
     uint64_t n_not_found { 0 };
@@ -206,7 +247,8 @@ public:
           valid_subblock_(cache_size),
           free_blocks_(cache_size),
           reqs_(cache_size),
-          pager_(cache_size)
+          pager_(cache_size),
+          prefetched_(cache_size, false)
     {
         for (size_t i = 0; i < cache_size; i++)
         {
@@ -270,11 +312,9 @@ protected:
             pager_.hit(i_block2kick);
         } while (retain_count_[i_block2kick] > 0);
 
-        if (valid_subblock_[i_block2kick] == valid_all &&
-            reqs_[i_block2kick].valid())
-        {
+        // a complete block may still be read, a single subblock written
+        if (reqs_[i_block2kick].valid())
             reqs_[i_block2kick]->wait();
-        }
 
         if (dirty_[i_block2kick])
         {
@@ -285,10 +325,45 @@ protected:
         else
             ++n_clean_forced;
 
+        drop_prefetched(i_block2kick);
         bid_map_.erase(bids_[i_block2kick]);
         free_blocks_.push_back(i_block2kick);
     }
 
+    //! waits for the block's request, counting the wait time
+    void wait_block(const size_t i_block)
+    {
+        if (reqs_[i_block].valid() && reqs_[i_block]->poll() == false)
+        {
+            io_account::wait_timer wait(io_account_);
+            reqs_[i_block]->wait();
+        }
+    }
+
+    //! counts a read of the given size
+    void account_read(const size_t bytes)
+    {
+        if (io_account_)
+            io_account_->add_read(1, bytes);
+    }
+
+    //! a block is accessed, it is no longer an unused prefetch
+    void mark_used(const size_t i_block)
+    {
+        prefetched_[i_block] = false;
+    }
+
+    //! a block is dropped from the cache, unused prefetches were wasted
+    void drop_prefetched(const size_t i_block)
+    {
+        if (prefetched_[i_block])
+        {
+            prefetched_[i_block] = false;
+            if (io_account_)
+                io_account_->add_wasted(1);
+        }
+    }
+
 public:
     //! Retain a block in cache. Blocks, that are retained by at least one
     //! client, won't get kicked. Make sure to release all retained blocks
@@ -342,14 +417,14 @@ public:
         // only complete blocks can be marked as dirty
         if (valid_subblock_[i_block] != valid_all)
         {
+            wait_block(i_block);
             reqs_[i_block] = blocks_[i_block]->read(bid);
             valid_subblock_[i_block] = valid_all;
+            account_read(block_type::raw_size);
         }
 
-        if (reqs_[i_block].valid()) {
-            if (reqs_[i_block]->poll() == false)
-                reqs_[i_block]->wait();
-        }
+        wait_block(i_block);
+        mark_used(i_block);
 
         dirty_[i_block] = true;
         return true;
@@ -380,13 +455,10 @@ public:
             {
                 ++n_found;
 
-                if (valid_subblock_[i_block] == valid_all &&
-                    reqs_[i_block].valid())
-                {
-                    // request not yet completed?
-                    if (reqs_[i_block]->poll() == false)
-                        reqs_[i_block]->wait();
-                }
+                // request not yet completed?
+                if (valid_subblock_[i_block] == valid_all)
+                    wait_block(i_block);
+                mark_used(i_block);
 
                 return &((*block)[i_subblock]);
             }
@@ -419,17 +491,114 @@ public:
         }
 
         // now actually load the wanted subblock and store it within *block
+        write_buffer_.wait_for(bid);
         subblock_bid_type subblock_bid(
             bid.storage, bid.offset + i_subblock * subblock_type::raw_size);
         foxxll::request_ptr req = ((*block)[i_subblock]).read(subblock_bid);
-        req->wait();
+        account_read(subblock_type::raw_size);
+        {
+            io_account::wait_timer wait(io_account_);
+            req->wait();
+        }
 
         valid_subblock_[i_block] = i_subblock;
+        mark_used(i_block);
         pager_.hit(i_block);
 
         return &((*block)[i_subblock]);
     }
 
+    //! Retrieve a subblock only if it is cached, without issuing any I/O.
+    //!
+    //! \param bid block, to which the requested subblock belongs
+    //! \param i_subblock index of requested subblock
+    //! \return pointer to subblock, or nullptr if it is not cached
+    subblock_type * peek_subblock(const bid_type& bid, const size_t i_subblock)
+    {
+        typename bid_map_type::const_iterator it = bid_map_.find(bid);
+        if (it == bid_map_.end())
+            return nullptr;
+
+        const size_t i_block = (*it).second;
+        if (valid_subblock_[i_block] != valid_all &&
+            valid_subblock_[i_block] != i_subblock)
+            return nullptr;
+
+        n_read++;
+        ++n_found;
+
+        if (valid_subblock_[i_block] == valid_all)
+            wait_block(i_block);
+        mark_used(i_block);
+
+        return &((*blocks_[i_block])[i_subblock]);
+    }
+
+    //! Wait until a block evicted from the cache has been written back, such
+    //! that it can be read from disk bypassing the cache.
+    void wait_write_back(const bid_type& bid)
+    {
+        write_buffer_.wait_for(bid);
+    }
+
+    //! Write a subblock to disk asynchronously. The subblock is copied into
+    //! the cached block, or into a newly cached block holding only this
+    //! subblock, from which it is written.
+    //!
+    //! \param bid block, to which the subblock belongs
+    //! \param i_subblock index of the subblock
+    //! \param subblock contents to write
+    void write_subblock(const bid_type& bid, const size_t i_subblock,
+                        const subblock_type& subblock)
+    {
+        size_t i_block;
+
+        typename bid_map_type::const_iterator it = bid_map_.find(bid);
+        if (it != bid_map_.end())
+        {
+            i_block = (*it).second;
+
+            // complete block cached: it is written back with the subblock
+            if (valid_subblock_[i_block] == valid_all)
+            {
+                wait_block(i_block);
+                mark_used(i_block);
+                (*blocks_[i_block])[i_subblock] = subblock;
+                dirty_[i_block] = true;
+                return;
+            }
+
+            // a single subblock is cached, whose write may be in flight
+            wait_block(i_block);
+        }
+        else
+        {
+            if (free_blocks_.empty())
+                kick_block();
+
+            i_block = free_blocks_.back(), free_blocks_.pop_back();
+
+            bid_map_[bid] = i_block;
+            bids_[i_block] = bid;
+            dirty_[i_block] = false;
+            retain_count_[i_block] = 0;
+        }
+
+        subblock_type& cached = (*blocks_[i_block])[i_subblock];
+        cached = subblock;
+        valid_subblock_[i_block] = i_subblock;
+
+        subblock_bid_type subblock_bid(
+            bid.storage, bid.offset + i_subblock * subblock_type::raw_size);
+        reqs_[i_block] = cached.write(subblock_bid);
+        if (io_account_)
+            io_account_->add_write(1, subblock_type::raw_size);
+
+        mark_used(i_block);
+        pager_.hit(i_block);
+        n_written++;
+    }
+
     //! Load a block in advance.
     //! \param bid Identifier of the block to load
     void prefetch_block(const bid_type& bid)
@@ -464,10 +633,17 @@ public:
             dirty_[i_block] = false;
         }
 
-        // now actually load the block
+        // now actually load the block, after a write of its cached subblock
+        wait_block(i_block);
+        write_buffer_.wait_for(bid);
         reqs_[i_block] = blocks_[i_block]->read(bid);
         valid_subblock_[i_block] = valid_all;
         pager_.hit(i_block);
+
+        prefetched_[i_block] = true;
+        account_read(block_type::raw_size);
+        if (io_account_)
+            io_account_->add_prefetch(1);
     }
 
     //! Write all dirty blocks back to disk
@@ -483,6 +659,9 @@ public:
 
                 dirty_[i_block] = false;
             }
+            // subblocks written by write_subblock()
+            else if (valid_subblock_[i_block] != valid_all)
+                wait_block(i_block);
         }
         write_buffer_.flush();
     }
@@ -494,15 +673,26 @@ public:
         for (size_t i = 0; i < size(); i++)
         {
             if (reqs_[i].valid()) {
-                reqs_[i]->cancel();
+                // complete blocks are only read, single subblocks are
+                // written by write_subblock() and must not be cancelled
+                if (valid_subblock_[i] == valid_all)
+                    reqs_[i]->cancel();
                 reqs_[i]->wait();
             }
 
+            drop_prefetched(i);
             free_blocks_.push_back(i);
         }
         bid_map_.clear();
     }
 
+    //! Set the account counting the I/O of the cache, or nullptr.
+    void set_io_account(io_account* account)
+    {
+        io_account_ = account;
+        write_buffer_.set_io_account(account);
+    }
+
     //! Print statistics: Number of hits/misses, blocks forced from cache or
     //! written back.
     void print_statistics(std::ostream& o = std::cout) const
@@ -544,6 +734,9 @@ public:
         std::swap(bid_map_, obj.bid_map_);
         std::swap(pager_, obj.pager_);
 
+        std::swap(io_account_, obj.io_account_);
+        std::swap(prefetched_, obj.prefetched_);
+
         std::swap(n_found, obj.n_found);
         std::swap(n_not_found, obj.n_found);
         std::swap(n_read, obj.n_read);
@@ -19,15 +19,23 @@
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include <tlx/math/integer_log2.hpp>
+
 #include <foxxll/mng/block_manager.hpp>
 
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/file_block_store.h>
+#include <stxxl/bits/parallel.h>
 #include <stxxl/bits/stream/sort_stream.h>
 #include <stxxl/bits/stream/stream.h>
 
+#include <stxxl/bits/containers/hash_map/async_finder.h>
 #include <stxxl/bits/containers/hash_map/block_cache.h>
 #include <stxxl/bits/containers/hash_map/iterator.h>
 #include <stxxl/bits/containers/hash_map/iterator_map.h>
@@ -41,6 +49,13 @@ namespace hash_map {
 /*!
  * Main implementation of external memory hash map.
  *
+ * Buckets are addressed by linear hashing over the high bits of the hash
+ * values: when the load factor exceeds opt_load_factor(), the next bucket in
+ * turn is split into two and only its subblocks are rewritten, at the end of
+ * the allocated blocks. The whole table is rewritten when the internal-memory
+ * buffer overflows, on rehash(), and once the subblocks left unused by split
+ * buckets outnumber the used ones.
+ *
  * \tparam KeyType the key type
  * \tparam MappedType the mapped type associated with a key
  * \tparam HashType a hash functional
@@ -141,6 +156,13 @@ public:
 
     using node_allocator_type = typename allocator_type::template rebind<node_type>::other;
 
+    /*!
+     * Filter applied to every value the hash-map rewrites in external memory.
+     * It is called with the key and the mapped value, which it may modify,
+     * and returns false to drop the value from the hash-map.
+     */
+    using compaction_filter_type = std::function<bool (const key_type&, mapped_type&)>;
+
 protected:
     //! user supplied mother hash-function
     hasher hash_;
@@ -150,6 +172,16 @@ protected:
     buckets_container_type buckets_;
     //! blocks-ids of allocated blocks
     bid_container_type bids_;
+    //! allocator and superblock of the file the hash-map is bound to, or
+    //! nullptr if the blocks are temporary
+    std::unique_ptr<file_block_store> store_;
+    //! index of the block, at which rewritten buckets are appended
+    internal_size_type tail_block_;
+    //! index of the subblock within tail_block_, at which rewritten buckets
+    //! are appended
+    internal_size_type tail_subblock_;
+    //! number of subblocks left unused by rewritten buckets
+    internal_size_type n_garbage_;
     //! size of internal-memory buffer in number of entries
     internal_size_type buffer_size_;
     //! maximum size for internal-memory buffer
@@ -158,6 +190,8 @@ protected:
     iterator_map_type iterator_map_;
 
     mutable block_cache_type block_cache_;
+    //! account counting the block cache's I/O, or nullptr
+    io_account* io_account_ = nullptr;
     //! used to allocate new nodes for internal buffer
     node_allocator_type node_allocator_;
     //! false if the total-number of values is correct (false) or true if
@@ -167,6 +201,8 @@ protected:
     mutable external_size_type num_total_;
     //! desired load factor after rehashing
     float opt_load_factor_;
+    //! applied to values rewritten by rebuilds and splits, may be empty
+    compaction_filter_type compaction_filter_;
 
 public:
     /*!
@@ -186,6 +222,9 @@ public:
           cmp_(cmp),
           buckets_(n),
           bids_(0),
+          tail_block_(0),
+          tail_subblock_(0),
+          n_garbage_(0),
           buffer_size_(0),
           iterator_map_(this),
           block_cache_(tuning::get_instance()->blockcache_size),
@@ -222,6 +261,9 @@ public:
           cmp_(cmp),
           buckets_(n),                 // insert will determine a good size
           bids_(0),
+          tail_block_(0),
+          tail_subblock_(0),
+          n_garbage_(0),
           buffer_size_(0),
           iterator_map_(this),
           block_cache_(tuning::get_instance()->blockcache_size),
@@ -234,6 +276,46 @@ public:
         insert(begin, end, mem_to_sort);
     }
 
+    /*!
+     * Construct a hash-map bound to a file, which keeps the external blocks,
+     * the bucket directory and the internal-memory buffer in the file. If
+     * the file contains a hash-map written by sync() or the destructor, the
+     * hash-map is reopened with its contents, otherwise it starts empty. The
+     * hash-function must be the same for all processes opening the file.
+     *
+     * \param file file to store the hash-map in, which must be used by no
+     * other container
+     * \param hf hash-function
+     * \param cmp comparator-object
+     * \param buffer_size size of internal-memory buffer in bytes
+     * \param a allocation-strategory for internal-memory buffer
+     */
+    explicit hash_map(foxxll::file_ptr file,
+                      const hasher& hf = hasher(),
+                      const key_compare& cmp = key_compare(),
+                      internal_size_type buffer_size = 128*1024*1024,
+                      const allocator_type& a = allocator_type())
+        : hash_(hf),
+          cmp_(cmp),
+          buckets_(0),
+          bids_(0),
+          store_(new file_block_store(file, store_tag())),
+          tail_block_(0),
+          tail_subblock_(0),
+          n_garbage_(0),
+          buffer_size_(0),
+          iterator_map_(this),
+          block_cache_(tuning::get_instance()->blockcache_size),
+          node_allocator_(a),
+          oblivious_(false),
+          num_total_(0),
+          opt_load_factor_(0.875)
+    {
+        max_buffer_size_ = buffer_size / sizeof(node_type);
+        if (store_->reopened())
+            _read_metadata();
+    }
+
     //! non-copyable: delete copy-constructor
     hash_map(const hash_map&) = delete;
     //! non-copyable: delete assignment operator
@@ -241,7 +323,23 @@ public:
 
     ~hash_map()
     {
-        clear();
+        if (!store_)
+        {
+            clear();
+            return;
+        }
+
+        // the blocks of a hash-map bound to a file stay allocated
+        try
+        {
+            sync();
+        }
+        catch (...)
+        {
+            LOG1 << "Exception thrown in ~hash_map()";
+        }
+        for (bucket_type& bucket : buckets_)
+            _erase_nodes(bucket.list_, nullptr);
     }
 
 public:
@@ -369,6 +467,8 @@ public:
                 ++buffer_size_;
                 if (buffer_size_ >= max_buffer_size_)
                     _rebuild_buckets();                 // will fix it as well
+                else
+                    _grow();
 
                 return std::pair<iterator, bool>(it, true);
             }
@@ -418,6 +518,8 @@ public:
             ++buffer_size_;
             if (buffer_size_ >= max_buffer_size_)
                 _rebuild_buckets();
+            else
+                _grow();
 
             return it;
         }
@@ -566,9 +668,9 @@ public:
         buffer_size_ = 0;
 
         // free external memory
-        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-        bm->delete_blocks(bids_.begin(), bids_.end());
+        _delete_blocks(bids_);
         bids_.clear();
+        tail_block_ = tail_subblock_ = n_garbage_ = 0;
     }
 
     //! Exchange stored values with another hash-map
@@ -577,6 +679,9 @@ public:
     {
         std::swap(buckets_, obj.buckets_);
         std::swap(bids_, obj.bids_);
+        std::swap(tail_block_, obj.tail_block_);
+        std::swap(tail_subblock_, obj.tail_subblock_);
+        std::swap(n_garbage_, obj.n_garbage_);
 
         std::swap(oblivious_, obj.oblivious_);
         std::swap(num_total_, obj.num_total_);
@@ -590,10 +695,64 @@ public:
         std::swap(max_buffer_size_, obj.max_buffer_size_);
 
         std::swap(opt_load_factor_, obj.opt_load_factor_);
+        std::swap(compaction_filter_, obj.compaction_filter_);
 
         std::swap(iterator_map_, obj.iterator_map_);
 
         std::swap(block_cache_, obj.block_cache_);
+        std::swap(io_account_, obj.io_account_);
+
+        std::swap(store_, obj.store_);
+    }
+
+    /*!
+     * Writes the cached blocks, the bucket directory and the internal-memory
+     * buffer to the file the hash-map is bound to, after which the file can
+     * be reopened. Does nothing for temporary hash-maps.
+     */
+    void sync()
+    {
+        if (!store_)
+            return;
+
+        block_cache_.flush();
+
+        binary_buffer meta;
+        meta.put<uint64_t>(num_total_);
+        meta.put<uint8_t>(oblivious_);
+
+        meta.put_varint(static_cast<uint64_t>(bids_.size()));
+        for (const bid_type& bid : bids_)
+            meta.put<uint64_t>(bid.offset);
+        meta.put_varint(static_cast<uint64_t>(tail_block_));
+        meta.put_varint(static_cast<uint64_t>(tail_subblock_));
+        meta.put_varint(static_cast<uint64_t>(n_garbage_));
+
+        meta.put_varint(static_cast<uint64_t>(buckets_.size()));
+        for (const bucket_type& bucket : buckets_)
+        {
+            meta.put_varint(static_cast<uint64_t>(bucket.n_external_));
+            meta.put_varint(static_cast<uint64_t>(bucket.i_block_));
+            meta.put_varint(static_cast<uint64_t>(bucket.i_subblock_));
+
+            internal_size_type n_nodes = 0;
+            for (node_type* node = bucket.list_; node; node = node->next())
+                ++n_nodes;
+            meta.put_varint(static_cast<uint64_t>(n_nodes));
+            for (node_type* node = bucket.list_; node; node = node->next())
+            {
+                meta.put<value_type>(node->value_);
+                meta.put<uint8_t>(node->deleted());
+            }
+        }
+
+        store_->commit(meta);
+    }
+
+    //! Returns true if the hash-map is bound to a file.
+    bool persistent() const
+    {
+        return store_ != nullptr;
     }
 
 protected:
@@ -611,6 +770,20 @@ public:
         n_subblocks_loaded = n_found_external = n_found_internal = n_not_found = 0;
     }
 
+    //! Attach an account counting the block cache's I/O, or nullptr to
+    //! detach it. The I/O of bulk operations is not counted.
+    void set_io_account(io_account* account)
+    {
+        io_account_ = account;
+        block_cache_.set_io_account(account);
+    }
+
+    //! The attached I/O account, or nullptr.
+    io_account * get_io_account() const
+    {
+        return io_account_;
+    }
+
     //! Print short general statistics to output stream
     void print_statistics(std::ostream& o = std::cout) const
     {
@@ -824,6 +997,21 @@ public:
         _rebuild_buckets(n);
     }
 
+    //! Get the filter applied to rewritten values
+    const compaction_filter_type& compaction_filter() const
+    { return compaction_filter_; }
+
+    /*!
+     * Set a filter which is applied to every value rewritten when the
+     * internal-memory buffer is merged into external memory, on rehash(),
+     * bulk insertion and bucket splits. It may update the mapped value or
+     * drop the value, e.g. to expire entries during I/O which is done anyway.
+     * Values are not filtered at other times, and which values are rewritten
+     * when is unspecified apart from rehash(), which rewrites all of them.
+     */
+    void compaction_filter(const compaction_filter_type& filter)
+    { compaction_filter_ = filter; }
+
     //! Number of bytes occupied by buffer
     internal_size_type buffer_size() const
     {
@@ -886,7 +1074,208 @@ public:
     //! Returns a const_iterator pointing to the end of the hash-map
     const_iterator end() const { return _end<const_iterator>(); }
 
+    /*!
+     * Calls fn(const value_type&) for each value of the hash-map, using
+     * several threads if parallel mode is enabled.
+     *
+     * The buckets are partitioned into ranges of consecutive hash values,
+     * which are processed independently: each range is scanned by its own
+     * prefetching reader and block cache, and merged with the
+     * internal-memory buffer bucket by bucket. The values are hence visited
+     * in no particular order and fn must be safe to call concurrently. The
+     * hash-map must not be modified until the call returns.
+     *
+     * \param fn functor called for each value
+     * \param num_threads number of threads, 0 for the OpenMP default
+     */
+    template <typename Functor>
+    void parallel_for_each(Functor fn, size_t num_threads = 0) const
+    {
+        const internal_size_type n = buckets_.size();
+
+        // the ranges are read bypassing the shared block cache
+        block_cache_.flush();
+
+#if STXXL_PARALLEL
+        if (num_threads == 0)
+            num_threads = static_cast<size_t>(omp_get_max_threads());
+#else
+        num_threads = 1;
+#endif
+        // several ranges per thread to balance buckets of different sizes
+        const size_t n_ranges = (num_threads == 1) ? 1 : 4 * num_threads;
+
+        // range k starts with the bucket of the k-th fraction of the hash
+        // values, coinciding starts yield empty ranges
+        std::vector<internal_size_type> range_begin(n_ranges + 1);
+        for (size_t k = 0; k < n_ranges; ++k)
+        {
+            const uint64_t hash =
+                static_cast<uint64_t>(k) * (std::numeric_limits<uint64_t>::max() / n_ranges);
+            range_begin[k] = _bkt_addr(reverse_bits(hash), n);
+        }
+        range_begin[n_ranges] = n;
+
+        LOG << "parallel_for_each() threads=" << num_threads
+            << " ranges=" << n_ranges << " buckets=" << n;
+
+#if STXXL_PARALLEL
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#endif
+        for (long k = 0; k < static_cast<long>(n_ranges); ++k)
+            _for_each_in_range(range_begin[k], range_begin[k + 1], fn);
+    }
+
 protected:
+    /*!
+     * Calls fn for each value in the buckets from i_begin up to but excluding
+     * i_end, in the order of the hash values. Uses a private block cache,
+     * which is just large enough for the reader's prefetching.
+     */
+    template <typename Functor>
+    void _for_each_in_range(internal_size_type i_begin, internal_size_type i_end,
+                            Functor& fn) const
+    {
+        using const_reader_type = buffered_reader<
+            block_cache_type, typename bid_container_type::const_iterator>;
+
+        // the reader starts at the first bucket with external values, the
+        // i_block_ of buckets without any may lie past the last block
+        internal_size_type i_first = i_begin;
+        while (i_first != i_end && buckets_[i_first].n_external_ == 0)
+            i_first = _bkt_next(i_first, buckets_.size());
+
+        if (i_first == i_end)
+        {
+            for (internal_size_type i_bucket = i_begin; i_bucket != i_end;
+                 i_bucket = _bkt_next(i_bucket, buckets_.size()))
+            {
+                for (node_type* node = buckets_[i_bucket].list_; node; node = node->next())
+                {
+                    if (!node->deleted())
+                        fn(static_cast<const value_type&>(node->value_));
+                }
+            }
+            return;
+        }
+
+        block_cache_type cache(
+            tuning::get_instance()->prefetch_page_size
+            * tuning::get_instance()->prefetch_pages + 2);
+
+        const_reader_type reader(
+            bids_.begin() + buckets_[i_first].i_block_, bids_.end(), cache,
+            buckets_[i_first].i_subblock_);
+
+        for (internal_size_type i_bucket = i_begin; i_bucket != i_end;
+             i_bucket = _bkt_next(i_bucket, buckets_.size()))
+        {
+            const bucket_type& bucket = buckets_[i_bucket];
+            node_type* node = bucket.list_;
+            external_size_type i_external = 0;
+
+            if (bucket.n_external_ != 0)
+                reader.skip_to(bids_.begin() + bucket.i_block_, bucket.i_subblock_,
+                               bucket.n_external_);
+
+            // merge the buffered values into the external ones, a buffered
+            // value overrides an external one with the same key
+            while (node && i_external < bucket.n_external_)
+            {
+                if (_leq(node->value_.first, reader.const_value().first))
+                {
+                    if (_eq(node->value_.first, reader.const_value().first))
+                    {
+                        ++reader;
+                        ++i_external;
+                    }
+                    if (!node->deleted())
+                        fn(static_cast<const value_type&>(node->value_));
+                    node = node->next();
+                }
+                else
+                {
+                    fn(reader.const_value());
+                    ++reader;
+                    ++i_external;
+                }
+            }
+            for ( ; node; node = node->next())
+            {
+                if (!node->deleted())
+                    fn(static_cast<const value_type&>(node->value_));
+            }
+            for ( ; i_external < bucket.n_external_; ++i_external)
+            {
+                fn(reader.const_value());
+                ++reader;
+            }
+        }
+    }
+
+    //! identifies the layout of the hash-map in the superblock of its file
+    static std::string store_tag()
+    {
+        std::ostringstream tag;
+        tag << "stxxl::hash_map key=" << sizeof(key_type)
+            << " mapped=" << sizeof(mapped_type)
+            << " subblock=" << SubBlockSize
+            << " subblocks_per_block=" << SubBlocksPerBlock;
+        return tag.str();
+    }
+
+    //! Restore buckets, blocks and buffer from the file's metadata
+    void _read_metadata()
+    {
+        binary_reader meta = store_->metadata();
+        num_total_ = meta.get<uint64_t>();
+        oblivious_ = meta.get<uint8_t>() != 0;
+
+        bids_.resize(static_cast<size_t>(meta.get_varint64()));
+        for (bid_type& bid : bids_)
+            bid = store_->bid_at<bid_type>(meta.get<uint64_t>());
+
+        tail_block_ = static_cast<internal_size_type>(meta.get_varint64());
+        tail_subblock_ = static_cast<internal_size_type>(meta.get_varint64());
+        n_garbage_ = static_cast<internal_size_type>(meta.get_varint64());
+
+        buckets_.resize(static_cast<size_t>(meta.get_varint64()));
+        for (bucket_type& bucket : buckets_)
+        {
+            bucket.n_external_ = meta.get_varint64();
+            bucket.i_block_ = static_cast<internal_size_type>(meta.get_varint64());
+            bucket.i_subblock_ = static_cast<internal_size_type>(meta.get_varint64());
+
+            const internal_size_type n_nodes =
+                static_cast<internal_size_type>(meta.get_varint64());
+            node_type* tail = nullptr;
+            for (internal_size_type i = 0; i < n_nodes; ++i)
+            {
+                const value_type value = meta.get<value_type>();
+                const bool del = meta.get<uint8_t>() != 0;
+                node_type* node = _new_node(value, nullptr, del);
+                if (tail)
+                    tail->set_next(node);
+                else
+                    bucket.list_ = node;
+                tail = node;
+            }
+            buffer_size_ += n_nodes;
+        }
+    }
+
+    //! Release external blocks to the block manager or the file
+    void _delete_blocks(bid_container_type& bids)
+    {
+        if (store_)
+        {
+            store_->delete_blocks(bids.begin(), bids.end());
+            return;
+        }
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bm->delete_blocks(bids.begin(), bids.end());
+    }
+
     //! Allocate a new buffer-node
     node_type * _get_node()
     {
@@ -931,20 +1320,61 @@ protected:
 
     /*!
      * Bucket-index for values with given key. The total number of buckets has
-     * to be specified as well.  The bucket number is determined by \f$
-     * bucket_num = (hash/max_hash)*n_buckets \f$ max_hash is in fact 2^63-1
-     * (internal_size_type=uint64_t (or uint32_t)) but we rather divide by 2^64, so
-     * we can use plain integer arithmetic easily (there should be only a small
-     * difference): this way we must only calculate the upper 64 bits of the
-     * product hash*n_buckets and we're done. See
-     * http://www.cs.uaf.edu/~cs301/notes/Chapter5/node5.html
-    */
+     * to be specified as well. Buckets are addressed by linear hashing over
+     * the reversed bits of the hash value: with \f$ 2^L \le n < 2^{L+1} \f$
+     * the reversed top L bits select the bucket, and the reversed top L+1
+     * bits for the \f$ n - 2^L \f$ buckets already split in this round. Hence
+     * each bucket holds a consecutive range of hash values, and bucket i is
+     * split into buckets i and \f$ i + 2^L \f$.
+     */
     internal_size_type _bkt_num(const key_type& key, internal_size_type n) const
     {
-        //! TODO maybe specialize double arithmetic to integer. the old code
-        //! was faulty -tb.
-        return static_cast<internal_size_type>(
-            n * (static_cast<double>(hash_(key)) / std::numeric_limits<internal_size_type>::max()));
+        // place the hash value in the high bits for 32-bit size_t
+        const uint64_t hash = static_cast<uint64_t>(hash_(key))
+                              << (64 - 8 * sizeof(internal_size_type));
+        return _bkt_addr(reverse_bits(hash), n);
+    }
+
+    //! Bucket-index for the reversed hash value rhash out of n buckets
+    static internal_size_type _bkt_addr(uint64_t rhash, internal_size_type n)
+    {
+        if (n <= 1)
+            return 0;
+
+        const unsigned level = tlx::integer_log2_floor(n);
+        const internal_size_type n_split = n - (internal_size_type(1) << level);
+
+        internal_size_type i_bucket = static_cast<internal_size_type>(
+            rhash & ((uint64_t(1) << level) - 1));
+        if (i_bucket < n_split)
+            i_bucket = static_cast<internal_size_type>(
+                rhash & ((uint64_t(2) << level) - 1));
+        return i_bucket;
+    }
+
+    //! Number of high bits of the hash value selecting bucket i_bucket out of
+    //! n buckets
+    static unsigned _bkt_depth(internal_size_type i_bucket, internal_size_type n)
+    {
+        const unsigned level = tlx::integer_log2_floor(n);
+        const internal_size_type n_split = n - (internal_size_type(1) << level);
+        return (i_bucket < n_split || (i_bucket >> level) != 0) ? level + 1 : level;
+    }
+
+    //! Bucket following i_bucket out of n buckets in the order of the hash
+    //! values, or n for the last one. Bucket 0 is the first one.
+    static internal_size_type _bkt_next(internal_size_type i_bucket, internal_size_type n)
+    {
+        const unsigned depth = _bkt_depth(i_bucket, n);
+        if (depth == 0)
+            return n;
+
+        // the high bits of the bucket's hash values, and the bucket of the
+        // following hash values
+        const uint64_t prefix = reverse_bits(i_bucket) >> (64 - depth);
+        if (prefix + 1 == (uint64_t(1) << depth))
+            return n;
+        return _bkt_addr(reverse_bits(prefix + 1) >> (64 - depth), n);
     }
 
     /*!
@@ -1144,16 +1574,18 @@ protected:
         values_stream_type values_stream(old_buckets.begin(), old_buckets.end(),
                                          *reader, old_bids.begin(), *this);
 
-        writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2);
+        writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2,
+                           store_.get());
 
         // re-distribute values among new buckets.
 
         // this makes use of the fact that if value1 preceeds value2 before
         // resizing, value1 will preceed value2 after resizing as well (uniform
-        // rehashing)
+        // rehashing), when visiting the buckets in the order of their hash
+        // values
         num_total_ = 0;
-        for (internal_size_type i_bucket = 0;
-             i_bucket < buckets_.size(); i_bucket++)
+        for (internal_size_type i_bucket = 0; i_bucket < buckets_.size();
+             i_bucket = _bkt_next(i_bucket, buckets_.size()))
         {
             buckets_[i_bucket] = bucket_type();
             buckets_[i_bucket].i_block_ = writer.i_block();
@@ -1164,17 +1596,18 @@ protected:
             while (!hasher.empty())
             {
                 const hashed_value_type& hvalue = *hasher;
-                iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, i_ext);
-
-                writer.append(hvalue.value_);
+                if (_rewrite_value(writer, hvalue.value_, hvalue.i_bucket_, i_bucket, i_ext))
+                    ++i_ext;
                 ++hasher;
-                ++i_ext;
             }
 
             writer.finish_subblock();
-            buckets_[i_bucket].n_external_ = hasher.bucket_size_;
-            num_total_ += hasher.bucket_size_;
+            buckets_[i_bucket].n_external_ = i_ext;
+            num_total_ += i_ext;
         }
+        tail_block_ = writer.i_block();
+        tail_subblock_ = writer.i_subblock();
+        n_garbage_ = 0;
         writer.flush();
         // reader must be deleted before deleting old_bids because its
         // destructor will dereference the bid-iterator
@@ -1182,8 +1615,7 @@ protected:
         block_cache_.clear();
 
         // get rid of old blocks and buckets
-        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-        bm->delete_blocks(old_bids.begin(), old_bids.end());
+        _delete_blocks(old_bids);
 
         for (internal_size_type i_bucket = 0;
              i_bucket < old_buckets.size(); i_bucket++)
@@ -1196,6 +1628,200 @@ protected:
         oblivious_ = false;
     }
 
+    //! Apply the compaction filter to a value, returns false if it is dropped
+    bool _filter_value(value_type& value)
+    {
+        return !compaction_filter_ || compaction_filter_(value.first, value.second);
+    }
+
+    //! Apply the compaction filter to a value rewritten from bucket i_old, and
+    //! append it to the external values of bucket i_bucket at position i_ext
+    //! unless it is dropped. Iterators pointing to the value are updated.
+    template <class Writer>
+    bool _rewrite_value(Writer& writer, value_type value, internal_size_type i_old,
+                        internal_size_type i_bucket, external_size_type i_ext)
+    {
+        if (!_filter_value(value))
+        {
+            iterator_map_.fix_iterators_2end(i_old, value.first);
+            return false;
+        }
+        iterator_map_.fix_iterators_2ext(i_old, value.first, i_bucket, i_ext);
+        writer.append(value);
+        return true;
+    }
+
+    //! Split buckets while the load factor exceeds the desired one
+    void _grow()
+    {
+        if (buckets_.empty())
+            return;
+
+        while (load_factor() > opt_load_factor_ &&
+               buckets_.size() < max_bucket_count())
+            _split_bucket();
+    }
+
+    /*!
+     * Split the next bucket of the linear hashing scheme: bucket i_split is
+     * divided into buckets i_split and n, where n is the current number of
+     * buckets. Its external values and buffered nodes are merged and appended
+     * to the used subblocks, the old subblocks are left unused.
+     */
+    void _split_bucket()
+    {
+        const internal_size_type n = buckets_.size();
+        const internal_size_type i_split =
+            n - (internal_size_type(1) << tlx::integer_log2_floor(n));
+
+        LOG << "_split_bucket() bucket=" << i_split << " into " << n;
+
+        const bucket_type old_bucket = buckets_[i_split];
+        buckets_.push_back(bucket_type());
+        buckets_[i_split] = bucket_type();
+
+        // appending blocks may reallocate the bids referred to by readers
+        iterator_map_.reset_readers();
+
+        _append_bucket(old_bucket, i_split, i_split);
+        _append_bucket(old_bucket, i_split, n);
+
+        // the buffered nodes have been written
+        node_type* node = old_bucket.list_;
+        while (node)
+        {
+            node_type* next = node->next();
+            _put_node(node);
+            --buffer_size_;
+            node = next;
+        }
+
+        n_garbage_ += static_cast<internal_size_type>(
+            (old_bucket.n_external_ + subblock_size - 1) / subblock_size);
+
+        // compact once more subblocks are unused than used
+        const internal_size_type n_subblocks =
+            tail_block_ * subblocks_per_block + tail_subblock_;
+        if (2 * n_garbage_ > n_subblocks)
+            _rebuild_buckets();
+    }
+
+    /*!
+     * Append the values of old_bucket, which previously was bucket i_old,
+     * that belong to bucket i_bucket to new subblocks, and make them the
+     * external values of bucket i_bucket. Iterators pointing to these values
+     * are updated.
+     */
+    void _append_bucket(const bucket_type& old_bucket, internal_size_type i_old,
+                        internal_size_type i_bucket)
+    {
+        if (tail_subblock_ == subblocks_per_block)
+        {
+            ++tail_block_;
+            tail_subblock_ = 0;
+        }
+
+        bucket_type& bucket = buckets_[i_bucket];
+        bucket.i_block_ = tail_block_;
+        bucket.i_subblock_ = tail_subblock_;
+        bucket.n_external_ = 0;
+
+        std::unique_ptr<subblock_type> subblock(new subblock_type);
+        internal_size_type i_value = 0;
+
+        // merge external values and buffered nodes like HashedValuesStream.
+        // The current old subblock is copied, as appending subblocks may
+        // kick its cache slot or reuse it for a subblock of the same block.
+        node_type* node = old_bucket.list_;
+        external_size_type i_external = 0;
+        std::unique_ptr<subblock_type> ext_subblock(new subblock_type);
+        bool ext_loaded = false;
+        internal_size_type i_ext_subblock = 0;
+
+        while (true)
+        {
+            const value_type* ext = nullptr;
+            if (i_external < old_bucket.n_external_)
+            {
+                const internal_size_type i_sub = static_cast<internal_size_type>(
+                    i_external / subblock_size);
+                if (!ext_loaded || i_sub != i_ext_subblock)
+                {
+                    *ext_subblock = *_load_subblock(old_bucket, i_sub);
+                    ext_loaded = true;
+                    i_ext_subblock = i_sub;
+                }
+                ext = &(*ext_subblock)[i_external % subblock_size];
+            }
+
+            value_type value;
+            if (node && (!ext || _leq(node->value_.first, ext->first)))
+            {
+                // buffered node overwrites external value
+                if (ext && _eq(node->value_.first, ext->first))
+                    ++i_external;
+
+                node_type* curr = node;
+                node = node->next();
+                if (curr->deleted())
+                    continue;
+                value = curr->value_;
+            }
+            else if (ext)
+            {
+                value = *ext;
+                ++i_external;
+            }
+            else
+                break;
+
+            if (_bkt_num(value.first) != i_bucket)
+                continue;
+
+            if (!_filter_value(value))
+            {
+                iterator_map_.fix_iterators_2end(i_old, value.first);
+                --num_total_;
+                continue;
+            }
+
+            iterator_map_.fix_iterators_2ext(i_old, value.first, i_bucket, bucket.n_external_);
+
+            (*subblock)[i_value] = value;
+            ++bucket.n_external_;
+            if (++i_value == subblock_size)
+            {
+                _append_subblock(*subblock);
+                i_value = 0;
+            }
+        }
+        if (i_value != 0)
+            _append_subblock(*subblock);
+    }
+
+    //! Write a subblock at the end of the used subblocks, allocating a new
+    //! block if necessary
+    void _append_subblock(subblock_type& subblock)
+    {
+        if (tail_subblock_ == subblocks_per_block)
+        {
+            ++tail_block_;
+            tail_subblock_ = 0;
+        }
+        if (tail_block_ == bids_.size())
+        {
+            bids_.resize(bids_.size() + 1);
+            if (store_)
+                store_->new_blocks(bids_.end() - 1, bids_.end());
+            else
+                foxxll::block_manager::get_instance()->new_blocks(
+                    foxxll::striping(), bids_.end() - 1, bids_.end());
+        }
+
+        block_cache_.write_subblock(bids_[tail_block_], tail_subblock_, subblock);
+        ++tail_subblock_;
+    }
+
     /*!
      * Stream for filtering duplicates. Used to eliminate duplicated values
      * when bulk-inserting Note: input has to be sorted, so that duplicates
@@ -1345,10 +1971,12 @@ public:
         new_sorted_values_stream new_sorted_values(new_values, Cmp(*this), mem);
         new_unique_values_stream new_unique_values(new_sorted_values, *this);
 
-        writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2);
+        writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2,
+                           store_.get());
 
         num_total_ = 0;
-        for (internal_size_type i_bucket = 0; i_bucket < buckets_.size(); i_bucket++)
+        for (internal_size_type i_bucket = 0; i_bucket < buckets_.size();
+             i_bucket = _bkt_next(i_bucket, buckets_.size()))
         {
             buckets_[i_bucket] = bucket_type();
             buckets_[i_bucket].i_block_ = writer.i_block();
@@ -1370,52 +1998,65 @@ public:
                 if ((old_hash < new_hash) || (old_hash == new_hash && cmp_(old_key, new_key)))                // (_lt((*old_hasher)._value.first, (*new_hasher).second.first))
                 {
                     const hashed_value_type& hvalue = *old_hasher;
-                    iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
-                    writer.append(hvalue.value_);
+                    if (_rewrite_value(writer, hvalue.value_, hvalue.i_bucket_, i_bucket, bucket_size))
+                        ++bucket_size;
                     ++old_hasher;
                 }
                 // new value smaller or equal => new value wins
                 else
                 {
+                    value_type value = (*new_hasher).second;
+                    const bool keep = _filter_value(value);
                     if (_eq(old_key, new_key))
                     {
                         const hashed_value_type& hvalue = *old_hasher;
-                        iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
+                        if (keep)
+                            iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
+                        else
+                            iterator_map_.fix_iterators_2end(hvalue.i_bucket_, hvalue.value_.first);
                         ++old_hasher;
                     }
-                    writer.append((*new_hasher).second);
+                    if (keep)
+                    {
+                        writer.append(value);
+                        ++bucket_size;
+                    }
                     ++new_hasher;
                 }
-                ++bucket_size;
             }
             // no more new values for the current bucket
             while (!old_hasher.empty())
             {
                 const hashed_value_type& hvalue = *old_hasher;
-                iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
-                writer.append(hvalue.value_);
+                if (_rewrite_value(writer, hvalue.value_, hvalue.i_bucket_, i_bucket, bucket_size))
+                    ++bucket_size;
                 ++old_hasher;
-                ++bucket_size;
             }
             // no more old values for the current bucket
             while (!new_hasher.empty())
             {
-                writer.append((*new_hasher).second);
+                value_type value = (*new_hasher).second;
+                if (_filter_value(value))
+                {
+                    writer.append(value);
+                    ++bucket_size;
+                }
                 ++new_hasher;
-                ++bucket_size;
             }
 
             writer.finish_subblock();
             buckets_[i_bucket].n_external_ = bucket_size;
             num_total_ += bucket_size;
         }
+        tail_block_ = writer.i_block();
+        tail_subblock_ = writer.i_subblock();
+        n_garbage_ = 0;
         writer.flush();
         delete reader;
         block_cache_.clear();
 
         // release old blocks
-        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-        bm->delete_blocks(old_bids.begin(), old_bids.end());
+        _delete_blocks(old_bids);
 
         // free nodes in old bucket lists
         for (internal_size_type i_bucket = 0;
@@ -1460,6 +2101,8 @@ protected:
     friend class iterator_map<self_type>;
     friend class block_cache<block_type>;
     friend struct HashedValuesStream<self_type, reader_type>;
+    template <class HashMap, class Callback>
+    friend class async_finder;
 
 #if 1
     void _dump_external()
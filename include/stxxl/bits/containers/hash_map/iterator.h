@@ -338,8 +338,9 @@ public:
             }
 
             // at this point there are obviously no more values in the current
-            // bucket let's try the next one (outer while-loop!)
-            i_bucket_++;
+            // bucket let's try the next one (outer while-loop!), buckets are
+            // visited in the order of their hash values
+            i_bucket_ = map_->_bkt_next(i_bucket_, map_->buckets_.size());
             if (i_bucket_ == map_->buckets_.size())
             {
                 end_ = true;
@@ -352,7 +353,8 @@ public:
                 i_external_ = 0;
                 tmp_node = bucket.list_;
                 node_ = nullptr;
-                reader_->skip_to(map_->bids_.begin() + bucket.i_block_, bucket.i_subblock_);
+                reader_->skip_to(map_->bids_.begin() + bucket.i_block_, bucket.i_subblock_,
+                                 bucket.n_external_);
             }
         }
 
@@ -209,6 +209,15 @@ public:
         }
     }
 
+    //! Drop the external-memory readers of all iterators, which refer into
+    //! the hash-map's sequence of bids (called before blocks are appended to
+    //! it). The readers are recreated at the iterators' positions when needed.
+    void reset_readers()
+    {
+        for (mmiterator_type it = it_map_.begin(); it != it_map_.end(); ++it)
+            (*it).second->reset_reader();
+    }
+
     //! Update all iterators and make them point to the end of the hash-map
     //! (used by clear())
     void fix_iterators_all2end()
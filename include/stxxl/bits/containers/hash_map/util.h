@@ -18,6 +18,7 @@
 #include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/buf_writer.hpp>
 
+#include <stxxl/bits/common/file_block_store.h>
 #include <stxxl/bits/containers/hash_map/block_cache.h>
 #include <stxxl/bits/containers/hash_map/tuning.h>
 #include <stxxl/types>
@@ -25,6 +26,18 @@
 namespace stxxl {
 namespace hash_map {
 
+//! Reverses the order of the bits of x; used to address buckets by the high
+//! bits of the hash value.
+inline uint64_t reverse_bits(uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+    x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+    return (x >> 32) | (x << 32);
+}
+
 // For internal memory chaining: struct to compose next-pointer and delete-flag
 // share the same memory: the lowest bit is occupied by the del-flag.
 template <class ValueType>
@@ -121,6 +134,10 @@ private:
     bid_iterator end_bid_;
     //! points to the next block to prefetch
     bid_iterator pref_bid_;
+    //! position of sequential reading, which the prefetched blocks follow
+    bid_iterator seq_bid_;
+    //! true while reading out of sequence, see skip_to()
+    bool detour_;
 
     //! shared block-cache
     cache_type& cache_;
@@ -151,6 +168,8 @@ public:
           begin_bid_(seq_begin),
           curr_bid_(seq_begin),
           end_bid_(seq_end),
+          seq_bid_(seq_begin),
+          detour_(false),
           cache_(cache),
           prefetch_(false),
           page_size_(tuning::get_instance()->prefetch_page_size),
@@ -185,16 +204,9 @@ public:
             return;
 
         prefetch_ = true;
-        pref_bid_ = curr_bid_;
-        // start prefetching page_size*prefetch_pages blocks beginning with current one
-        for (size_t i = 0; i < page_size_ * prefetch_pages_; i++)
-        {
-            if (pref_bid_ == end_bid_)
-                break;
-
-            cache_.prefetch_block(*pref_bid_);
-            ++pref_bid_;
-        }
+        seq_bid_ = curr_bid_;
+        detour_ = false;
+        restart_prefetching();
     }
 
     //! Get const-reference to current value.
@@ -241,16 +253,10 @@ public:
 
             cache_.retain_block(*curr_bid_);
 
-            // if a complete page has been consumed, prefetch the next one
-            if (prefetch_ && (curr_bid_ - begin_bid_) % page_size_ == 0)
+            if (!detour_)
             {
-                for (unsigned i = 0; i < page_size_; i++)
-                {
-                    if (pref_bid_ == end_bid_)
-                        break;
-                    cache_.prefetch_block(*pref_bid_);
-                    ++pref_bid_;
-                }
+                seq_bid_ = curr_bid_;
+                prefetch_page();
             }
         }
 
@@ -270,40 +276,117 @@ public:
         operator ++ ();         // takes care of prefetching etc
     }
 
-    //! Continue reading at given block and subblock.
-    void skip_to(bid_iterator bid, size_t i_subblock)
+    //! Continue reading at given block and subblock. The block may also
+    //! precede the current one.
+    //!
+    //! Targets up to a prefetch window ahead of the sequential reading
+    //! position continue it. Other targets, e.g. buckets rewritten to the
+    //! end of the blocks by a split, are read out of sequence: only the
+    //! blocks holding the target's n_values values are fetched, and the
+    //! prefetched window is kept for returning to the sequential position.
+    //! Two nearby out of sequence targets in a row continue sequential
+    //! reading there.
+    //!
+    //! \param bid block to continue reading at
+    //! \param i_subblock subblock within bid to continue reading at
+    //! \param n_values number of values which will be read from there
+    void skip_to(bid_iterator bid, size_t i_subblock, size_t n_values = 0)
     {
-        if (curr_bid_ == end_bid_)
-            return;
+        if (curr_bid_ != end_bid_)
+            cache_.release_block(*curr_bid_);
 
         if (bid != curr_bid_)
             dirty_ = false;
 
-        cache_.release_block(*curr_bid_);
-
-        if (bid == end_bid_)
+        if (bid == end_bid_) {
+            curr_bid_ = end_bid_;
             return;
+        }
 
-        // skip to block
-        while (curr_bid_ != bid) {
-            ++curr_bid_;
+        const size_t window = page_size_ * prefetch_pages_;
 
-            if (prefetch_ && (curr_bid_ - begin_bid_) % page_size_ == 0)
+        if (bid >= seq_bid_ && static_cast<size_t>(bid - seq_bid_) <= window)
+        {
+            // continue sequential reading, prefetching pages on the way
+            curr_bid_ = seq_bid_;
+            while (curr_bid_ != bid) {
+                ++curr_bid_;
+                prefetch_page();
+            }
+            detour_ = false;
+        }
+        else if (detour_ && bid >= curr_bid_ &&
+                 static_cast<size_t>(bid - curr_bid_) <= window)
+        {
+            // second nearby jump in a row, e.g. past blocks left unused by
+            // split buckets: read sequentially from here
+            curr_bid_ = bid;
+            restart_prefetching();
+            detour_ = false;
+        }
+        else
+        {
+            // out of sequence: the target's first subblock is read below, its
+            // further blocks are prefetched
+            curr_bid_ = bid;
+            if (prefetch_)
             {
-                for (unsigned i = 0; i < page_size_; i++)
-                {
-                    if (pref_bid_ == end_bid_)
-                        break;
-                    cache_.prefetch_block(*pref_bid_);
-                    ++pref_bid_;
-                }
+                const size_t n_blocks = foxxll::div_ceil(
+                    i_subblock + foxxll::div_ceil(n_values, subblock_size),
+                    block_size);
+                bid_iterator it = bid;
+                for (size_t i = 1; i < n_blocks && ++it != end_bid_; ++i)
+                    cache_.prefetch_block(*it);
             }
+            detour_ = true;
         }
+
+        if (!detour_)
+            seq_bid_ = curr_bid_;
+
         // skip to subblock
         i_value_ = i_subblock * subblock_size;
         subblock_ = cache_.get_subblock(*curr_bid_, i_subblock);
         cache_.retain_block(*curr_bid_);
     }
+
+private:
+    //! prefetches page_size*prefetch_pages blocks beginning with the current
+    //! one
+    void restart_prefetching()
+    {
+        if (!prefetch_)
+            return;
+
+        pref_bid_ = curr_bid_;
+        for (size_t i = 0; i < page_size_ * prefetch_pages_; i++)
+        {
+            if (pref_bid_ == end_bid_)
+                break;
+
+            cache_.prefetch_block(*pref_bid_);
+            ++pref_bid_;
+        }
+    }
+
+    //! if a complete page has been consumed, prefetches the next one
+    void prefetch_page()
+    {
+        if (!prefetch_ || (curr_bid_ - begin_bid_) % page_size_ != 0)
+            return;
+
+        // the window fell behind, e.g. after a far forward jump
+        if (pref_bid_ < curr_bid_)
+            pref_bid_ = curr_bid_;
+
+        for (size_t i = 0; i < page_size_; i++)
+        {
+            if (pref_bid_ == end_bid_)
+                break;
+            cache_.prefetch_block(*pref_bid_);
+            ++pref_bid_;
+        }
+    }
 };
 
 //! Buffered writing of values. New Blocks are allocated as needed.
@@ -339,19 +422,37 @@ private:
     size_t i_value_;
     //! number of blocks to allocate in a row
     size_t increase_;
+    //! file to allocate the blocks in, or nullptr to use the block manager
+    file_block_store* store_;
+
+    //! appends increase_ newly allocated blocks to bids_
+    void allocate_blocks()
+    {
+        bids_->resize(bids_->size() + increase_);
+        if (store_)
+        {
+            store_->new_blocks(bids_->end() - increase_, bids_->end());
+            return;
+        }
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bm->new_blocks(foxxll::striping(), bids_->end() - increase_, bids_->end());
+    }
 
 public:
     //! Create a new buffered writer.
     //! \param c write values to these blocks (c holds the bids)
     //! \param buffer_size Number of write-buffers to use
     //! \param batch_size bulk buffered writing
+    //! \param store file to allocate the blocks in, if not temporary
     buffered_writer(bid_container_type* c,
-                    size_t buffer_size, size_t batch_size)
+                    size_t buffer_size, size_t batch_size,
+                    file_block_store* store = nullptr)
         : writer_(buffer_size, batch_size),
           bids_(c),
           i_block_(0),
           i_value_(0),
-          increase_(foxxll::config::get_instance()->disks_number() * 3)
+          increase_(foxxll::config::get_instance()->disks_number() * 3),
+          store_(store)
     {
         block_ = writer_.get_free_block();
     }
@@ -392,11 +493,7 @@ public:
 
             // allocate new blocks if neccessary ...
             if (i_block_ == bids_->size())
-            {
-                bids_->resize(bids_->size() + increase_);
-                foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-                bm->new_blocks(foxxll::striping(), bids_->end() - increase_, bids_->end());
-            }
+                allocate_blocks();
             // ... and write current block
             block_ = writer_.write(block_, (*bids_)[i_block_]);
 
@@ -417,11 +514,7 @@ public:
     {
         i_value_ = 0;
         if (i_block_ == bids_->size())
-        {
-            bids_->resize(bids_->size() + increase_);
-            foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-            bm->new_blocks(foxxll::striping(), bids_->end() - increase_, bids_->end());
-        }
+            allocate_blocks();
         block_ = writer_.write(block_, (*bids_)[i_block_]);
         i_block_++;
 
@@ -484,7 +577,9 @@ struct HashedValue
  * values are HashedValue-objects (actual value enriched with information on
  * where the value can be found (bucket-number, internal, external)).  Values,
  * marked as deleted in internal-memory, are not returned; for modified values
- * only the one in internal memory is returned.
+ * only the one in internal memory is returned. The buckets are visited in the
+ * order of their hash values, hence all values are returned ordered by
+ * (hash-value, key).
 */
 template <class HashMap, class Reader>
 struct HashedValuesStream
@@ -501,6 +596,7 @@ struct HashedValuesStream
 
     hash_map_type& map_;
     Reader& reader_;
+    bucket_iterator begin_bucket_;
     bucket_iterator curr_bucket_;
     bucket_iterator end_bucket_;
     bid_iterator begin_bid_;
@@ -514,6 +610,7 @@ struct HashedValuesStream
                        hash_map_type& map)
         : map_(map),
           reader_(reader),
+          begin_bucket_(begin_bucket),
           curr_bucket_(begin_bucket),
           end_bucket_(end_bucket),
           begin_bid_(begin_bid),
@@ -522,7 +619,11 @@ struct HashedValuesStream
           i_external_(0)
     {
         if (!empty())
+        {
+            reader_.skip_to(begin_bid_ + curr_bucket_->i_block_, curr_bucket_->i_subblock_,
+                            curr_bucket_->n_external_);
             value_ = find_next();
+        }
     }
 
     const value_type& operator * () { return value_; }
@@ -578,14 +679,20 @@ struct HashedValuesStream
 
             // if we made it to this point there are obviously no more values in the current bucket
             // let's try the next one (outer while-loop!)
-            ++curr_bucket_;
-            ++i_bucket_;
-            if (curr_bucket_ == end_bucket_)
+            const internal_size_type n_buckets =
+                static_cast<internal_size_type>(end_bucket_ - begin_bucket_);
+            i_bucket_ = map_._bkt_next(i_bucket_, n_buckets);
+            if (i_bucket_ == n_buckets)
+            {
+                curr_bucket_ = end_bucket_;
                 return value_type();
+            }
+            curr_bucket_ = begin_bucket_ + i_bucket_;
 
             node_ = curr_bucket_->list_;
             i_external_ = 0;
-            reader_.skip_to(begin_bid_ + curr_bucket_->i_block_, curr_bucket_->i_subblock_);
+            reader_.skip_to(begin_bid_ + curr_bucket_->i_block_, curr_bucket_->i_subblock_,
+                            curr_bucket_->n_external_);
         }
     }
 };
@@ -18,7 +18,9 @@
 
 #include <algorithm>
 #include <map>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace stxxl {
 namespace btree {
@@ -28,7 +30,8 @@ template <class KeyType,
           class CompareType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
 class btree;
 
@@ -73,17 +76,20 @@ class btree;
 //! \tparam RawNodeSize size of internal nodes of map in bytes (btree implementation).
 //! \tparam RawLeafSize size of leaves of map in bytes (btree implementation).
 //! \tparam PDAllocStrategy parallel disk block allocation strategy (\c foxxll::simple_random is recommended and default)
+//! \tparam OrderStatistics if true, the inner nodes keep the element counts
+//! of their subtrees, which enables nth(), rank() and count_range()
 //!
 template <class KeyType,
           class DataType,
           class CompareType,
           unsigned RawNodeSize = 16* 1024,      // 16 KBytes default
           unsigned RawLeafSize = 128* 1024,     // 128 KBytes default
-          class PDAllocStrategy = foxxll::simple_random
+          class PDAllocStrategy = foxxll::simple_random,
+          bool OrderStatistics = false
           >
 class map
 {
-    using impl_type = btree::btree<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>;
+    using impl_type = btree::btree<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>;
 
     impl_type impl;
 
@@ -107,6 +113,9 @@ public:
     using const_iterator = typename impl_type::const_iterator;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    //! read-only cursor which is not registered in the map, see
+    //! btree::btree_cursor
+    using cursor_type = typename impl_type::cursor_type;
 
     //! \name Iterators
     //! \{
@@ -227,6 +236,57 @@ public:
                range_sorted, node_fill_factor, leaf_fill_factor)
     { }
 
+    //! Constructs a map bound to a file, which keeps its nodes, leaves and
+    //! root node in the file. If the file contains a map written by sync() or
+    //! the destructor, the map is reopened with its contents, otherwise it
+    //! starts empty. Other than temporary maps, the map does not free its
+    //! blocks on destruction.
+    //! \param file file to store the map in, which must be used by no other
+    //! container
+    //! \param node_cache_size_in_bytes size of node cache in bytes (btree implementation)
+    //! \param leaf_cache_size_in_bytes size of leaf cache in bytes (btree implementation)
+    map(foxxll::file_ptr file,
+        const size_t node_cache_size_in_bytes,
+        const size_t leaf_cache_size_in_bytes)
+        : impl(file, key_compare(), node_cache_size_in_bytes, leaf_cache_size_in_bytes)
+    { }
+
+    //! Constructs a map bound to a file, see above.
+    //! \param file file to store the map in
+    //! \param c_ comparator object
+    //! \param node_cache_size_in_bytes size of node cache in bytes (btree implementation)
+    //! \param leaf_cache_size_in_bytes size of leaf cache in bytes (btree implementation)
+    map(foxxll::file_ptr file,
+        const key_compare& c_,
+        const size_t node_cache_size_in_bytes,
+        const size_t leaf_cache_size_in_bytes)
+        : impl(file, c_, node_cache_size_in_bytes, leaf_cache_size_in_bytes)
+    { }
+
+    //! Constructs a map bound to a file from a given input range, discarding
+    //! previous contents of the file.
+    //! \param file file to store the map in
+    //! \param b beginning of the range
+    //! \param e end of the range
+    //! \param node_cache_size_in_bytes size of node cache in bytes (btree implementation)
+    //! \param leaf_cache_size_in_bytes size of leaf cache in bytes (btree implementation)
+    //! \param range_sorted if \c true than the constructor assumes that the range is sorted
+    //! and performs a fast bottom-up bulk construction of the map (btree implementation)
+    //! \param node_fill_factor node fill factor in [0,1] for bulk construction
+    //! \param leaf_fill_factor leaf fill factor in [0,1] for bulk construction
+    template <class InputIterator>
+    map(foxxll::file_ptr file,
+        InputIterator b,
+        InputIterator e,
+        const size_t node_cache_size_in_bytes,
+        const size_t leaf_cache_size_in_bytes,
+        const bool range_sorted = false,
+        const double node_fill_factor = 0.75,
+        const double leaf_fill_factor = 0.6)
+        : impl(file, b, e, key_compare(), node_cache_size_in_bytes, leaf_cache_size_in_bytes,
+               range_sorted, node_fill_factor, leaf_fill_factor)
+    { }
+
     //! non-copyable: delete copy-constructor
     map(const map&) = delete;
     //! non-copyable: delete assignment operator
@@ -310,6 +370,69 @@ public:
         return impl.equal_range(k);
     }
 
+    //! Looks up a batch of ascendingly sorted keys with one shared descent,
+    //! prefetching the nodes and leaves of each level together. out[i] is
+    //! set to (true, data) if sorted_keys[i] is found, else to (false,
+    //! data_type()).
+    void find_batch(const std::vector<key_type>& sorted_keys,
+                    std::vector<std::pair<bool, data_type> >& out) const
+    {
+        impl.find_batch(sorted_keys, out);
+    }
+
+    //! \}
+
+    //! \name Order Statistics
+    //! Only available if OrderStatistics is true, each query reads one node
+    //! per level of the tree.
+    //! \{
+
+    //! Returns an iterator to the n-th smallest element, counting from zero,
+    //! or end() if n >= size().
+    template <bool Enabled = OrderStatistics>
+    typename std::enable_if<Enabled, const_iterator>::type
+    nth(size_type n) const
+    {
+        return impl.nth(n);
+    }
+
+    //! Returns the number of elements with keys less than k.
+    template <bool Enabled = OrderStatistics>
+    typename std::enable_if<Enabled, size_type>::type
+    rank(const key_type& k) const
+    {
+        return impl.rank(k);
+    }
+
+    //! Returns the number of elements with lo <= key < hi.
+    template <bool Enabled = OrderStatistics>
+    typename std::enable_if<Enabled, size_type>::type
+    count_range(const key_type& lo, const key_type& hi) const
+    {
+        return impl.count_range(lo, hi);
+    }
+
+    //! \}
+
+    //! \name Scans
+    //! \{
+
+    //! Returns a read-only cursor at the first element not less than k.
+    //! Cursors cost no bookkeeping, unlike iterators, and are revalidated by
+    //! the modification epochs of the leaves.
+    cursor_type lower_bound_cursor(const key_type& k) const
+    {
+        return impl.lower_bound_cursor(k);
+    }
+
+    //! Calls fn(value) for all elements with lo <= key < hi in ascending
+    //! order, without creating iterators. fn must not modify the map.
+    template <typename Functor>
+    void for_range(const key_type& lo, const key_type& hi, Functor fn) const
+    {
+        impl.for_range(lo, hi, fn);
+    }
+
     //! \}
 
     //! \name Operators
@@ -343,6 +466,58 @@ public:
         return impl.prefetching_enabled();
     }
 
+    //! Changes the sizes of the node and leaf caches at runtime
+    //! \param node_cache_size_in_bytes size of node cache in bytes (btree implementation)
+    //! \param leaf_cache_size_in_bytes size of leaf cache in bytes (btree implementation)
+    void resize_caches(const size_t node_cache_size_in_bytes,
+                       const size_t leaf_cache_size_in_bytes)
+    {
+        impl.resize_caches(node_cache_size_in_bytes, leaf_cache_size_in_bytes);
+    }
+
+    //! Returns the fraction of the node cache reserved for the upper levels
+    //! of the tree
+    double pinned_fraction() const
+    {
+        return impl.pinned_fraction();
+    }
+
+    //! Sets the fraction of the node cache reserved for the upper levels of
+    //! the tree. Starting from the top, whole levels are pinned in the cache
+    //! as long as they fit, such that random lookups only read the lower
+    //! levels. Per-level hit rates are reported by print_statistics().
+    void pinned_fraction(double fraction)
+    {
+        impl.pinned_fraction(fraction);
+    }
+
+    //! Writes the cached nodes and leaves and the root node to the file the
+    //! map is bound to, after which the file can be reopened. Does nothing
+    //! for temporary maps.
+    void sync()
+    {
+        impl.sync();
+    }
+
+    //! Returns true if the map is bound to a file.
+    bool persistent() const
+    {
+        return impl.persistent();
+    }
+
+    //! Attaches an account counting the I/O of the node and leaf caches, or
+    //! nullptr to detach it
+    void set_io_account(io_account* account)
+    {
+        impl.set_io_account(account);
+    }
+
+    //! Returns the attached I/O account, or nullptr
+    io_account * get_io_account() const
+    {
+        return impl.get_io_account();
+    }
+
     //! Prints cache statistics
     void print_statistics(std::ostream& o) const
     {
@@ -363,54 +538,60 @@ public:
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator == (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator == (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator < (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator < (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator > (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator > (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator != (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator != (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator <= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator <= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator >= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              bool OrderStatistics_>
+    friend bool operator >= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, OrderStatistics_>& b);
     //////////////////////////////////////////////////
 };
 
@@ -419,10 +600,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator == (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator == (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl == b.impl;
 }
@@ -432,10 +614,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator < (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator < (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl < b.impl;
 }
@@ -445,10 +628,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator > (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator > (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl > b.impl;
 }
@@ -458,10 +642,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator != (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator != (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl != b.impl;
 }
@@ -471,10 +656,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator <= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator <= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl <= b.impl;
 }
@@ -484,10 +670,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-inline bool operator >= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator >= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b)
 {
     return a.impl >= b.impl;
 }
@@ -503,10 +690,11 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          bool OrderStatistics
           >
-void swap(stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-          stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b
+void swap(stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& a,
+          stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, OrderStatistics>& b
           )
 {
     a.swap(b);
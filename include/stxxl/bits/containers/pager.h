@@ -103,6 +103,23 @@ public:
         history_entry.swap(obj.history_entry);
     }
 
+    //! Changes the number of pages. Added pages are the least recently used
+    //! ones, removed pages are dropped from the history.
+    void resize(size_type num_pages)
+    {
+        tlx::simple_vector<list_type::iterator> entries(num_pages);
+        for (size_type i = 0; i < num_pages; ++i)
+        {
+            if (i < size())
+                entries[i] = history_entry[i];
+            else
+                entries[i] = history.insert(history.end(), i);
+        }
+        for (size_type i = num_pages; i < size(); ++i)
+            history.erase(history_entry[i]);
+        history_entry.swap(entries);
+    }
+
     size_type size() const
     {
         return history_entry.size();
@@ -49,6 +49,8 @@
 #include <foxxll/mng/typed_block.hpp>
 
 #include <stxxl/bits/common/custom_stats.h>
+#include <stxxl/bits/common/huge_page_arena.h>
+#include <stxxl/bits/common/io_account.h>
 #include <stxxl/bits/common/is_heap.h>
 #include <stxxl/bits/common/swap_vector.h>
 #include <stxxl/bits/common/winner_tree.h>
@@ -280,11 +282,15 @@ public:
     using value_type = ValueType;
     using iterator = ppq_iterator<value_type>;
 
+    //! Vector of values, taken from the huge_page_arena if large, such that
+    //! the arrays and heaps replaced on every flush reuse their buffers.
+    using values_type = std::vector<value_type, huge_page_allocator<value_type> >;
+
 protected:
     using block_pointers_type = typename iterator::block_pointers_type;
 
     //! Contains the items of the sorted sequence.
-    std::vector<value_type> m_values;
+    values_type m_values;
 
     //! Index of the current head
     size_t m_min_index;
@@ -303,7 +309,7 @@ public:
 
     //! Constructor which takes a value vector. The value vector is empty
     //! afterwards.
-    explicit internal_array(std::vector<value_type>& values,
+    explicit internal_array(values_type& values,
                             const size_t min_index = 0,
                             const size_t level = 0)
         : m_values(), m_min_index(min_index), m_level(level),
@@ -525,6 +531,9 @@ protected:
     //! needed anymore.
     size_t m_old_unhinted_block;
 
+    //! Account counting the I/O of the array, or nullptr.
+    io_account* m_io_account;
+
     //! allow writer to access to all variables
     friend class external_array_writer<self_type>;
 
@@ -561,7 +570,8 @@ public:
           m_index(0),
           m_end_index(0),
           m_unhinted_block(0),
-          m_old_unhinted_block(0)
+          m_old_unhinted_block(0),
+          m_io_account(nullptr)
     {
         assert(m_capacity > 0);
         // allocate blocks in EM.
@@ -593,7 +603,8 @@ public:
           m_index(0),
           m_end_index(0),
           m_unhinted_block(0),
-          m_old_unhinted_block(0)
+          m_old_unhinted_block(0),
+          m_io_account(nullptr)
     { }
 
     //! Swap external_array with another one.
@@ -623,6 +634,8 @@ public:
         swap(m_end_index, o.m_end_index);
         swap(m_unhinted_block, o.m_unhinted_block);
         swap(m_old_unhinted_block, o.m_old_unhinted_block);
+
+        swap(m_io_account, o.m_io_account);
     }
 
     //! Swap external_array with another one.
@@ -657,6 +670,8 @@ public:
         for (size_t i = end_block_index; i < m_unhinted_block; ++i) {
             LOG << "ea[" << this << "]: discarding prefetch hint on block " << i;
 
+            if (m_io_account)
+                m_io_account->add_wasted(1);
             m_requests[i]->cancel();
             m_requests[i]->wait();
             // put block back into pool
@@ -699,6 +714,12 @@ public:
         return m_level;
     }
 
+    //! Sets the account counting the I/O of the array, or nullptr.
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+    }
+
     //! Return the number of blocks.
     size_t num_blocks() const
     {
@@ -900,6 +921,8 @@ protected:
             // we immediately wait for the I/O to be completed.
             m_blocks[block_index] = m_pool->steal();
             request_ptr req = m_pool->read(m_blocks[block_index], m_bids[block_index]);
+            if (m_io_account)
+                m_io_account->add_read(1, block_type::raw_size);
             req->wait();
             assert(req->poll());
             assert(m_blocks[block_index]);
@@ -929,6 +952,8 @@ protected:
 
         // write out block (in background)
         m_pool->write(m_blocks[block_index], m_bids[block_index]);
+        if (m_io_account)
+            m_io_account->add_write(1, block_type::raw_size);
 
         m_blocks[block_index] = nullptr;
     }
@@ -937,6 +962,15 @@ public:
     //! \name Prefetching Hints
     //! \{
 
+    //! Counts a hinted block in the account.
+    void account_prefetch()
+    {
+        if (!m_io_account)
+            return;
+        m_io_account->add_prefetch(1);
+        m_io_account->add_read(1, block_type::raw_size);
+    }
+
     //! Prefetch the next unhinted block, requires one free read block from the
     //! global pool.
     void hint_next_block()
@@ -955,6 +989,7 @@ public:
         // checks the associated write_pool.
         m_blocks[i] = m_pool->steal_prefetch();
         m_requests[i] = m_pool->read(m_blocks[i], m_bids[i]);
+        account_prefetch();
     }
 
     //! Returns if there is data in EM, that's not already hinted
@@ -1012,6 +1047,8 @@ public:
         for (size_t i = m_unhinted_block; i < m_old_unhinted_block; ++i) {
             LOG << "ea[" << this << "]: discarding prefetch hint on"
                 " block " << i;
+            if (m_io_account)
+                m_io_account->add_wasted(1);
             m_requests[i]->cancel();
             m_requests[i]->wait();
             // put block back into pool
@@ -1035,6 +1072,7 @@ public:
             assert(m_blocks[i] == nullptr);
             m_blocks[i] = m_pool->steal_prefetch();
             m_requests[i] = m_pool->read(m_blocks[i], m_bids[i]);
+            account_prefetch();
         }
     }
 
@@ -1062,7 +1100,10 @@ public:
         assert(m_requests[i].valid());
 
         // wait for prefetched request to finish.
-        m_requests[i]->wait();
+        {
+            io_account::wait_timer wait(m_io_account);
+            m_requests[i]->wait();
+        }
         assert(m_requests[i]->poll());
         assert(m_blocks[i]);
 
@@ -1092,6 +1133,7 @@ public:
     //! blocks were successfully read.
     size_t wait_all_hinted_blocks()
     {
+        io_account::wait_timer wait(m_io_account);
         size_t begin = get_end_block_index(), i = begin;
         while (i < m_unhinted_block)
         {
@@ -1900,7 +1942,8 @@ public:
     using internal_array_type = ppq_local::internal_array<value_type>;
     using external_array_type = ppq_local::external_array<value_type, block_size, AllocStrategy>;
     using external_array_writer_type = typename external_array_type::writer_type;
-    using value_iterator = typename std::vector<value_type>::iterator;
+    using value_vector_type = typename internal_array_type::values_type;
+    using value_iterator = typename value_vector_type::iterator;
     using iterator = typename internal_array_type::iterator;
     using iterator_pair_type = std::pair<iterator, iterator>;
 
@@ -1914,7 +1957,7 @@ public:
 
 protected:
     //! type of insertion heap itself
-    using heap_type = std::vector<value_type>;
+    using heap_type = value_vector_type;
 
     //! type of internal arrays vector
     using internal_arrays_type = typename stxxl::swap_vector<internal_array_type>;
@@ -2101,7 +2144,7 @@ protected:
 
     //! The extract buffer where external (and internal) arrays are merged into
     //! for extracting
-    std::vector<value_type> m_extract_buffer;
+    value_vector_type m_extract_buffer;
 
     //! The sorted arrays in internal memory
     internal_arrays_type m_internal_arrays;
@@ -2109,8 +2152,11 @@ protected:
     //! The sorted arrays in external memory
     external_arrays_type m_external_arrays;
 
+    //! Account counting the I/O of the external arrays, or nullptr.
+    io_account* m_io_account = nullptr;
+
     //! The aggregated pushes. They cannot be extracted yet.
-    std::vector<value_type> m_aggregated_pushes;
+    value_vector_type m_aggregated_pushes;
 
     //! The maximum number of internal array levels.
     static constexpr size_t kMaxInternalLevels = 8;
@@ -2606,6 +2652,21 @@ public:
         return (m_mem_total - m_mem_left);
     }
 
+    //! Attaches an account counting the blocks written, hinted and read by
+    //! the external arrays, or nullptr to detach it.
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+        for (size_t i = 0; i < m_external_arrays.size(); ++i)
+            m_external_arrays[i].set_io_account(account);
+    }
+
+    //! Returns the attached I/O account, or nullptr.
+    io_account * get_io_account() const
+    {
+        return m_io_account;
+    }
+
 protected:
     //! Returns if the extract buffer is empty.
     inline bool extract_buffer_empty() const
@@ -2836,7 +2897,8 @@ public:
     }
 
     //! Extract up to max_size values at once.
-    void bulk_pop(std::vector<value_type>& out, size_t max_size)
+    template <typename Vector>
+    void bulk_pop(Vector& out, size_t max_size)
     {
         LOG << "bulk_pop() max_size=" << max_size;
 
@@ -2850,9 +2912,7 @@ public:
 
         refill_extract_buffer(n_elements, n_elements);
 
-        out.resize(0);
-        using std::swap;
-        swap(m_extract_buffer, out);
+        take_extract_buffer(out);
         m_extract_buffer_index = 0;
         m_extract_buffer_size = 0;
         m_minima.deactivate_extract_buffer();
@@ -2866,7 +2926,8 @@ public:
     //! \param max_size maximum number of items to extract
     //! \return true if the buffer contains all items < limit, false it was too
     //! small.
-    bool bulk_pop_limit(std::vector<value_type>& out, const value_type& limit,
+    template <typename Vector>
+    bool bulk_pop_limit(Vector& out, const value_type& limit,
                         size_t max_size = std::numeric_limits<size_t>::max())
     {
         LOG << "bulk_pop_limit with limit=" << limit;
@@ -3203,7 +3264,7 @@ public:
         m_limit_extract = true;
         m_limit_element = limit;
 
-        std::vector<value_type> new_extract_buffer;
+        value_vector_type new_extract_buffer;
         m_limit_has_full_range =
             bulk_pop_limit(new_extract_buffer, limit, m_extract_buffer_limit);
         std::swap(new_extract_buffer, m_extract_buffer);
@@ -3240,7 +3301,7 @@ public:
         if (extract_buffer_empty())
         {
             // extract more items
-            std::vector<value_type> new_extract_buffer;
+            value_vector_type new_extract_buffer;
             m_limit_has_full_range =
                 bulk_pop_limit(new_extract_buffer, m_limit_element,
                                m_extract_buffer_limit);
@@ -3270,7 +3331,7 @@ public:
         if (extract_buffer_empty() && !m_limit_has_full_range)
         {
             // extract more items
-            std::vector<value_type> new_extract_buffer;
+            value_vector_type new_extract_buffer;
             m_limit_has_full_range =
                 bulk_pop_limit(new_extract_buffer, m_limit_element,
                                m_extract_buffer_limit);
@@ -3350,10 +3411,10 @@ protected:
             // test that enough RAM is available for remaining items
             flush_ia_ea_until_memory_free(back_sum * sizeof(value_type));
 
-            std::vector<value_type> values(back_sum);
+            value_vector_type values(back_sum);
 
             // copy items into values vector
-            typename std::vector<value_type>::iterator vi = values.begin();
+            value_iterator vi = values.begin();
             for (unsigned p = 0; p < m_num_insertion_heaps; ++p)
             {
                 heap_type& insheap = m_proc[p]->insertion_heap;
@@ -3787,6 +3848,22 @@ protected:
         m_extract_buffer_size = 0;
     }
 
+    //! Hands the extract buffer to out, which has the same type.
+    void take_extract_buffer(value_vector_type& out)
+    {
+        out.resize(0);
+        using std::swap;
+        swap(m_extract_buffer, out);
+    }
+
+    //! Copies the extract buffer to out of another vector type and frees it.
+    template <typename Vector>
+    void take_extract_buffer(Vector& out)
+    {
+        out.assign(m_extract_buffer.begin(), m_extract_buffer.end());
+        value_vector_type().swap(m_extract_buffer);
+    }
+
     //! Refills the extract buffer from the external arrays.
     //! \param minimum_size requested minimum size of the resulting extract buffer.
     //!         Prints a warning if there is not enough data to reach this size.
@@ -4050,7 +4127,7 @@ protected:
         if (c_merge_sorted_heaps)
         {
             m_stats.merge_sorted_heaps_time.start();
-            std::vector<value_type> merged_array(size);
+            value_vector_type merged_array(size);
 
             potentially_parallel::multiway_merge(
                 sequences.begin(), sequences.end(),
@@ -4132,6 +4209,7 @@ protected:
         // construct new external array
 
         external_array_type ea(size, &m_pool, 0);
+        ea.set_io_account(m_io_account);
 
         m_stats.max_merge_buffer_size.set_max(size);
 
@@ -4254,6 +4332,7 @@ protected:
 
         // construct new external array
         external_array_type ea(level_size, &m_pool, new_level);
+        ea.set_io_account(m_io_account);
         {
             external_array_writer_type external_array_writer(ea);
             typename external_array_writer_type::iterator out_iter
@@ -4447,7 +4526,7 @@ protected:
     //! Add new internal array, which requires that values are sorted!
     //! automatically decreases m_mem_left! also merges internal arrays if
     //! there are too many internal arrays on the same level.
-    void add_as_internal_array(std::vector<value_type>& values,
+    void add_as_internal_array(value_vector_type& values,
                                const size_t used = 0,
                                const size_t level = 0)
     {
@@ -4510,7 +4589,7 @@ protected:
             " level_size=" << level_size <<
             " sequences=" << sequences.size();
 
-        std::vector<value_type> merged_array(level_size);
+        value_vector_type merged_array(level_size);
 
         potentially_parallel::multiway_merge(
             sequences.begin(), sequences.end(),
@@ -4536,7 +4615,7 @@ protected:
      *
      * \param values the vector to sort and store
      */
-    void flush_array_internal(std::vector<value_type>& values)
+    void flush_array_internal(value_vector_type& values)
     {
         potentially_parallel::sort(values.begin(), values.end(), m_inv_compare);
 
@@ -228,6 +228,14 @@ public:
         m_runs_merger.set_memory_to_use(merger_memory_to_use);
     }
 
+    //! Attach an account counting the blocks written by the run formation
+    //! and read by the merger, or nullptr to detach it.
+    void set_io_account(io_account* account)
+    {
+        m_runs_creator.set_io_account(account);
+        m_runs_merger.set_io_account(account);
+    }
+
     //! \}
 
     //! \name Capacity
@@ -105,6 +105,20 @@ public:
     //! constructed equality predicate for key
     using key_equal = typename impl_type::key_equal;
 
+    //! filter applied to rewritten values, see compaction_filter()
+    using compaction_filter_type = typename impl_type::compaction_filter_type;
+
+    //! asynchronous lookups keeping many reads in flight, see
+    //! hash_map::async_finder
+    class async_finder : public hash_map::async_finder<impl_type>
+    {
+    public:
+        explicit async_finder(const unordered_map& map,
+                              internal_size_type max_in_flight = 64)
+            : hash_map::async_finder<impl_type>(map.impl, max_in_flight)
+        { }
+    };
+
     //! \}
 
     //! \name Constructors
@@ -151,6 +165,27 @@ public:
         : impl(begin, end, mem_to_sort, n, hf, cmp, buffer_size, a)
     { }
 
+    /*!
+     * Construct a hash-map bound to a file. If the file contains a hash-map
+     * written by sync() or the destructor, it is reopened with its contents,
+     * otherwise the hash-map starts empty. The blocks in the file are not
+     * freed on destruction.
+     *
+     * \param file file to store the hash-map in, which must be used by no
+     * other container
+     * \param hf hash-function, must be the same whenever the file is opened
+     * \param cmp comparator-object
+     * \param buffer_size size of internal-memory buffer in bytes
+     * \param a allocation-strategory for internal-memory buffer
+     */
+    explicit unordered_map(foxxll::file_ptr file,
+                           const hasher& hf = hasher(),
+                           const key_compare& cmp = key_compare(),
+                           internal_size_type buffer_size = 100*1024*1024,
+                           const allocator_type& a = allocator_type())
+        : impl(file, hf, cmp, buffer_size, a)
+    { }
+
     //! non-copyable: delete copy-constructor
     unordered_map(const unordered_map&) = delete;
     //! non-copyable: delete assignment operator
@@ -212,6 +247,17 @@ public:
         return impl.end();
     }
 
+    //! Calls fn(const value_type&) for each value, using several threads if
+    //! parallel mode is enabled. fn must be safe to call concurrently, and
+    //! the hash-map must not be modified until the call returns.
+    //! \param fn functor called for each value
+    //! \param num_threads number of threads, 0 for the OpenMP default
+    template <typename Functor>
+    void parallel_for_each(Functor fn, size_t num_threads = 0) const
+    {
+        impl.parallel_for_each(fn, num_threads);
+    }
+
     //! \}
 
     //! \name Lookup and Element Access
@@ -343,6 +389,20 @@ public:
         std::swap(impl, obj.impl);
     }
 
+    //! Write the cached blocks, the bucket directory and the buffer to the
+    //! file the hash-map is bound to, after which the file can be reopened.
+    //! Does nothing for temporary hash-maps.
+    void sync()
+    {
+        impl.sync();
+    }
+
+    //! Returns true if the hash-map is bound to a file.
+    bool persistent() const
+    {
+        return impl.persistent();
+    }
+
     //! \}
 
     //! \name Bucket Interface
@@ -397,6 +457,20 @@ public:
         impl.rehash(n);
     }
 
+    //! Get the filter applied to rewritten values
+    const compaction_filter_type& compaction_filter() const
+    {
+        return impl.compaction_filter();
+    }
+
+    //! Set a filter which is applied to every value rewritten in external
+    //! memory, and may update or drop it (returning false). rehash() rewrites
+    //! all values.
+    void compaction_filter(const compaction_filter_type& filter)
+    {
+        impl.compaction_filter(filter);
+    }
+
     //! \}
 
     //! \name Observers
@@ -461,6 +535,19 @@ public:
         impl.reset_statistics();
     }
 
+    //! Attach an account counting the block cache's I/O, or nullptr to
+    //! detach it.
+    void set_io_account(io_account* account)
+    {
+        impl.set_io_account(account);
+    }
+
+    //! The attached I/O account, or nullptr.
+    io_account * get_io_account() const
+    {
+        return impl.get_io_account();
+    }
+
     //! Print short general statistics to output stream
     void print_statistics(std::ostream& o = std::cout) const
     {
@@ -17,7 +17,11 @@
 #define STXXL_CONTAINERS_VECTOR_HEADER
 
 #include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
 #include <queue>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -34,7 +38,9 @@
 #include <foxxll/mng/buf_ostream.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
+#include <stxxl/bits/common/io_account.h>
 #include <stxxl/bits/common/is_sorted.h>
+#include <stxxl/bits/common/shared_blocks.h>
 #include <stxxl/bits/containers/pager.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/deprecated.h>
@@ -286,6 +292,9 @@ class vector_bufreader_reverse;
 template <typename VectorIteratorType>
 class vector_bufwriter;
 
+template <typename VectorType, typename Callback>
+class vector_async_reader;
+
 ////////////////////////////////////////////////////////////////////////////
 
 //! External vector iterator, model of \c ext_random_access_iterator concept.
@@ -550,9 +559,13 @@ public:
         p_vector->block_externally_updated(offset);
     }
 
+    //! Flushes the vector's cache and gives it exclusive ownership of all
+    //! its blocks, see vector::unshare_blocks(). Must be called before
+    //! accessing the blocks directly.
     void flush()
     {
         p_vector->flush();
+        p_vector->unshare_blocks();
     }
 
     //! \}
@@ -883,6 +896,7 @@ public:
 
     //! vector_bufwriter compatible with this vector
     using bufwriter_type = vector_bufwriter<iterator>;
+    friend bufwriter_type;
 
     //! vector_bufreader compatible with this vector
     using bufreader_type = vector_bufreader<const_iterator>;
@@ -890,6 +904,12 @@ public:
     //! vector_bufreader compatible with this vector
     using bufreader_reverse_type = vector_bufreader_reverse<const_iterator>;
 
+    //! vector_async_reader for this vector
+    using async_reader_type = vector_async_reader<
+              vector, std::function<void(const value_type&)> >;
+    template <typename VectorType, typename Callback>
+    friend class vector_async_reader;
+
     //! \internal
     class bid_vector : public std::vector<foxxll::BID<block_size> >
     {
@@ -904,6 +924,7 @@ public:
     using bids_container_type = bid_vector;
     using bids_container_iterator = typename bids_container_type::iterator;
     using const_bids_container_iterator = typename bids_container_type::const_iterator;
+    using bid_type = typename bids_container_type::bid_type;
 
     //! type of the block used in disk-memory transfers
     using block_type = foxxll::typed_block<BlockSize, ValueType>;
@@ -935,6 +956,10 @@ private:
     foxxll::file_ptr m_from;
     foxxll::block_manager* m_bm;
     bool m_exported;
+    //! whether blocks may be shared copy-on-write with other vectors
+    mutable bool m_shared;
+    //! account counting the page reads and writes, or nullptr
+    io_account* m_io_account = nullptr;
 
     size_type size_from_file_length(foxxll::external_size_type file_length) const
     {
@@ -972,7 +997,8 @@ public:
           m_page_to_slot(foxxll::div_ceil(m_bids.size(), page_size), on_disk),
           m_slot_to_page(npages),
           m_cache(nullptr),
-          m_exported(false)
+          m_exported(false),
+          m_shared(false)
     {
         m_bm = foxxll::block_manager::get_instance();
 
@@ -1003,6 +1029,8 @@ public:
         std::swap(m_cache, obj.m_cache);
         std::swap(m_from, obj.m_from);
         std::swap(m_exported, obj.m_exported);
+        std::swap(m_shared, obj.m_shared);
+        std::swap(m_io_account, obj.m_io_account);
     }
 
     //! \}
@@ -1136,6 +1164,41 @@ private:
         m_size = n;
     }
 
+    //! Starts allocating the blocks to grow the capacity to n elements on a
+    //! background thread. The result is passed to _reserve_bids(), the
+    //! returned future is invalid if the vector is backed by a file.
+    std::future<std::vector<bid_type> > _allocate_bids_async(size_type n) const
+    {
+        if (m_from || n <= capacity())
+            return std::future<std::vector<bid_type> >();
+
+        const size_t old_bids_size = m_bids.size();
+        const size_t new_bids_size = static_cast<size_t>(
+            foxxll::div_ceil(n, block_type::size));
+        foxxll::block_manager* bm = m_bm;
+        const alloc_strategy_type alloc_strategy = m_alloc_strategy;
+
+        return std::async(
+            std::launch::async,
+            [=]() {
+                std::vector<bid_type> bids(new_bids_size - old_bids_size);
+                bm->new_blocks(alloc_strategy, bids.begin(), bids.end(),
+                               old_bids_size);
+                return bids;
+            });
+    }
+
+    //! Appends blocks allocated by _allocate_bids_async() to the capacity.
+    void _reserve_bids(const std::vector<bid_type>& bids)
+    {
+        const size_t new_bids_size = m_bids.size() + bids.size();
+        const size_t new_pages = foxxll::div_ceil(new_bids_size, page_size);
+        m_page_status.resize(new_pages, uninitialized);
+        m_page_to_slot.resize(new_pages, on_disk);
+
+        m_bids.insert(m_bids.end(), bids.begin(), bids.end());
+    }
+
     //! Resize vector, also allow reduction of external memory capacity.
     void _resize_shrink_capacity(size_type n)
     {
@@ -1159,7 +1222,7 @@ private:
             if (m_from)
                 m_from->set_size(new_bids_size * block_type::raw_size);
             else
-                m_bm->delete_blocks(m_bids.begin() + old_bids_size, m_bids.end());
+                delete_bids(m_bids.begin() + new_bids_size, m_bids.end());
 
             m_bids.resize(new_bids_size);
 
@@ -1185,7 +1248,7 @@ public:
     {
         m_size = 0;
         if (!m_from)
-            m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+            delete_bids(m_bids.begin(), m_bids.end());
 
         m_bids.clear();
         m_page_status.clear();
@@ -1263,7 +1326,8 @@ public:
           m_slot_to_page(npages),
           m_cache(nullptr),
           m_from(from),
-          m_exported(false)
+          m_exported(false),
+          m_shared(false)
     {
         // initialize from file
         if (!block_type::has_only_data)
@@ -1293,6 +1357,9 @@ public:
     }
 
     //! copy-constructor
+    //!
+    //! Unless obj is mapped to a file, the copy shares the blocks of obj.
+    //! A shared block is copied only once either vector writes to it.
     vector(const vector& obj)
         : m_size(obj.size()),
           m_bids(static_cast<size_t>(foxxll::div_ceil(obj.size(), block_type::size))),
@@ -1301,7 +1368,8 @@ public:
           m_page_to_slot(foxxll::div_ceil(m_bids.size(), page_size), on_disk),
           m_slot_to_page(obj.numpages()),
           m_cache(nullptr),
-          m_exported(false)
+          m_exported(false),
+          m_shared(false)
     {
         assert(!obj.m_exported);
         m_bm = foxxll::block_manager::get_instance();
@@ -1311,6 +1379,12 @@ public:
         for (size_t i = 0; i < numpages(); ++i)
             m_free_slots.push(i);
 
+        if (!obj.m_from)
+        {
+            share_blocks(obj, 0);
+            return;
+        }
+
         m_bm->new_blocks(m_alloc_strategy, m_bids.begin(), m_bids.end(), 0);
 
         const_iterator inbegin = obj.begin();
@@ -1336,6 +1410,107 @@ public:
 
     //! \}
 
+    //! \name Copy-on-Write Sharing
+    //! \{
+
+    //! Replaces the contents by the range [first, last) of a vector. If first
+    //! is the beginning of a block and neither vector is mapped to a file,
+    //! the blocks of the range are shared copy-on-write, which costs no I/O.
+    //! Otherwise the elements are copied.
+    void assign(const_iterator first, const_iterator last)
+    {
+        const vector& obj = *first.parent_vector();
+        assert(first.parent_vector() == last.parent_vector());
+        assert(first <= last);
+
+        if (&obj == this)
+        {
+            vector tmp(0, numpages());
+            tmp.assign(first, last);
+            this->swap(tmp);
+            return;
+        }
+
+        const size_type n = last - first;
+
+        if (m_from || obj.m_from || first.block_offset() != 0)
+        {
+            resize(n);
+            std::copy(first, last, begin());
+            return;
+        }
+
+        clear();
+
+        const size_t nbids = static_cast<size_t>(foxxll::div_ceil(n, block_type::size));
+        m_bids.resize(nbids);
+        m_page_status.resize(foxxll::div_ceil(nbids, page_size), valid_on_disk);
+        m_page_to_slot.resize(foxxll::div_ceil(nbids, page_size), on_disk);
+        m_size = n;
+
+        share_blocks(obj, static_cast<size_t>((first - obj.cbegin()) / block_type::size));
+    }
+
+    //! Returns a vector holding the range [first, last) of this vector,
+    //! sharing its blocks copy-on-write if first is a multiple of the block
+    //! size, see assign().
+    vector subvector(size_type first, size_type last) const
+    {
+        assert(first <= last && last <= size());
+        vector v(0, numpages());
+        v.assign(cbegin() + first, cbegin() + last);
+        return v;
+    }
+
+    /*!
+     * Gives the vector exclusive ownership of all its blocks by copying the
+     * blocks it shares with other vectors. This is called by the flush() of a
+     * mutable iterator, which algorithms use before they access the blocks of
+     * the vector directly. Reading through const_iterators does not unshare.
+     */
+    void unshare_blocks()
+    {
+        if (!m_shared)
+            return;
+
+        flush();
+
+        shared_blocks* sb = shared_blocks::get_instance();
+        const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        tlx::simple_vector<block_type> blocks(nbuffers);
+        std::vector<foxxll::request_ptr> reqs(nbuffers);
+        std::vector<size_t> block_nos;
+        block_nos.reserve(nbuffers);
+
+        size_t i = 0;
+        while (i < m_bids.size())
+        {
+            block_nos.clear();
+            for ( ; i < m_bids.size() && block_nos.size() < nbuffers; ++i)
+            {
+                if (!sb->is_shared(m_bids[i]))
+                    continue;
+
+                reqs[block_nos.size()] = blocks[block_nos.size()].read(m_bids[i]);
+                block_nos.push_back(i);
+            }
+
+            wait_all(reqs.data(), block_nos.size());
+
+            for (size_t k = 0; k < block_nos.size(); ++k)
+            {
+                reqs[k] = blocks[k].write(replace_shared_bid(block_nos[k]));
+            }
+
+            wait_all(reqs.data(), block_nos.size());
+        }
+
+        LOG << "unshare_blocks(): done, " << sb->size() << " shared blocks remain globally";
+        m_shared = false;
+    }
+
+    //! \}
+
     //! \name Iterator Construction
     //! \{
 
@@ -1496,7 +1671,7 @@ public:
         if (!m_exported)
         {
             if (!m_from) {
-                m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+                delete_bids(m_bids.begin(), m_bids.end());
             }
             else // file must be truncated
             {
@@ -1545,6 +1720,19 @@ public:
         return m_from;
     }
 
+    //! Attach an I/O account counting the page reads and writes of the
+    //! vector, or detach it with nullptr.
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+    }
+
+    //! Get the attached I/O account, or nullptr.
+    io_account * get_io_account() const
+    {
+        return m_io_account;
+    }
+
     //! \}
 
     //! \name Capacity
@@ -1598,6 +1786,70 @@ private:
                 (offset.get_block2() * PageSize + offset.get_block1()));
     }
 
+    //! Deallocates the blocks [begin, end) that are not shared with other
+    //! vectors, and releases the shared ones.
+    void delete_bids(bids_container_iterator begin, bids_container_iterator end)
+    {
+        if (!m_shared) {
+            m_bm->delete_blocks(begin, end);
+            return;
+        }
+
+        shared_blocks* sb = shared_blocks::get_instance();
+        for ( ; begin != end; ++begin)
+        {
+            if (sb->release(*begin))
+                m_bm->delete_block(*begin);
+        }
+    }
+
+    //! Fills m_bids with the blocks of obj starting at block first_block and
+    //! registers them as shared. The cache of obj is flushed first.
+    void share_blocks(const vector& obj, size_t first_block)
+    {
+        obj.flush();
+
+        shared_blocks* sb = shared_blocks::get_instance();
+        for (size_t i = 0; i < m_bids.size(); ++i)
+        {
+            m_bids[i] = obj.m_bids[first_block + i];
+            sb->add_ref(m_bids[i]);
+        }
+
+        std::fill(m_page_status.begin(), m_page_status.end(), valid_on_disk);
+        m_shared = obj.m_shared = true;
+    }
+
+    //! Replaces the shared block block_no by a newly allocated one and
+    //! releases the shared block. The caller must write the block's content.
+    const bid_type& replace_shared_bid(size_t block_no)
+    {
+        const bid_type old_bid = m_bids[block_no];
+        m_bm->new_block(m_alloc_strategy, m_bids[block_no], block_no);
+
+        if (shared_blocks::get_instance()->release(old_bid))
+            m_bm->delete_block(old_bid);
+
+        return m_bids[block_no];
+    }
+
+    //! Called before a page turns dirty: replaces its shared blocks by new
+    //! ones. The page's content is in the cache and written on eviction.
+    void unshare_page(const size_t page_no)
+    {
+        if (!m_shared)
+            return;
+
+        shared_blocks* sb = shared_blocks::get_instance();
+        size_t block_no = page_no * page_size;
+        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
+        for ( ; block_no < last_block; ++block_no)
+        {
+            if (sb->is_shared(m_bids[block_no]))
+                replace_shared_bid(block_no);
+        }
+    }
+
     void read_page(const size_t& page_no, const size_t& cache_slot) const
     {
         assert(page_no < m_page_status.size());
@@ -1616,6 +1868,9 @@ private:
         }
 
         assert(last_block - page_no * page_size > 0);
+        if (m_io_account)
+            m_io_account->add_read(reqs.size(), reqs.size() * block_type::raw_size);
+        io_account::wait_timer wait(m_io_account);
         wait_all(reqs.data(), last_block - page_no * page_size);
     }
 
@@ -1642,6 +1897,9 @@ private:
         m_page_status[page_no] = valid_on_disk;
         assert(last_block - page_no * page_size > 0);
 
+        if (m_io_account)
+            m_io_account->add_write(reqs.size(), reqs.size() * block_type::raw_size);
+        io_account::wait_timer wait(m_io_account);
         wait_all(reqs.data(), last_block - page_no * page_size);
     }
 
@@ -1670,6 +1928,7 @@ private:
                 write_page(old_page_no, kicked_slot);
                 read_page(page_no, kicked_slot);
 
+                unshare_page(page_no);
                 m_page_status[page_no] = dirty;
 
                 return (*m_cache)[kicked_slot * page_size + offset.get_block1()][offset.get_offset()];
@@ -1684,6 +1943,7 @@ private:
 
                 read_page(page_no, free_slot);
 
+                unshare_page(page_no);
                 m_page_status[page_no] = dirty;
 
                 return (*m_cache)[free_slot * page_size + offset.get_block1()][offset.get_offset()];
@@ -1691,6 +1951,8 @@ private:
         }
         else
         {
+            if (m_page_status[page_no] != dirty)
+                unshare_page(page_no);
             m_page_status[page_no] = dirty;
             m_pager.hit(cache_slot);
             return (*m_cache)[cache_slot * page_size + offset.get_block1()][offset.get_offset()];
@@ -2316,6 +2578,14 @@ public:
  * this iterator advances in the vector and will \b enlarge the vector once it
  * reaches the end(). The vector size is doubled each time; nevertheless, it is
  * better to preinitialize the vector's size using stxxl::vector::resize().
+ * After the first growth, the blocks for the next one are allocated on a
+ * background thread once half of the new space has been written, such that
+ * growing does not wait for the block manager.
+ *
+ * Alternatively, the writer is given a range [begin,end) of the vector, which
+ * it does not write beyond. Writers of disjoint ranges may then be used
+ * concurrently by several threads, see
+ * vector_bufwriter(vector_iterator, vector_iterator, size_t).
  *
  * See \ref tutorial_vector_buf
  */
@@ -2332,9 +2602,15 @@ public:
     //! value type of the output vector
     using value_type = typename iterator::value_type;
 
+    //! size type of the output vector
+    using size_type = typename vector_type::size_type;
+
     //! block type used in the vector
     using block_type = typename iterator::block_type;
 
+    //! block identifier type of the vector
+    using bid_type = typename vector_type::bid_type;
+
     //! block identifier iterator of the vector
     using bids_container_iterator = typename iterator::bids_container_iterator;
 
@@ -2349,12 +2625,15 @@ protected:
     //! internal iterator into the vector.
     vector_iterator m_iter;
 
-    //! iterator to the current end of the vector.
+    //! iterator to the current end of the vector, or of the range.
     vector_const_iterator m_end;
 
     //! boolean whether the vector was grown, will shorten at finish().
     bool m_grown;
 
+    //! boolean whether the writer is restricted to a range of the vector.
+    bool m_ranged;
+
     //! iterator into vector of the last block accessed (used to issue updates
     //! when the block is switched).
     vector_const_iterator m_prevblk;
@@ -2365,6 +2644,15 @@ protected:
     //! number of blocks to use as buffers.
     size_t m_nbuffers;
 
+    //! position at which the blocks of the next growth are allocated.
+    vector_const_iterator m_alloc_at;
+
+    //! blocks of the next growth, allocated on a background thread.
+    std::future<std::vector<bid_type> > m_next_bids;
+
+    //! capacity of the vector the blocks in m_next_bids are appended to.
+    size_type m_next_bids_capacity;
+
 public:
     //! Create overlapped writer beginning at the given iterator.
     //! \param begin iterator to position were to start writing in vector
@@ -2374,8 +2662,11 @@ public:
         : m_iter(begin),
           m_end(m_iter.parent_vector()->end()),
           m_grown(false),
+          m_ranged(false),
           m_bufout(nullptr),
-          m_nbuffers(nbuffers)
+          m_nbuffers(nbuffers),
+          m_alloc_at(m_end),
+          m_next_bids_capacity(0)
     {
         if (m_nbuffers == 0)
             m_nbuffers = 2 * foxxll::config::get_instance()->disks_number();
@@ -2391,8 +2682,11 @@ public:
         : m_iter(vec.begin()),
           m_end(m_iter.parent_vector()->end()),
           m_grown(false),
+          m_ranged(false),
           m_bufout(nullptr),
-          m_nbuffers(nbuffers)
+          m_nbuffers(nbuffers),
+          m_alloc_at(m_end),
+          m_next_bids_capacity(0)
     {
         if (m_nbuffers == 0)
             m_nbuffers = 2 * foxxll::config::get_instance()->disks_number();
@@ -2400,6 +2694,56 @@ public:
         assert(m_iter <= m_end);
     }
 
+    /*!
+     * Create overlapped writer for the range [begin,end) of a vector. The
+     * writer does not grow the vector, writing beyond end throws.
+     *
+     * The constructor flushes the vector's cache and marks the range as
+     * written, after which the writer does not touch the vector's state.
+     * Hence writers of disjoint ranges may be used concurrently by several
+     * threads, if they are constructed and the vector is not accessed
+     * otherwise until all of them are finished. For this, begin must be at a
+     * block boundary, and end at a block boundary or the vector's end. Values
+     * of the range which are not written are undefined.
+     *
+     * \param begin iterator to position were to start writing in vector
+     * \param end iterator to the end of the range
+     * \param nbuffers number of buffers used for overlapped I/O (>= 2D recommended)
+     */
+    vector_bufwriter(vector_iterator begin, vector_iterator end,
+                     size_t nbuffers = 0)
+        : m_iter(begin),
+          m_end(end),
+          m_grown(false),
+          m_ranged(true),
+          m_bufout(nullptr),
+          m_nbuffers(nbuffers),
+          m_alloc_at(m_end),
+          m_next_bids_capacity(0)
+    {
+        if (m_nbuffers == 0)
+            m_nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+
+        const vector_type& v = *m_iter.parent_vector();
+        if (m_iter > m_end || m_end > v.cend())
+            throw foxxll::bad_parameter("vector_bufwriter: invalid range");
+        if (m_iter.block_offset() != 0 ||
+            (m_end.block_offset() != 0 && m_end != v.cend()))
+            throw foxxll::bad_parameter("vector_bufwriter: range is not block aligned");
+
+        if (m_iter == m_end)
+            return;
+
+        m_iter.flush();
+
+        // the pages are marked before writing, since marking them afterwards
+        // modifies the vector concurrently to the other writers
+        for (vector_const_iterator it = m_iter; it < m_end; it += block_type::size)
+            it.block_externally_updated();
+
+        m_bufout = new buf_ostream_type(m_iter.bid(), m_nbuffers);
+    }
+
     //! non-copyable: delete copy-constructor
     vector_bufwriter(const vector_bufwriter&) = delete;
     //! non-copyable: delete assignment operator
@@ -2417,6 +2761,11 @@ public:
     {
         if (TLX_UNLIKELY(m_iter == m_end))
         {
+            if (m_ranged) {
+                FOXXLL_THROW2(std::out_of_range, "vector_bufwriter",
+                              "writing beyond the end of the range");
+            }
+
             // iterator points to end of vector -> double vector's size
 
             if (m_bufout) {
@@ -2434,14 +2783,21 @@ public:
             }
 
             vector_type& v = *m_iter.parent_vector();
-            if (v.size() < 2 * block_type::size) {
-                v.resize(2 * block_type::size);
-            }
-            else {
-                v.resize(2 * v.size());
+            if (m_next_bids.valid())
+            {
+                // take the blocks allocated in the background
+                std::vector<bid_type> bids = m_next_bids.get();
+                if (v.capacity() == m_next_bids_capacity)
+                    v._reserve_bids(bids);
+                else
+                    foxxll::block_manager::get_instance()->delete_blocks(bids.begin(), bids.end());
             }
+            v.resize(grown_size(v.size()));
             m_end = v.end();
             m_grown = true;
+
+            // allocate the next growth once half of the new space is written
+            m_alloc_at = m_iter + (m_end - m_iter) / 2;
         }
 
         assert(m_iter < m_end);
@@ -2472,10 +2828,12 @@ public:
         // if the pointer has finished a block, then we inform the vector that
         // this block has been updated.
         if (TLX_UNLIKELY(m_iter.block_offset() == 0)) {
-            if (m_prevblk != m_iter) {
+            if (m_prevblk != m_iter && !m_ranged) {
                 m_prevblk.block_externally_updated();
                 m_prevblk = m_iter;
             }
+            if (TLX_UNLIKELY(m_alloc_at <= m_iter))
+                allocate_next_bids();
         }
 
         return m_bufout->operator * ();
@@ -2505,7 +2863,20 @@ public:
     //! Finish writing and flush output back to vector.
     void finish()
     {
-        if (m_bufout)
+        if (m_bufout && m_ranged)
+        {
+            // the rest of the block is not read from the vector, which would
+            // load pages into its cache
+            while (m_iter.block_offset() != 0)
+            {
+                m_bufout->operator * () = value_type();
+                operator ++ ();
+            }
+
+            delete m_bufout;
+            m_bufout = nullptr;
+        }
+        else if (m_bufout)
         {
             // must finish the block started in the buffered writer: fill it with
             // the data in the vector
@@ -2528,6 +2899,13 @@ public:
             m_bufout = nullptr;
         }
 
+        if (m_next_bids.valid())
+        {
+            // blocks allocated for a growth which did not happen
+            std::vector<bid_type> bids = m_next_bids.get();
+            foxxll::block_manager::get_instance()->delete_blocks(bids.begin(), bids.end());
+        }
+
         if (m_grown)
         {
             vector_type& v = *m_iter.parent_vector();
@@ -2536,6 +2914,216 @@ public:
             m_grown = false;
         }
     }
+
+protected:
+    //! size the vector is grown to when the writer reaches its end.
+    static size_type grown_size(size_type size)
+    {
+        return std::max<size_type>(2 * block_type::size, 2 * size);
+    }
+
+    //! starts allocating the blocks of the next growth in the background.
+    void allocate_next_bids()
+    {
+        const vector_type& v = *m_iter.parent_vector();
+        m_next_bids_capacity = v.capacity();
+        m_next_bids = v._allocate_bids_async(grown_size(v.size()));
+        m_alloc_at = m_end;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Asynchronous random reads from a vector, allowing a single thread to keep
+ * many block reads in flight.
+ *
+ * async_get() delivers the element to a callback. If the element's page is
+ * in the vector's page cache, the callback is called immediately. Otherwise
+ * the element's block is read into one of the reader's own buffers, and the
+ * callback is called by poll() or wait_all() once the read has completed.
+ * Requests for a block already in flight share its read. If all buffers are
+ * in flight, async_get() first completes the oldest read.
+ *
+ * Callbacks are only called from the thread calling the reader's methods and
+ * may issue further lookups. The vector must not be modified while the
+ * reader is in use.
+ */
+template <typename VectorType,
+          typename Callback = std::function<void(const typename VectorType::value_type&)> >
+class vector_async_reader
+{
+    static constexpr bool debug = false;
+
+public:
+    using vector_type = VectorType;
+    using value_type = typename vector_type::value_type;
+    using size_type = typename vector_type::size_type;
+    using block_type = typename vector_type::block_type;
+    using callback_type = Callback;
+
+protected:
+    //! a block read in flight and the lookups waiting for it
+    struct pending_read
+    {
+        size_t block_no;
+        foxxll::request_ptr req;
+        std::vector<std::pair<size_t, callback_type> > waiters;
+    };
+
+    //! the vector read from
+    const vector_type& m_vector;
+
+    //! buffers for blocks in flight
+    tlx::simple_vector<block_type> m_buffers;
+
+    //! the reads in flight by buffer index
+    tlx::simple_vector<pending_read> m_reads;
+
+    //! buffer indexes in flight, oldest first
+    std::deque<size_t> m_in_flight;
+
+    //! free buffer indexes
+    std::vector<size_t> m_free;
+
+public:
+    //! Create a reader keeping up to max_in_flight block reads in flight.
+    explicit vector_async_reader(const vector_type& vec,
+                                 size_t max_in_flight = 64)
+        : m_vector(vec),
+          m_buffers(max_in_flight),
+          m_reads(max_in_flight)
+    {
+        if (max_in_flight == 0)
+            throw foxxll::bad_parameter(
+                      "stxxl::vector_async_reader: max_in_flight must be positive");
+
+        for (size_t i = max_in_flight; i-- > 0; )
+            m_free.push_back(i);
+    }
+
+    //! non-copyable: delete copy-constructor
+    vector_async_reader(const vector_async_reader&) = delete;
+    //! non-copyable: delete assignment operator
+    vector_async_reader& operator = (const vector_async_reader&) = delete;
+
+    //! Completes all lookups in flight.
+    ~vector_async_reader()
+    {
+        wait_all();
+    }
+
+    //! Requests element index, cb(value) is called once it is available.
+    void async_get(size_type index, callback_type cb)
+    {
+        assert(index < m_vector.size());
+        using blocked_index_type = typename vector_type::blocked_index_type;
+        const blocked_index_type offset(index);
+        const size_t page_no = offset.get_block2();
+
+        if (m_vector.m_page_to_slot[page_no] >= 0)
+        {
+            // page is cached, no I/O needed
+            cb(m_vector.const_element(offset));
+            return;
+        }
+        if (m_vector.m_page_status[page_no] == vector_type::uninitialized)
+        {
+            cb(value_type());
+            return;
+        }
+
+        const size_t block_no = static_cast<size_t>(index / block_type::size);
+        const size_t block_offset = static_cast<size_t>(index % block_type::size);
+
+        for (const size_t& i : m_in_flight)
+        {
+            if (m_reads[i].block_no == block_no)
+            {
+                m_reads[i].waiters.emplace_back(block_offset, std::move(cb));
+                return;
+            }
+        }
+
+        while (m_free.empty())
+            complete(m_in_flight.front());
+
+        const size_t i = m_free.back();
+        m_free.pop_back();
+
+        LOG << "vector_async_reader: reading block " << block_no << " into buffer " << i;
+
+        pending_read& read = m_reads[i];
+        read.block_no = block_no;
+        read.req = m_buffers[i].read(m_vector.m_bids[block_no]);
+        read.waiters.emplace_back(block_offset, std::move(cb));
+        m_in_flight.push_back(i);
+
+        if (m_vector.m_io_account)
+            m_vector.m_io_account->add_read(1, block_type::raw_size);
+    }
+
+    //! Calls the callbacks of all completed reads without waiting.
+    //! \return number of callbacks called
+    size_t poll()
+    {
+        size_t done = 0;
+        for (size_t k = 0; k < m_in_flight.size(); )
+        {
+            const size_t i = m_in_flight[k];
+            if (m_reads[i].req->poll())
+                done += complete(i);
+            else
+                ++k;
+        }
+        return done;
+    }
+
+    //! Waits for all reads in flight and calls their callbacks.
+    //! \return number of callbacks called
+    size_t wait_all()
+    {
+        size_t done = 0;
+        while (!m_in_flight.empty())
+            done += complete(m_in_flight.front());
+        return done;
+    }
+
+    //! Number of block reads in flight.
+    size_t in_flight() const
+    {
+        return m_in_flight.size();
+    }
+
+protected:
+    //! waits for the read into buffer i, calls its callbacks and frees it
+    size_t complete(size_t i)
+    {
+        pending_read& read = m_reads[i];
+        {
+            io_account::wait_timer wait(m_vector.m_io_account);
+            read.req->wait();
+        }
+        read.req = foxxll::request_ptr();
+
+        m_in_flight.erase(std::find(m_in_flight.begin(), m_in_flight.end(), i));
+
+        // the elements are copied and the buffer is freed before the
+        // callbacks are called, as callbacks may issue further lookups which
+        // need a buffer
+        std::vector<std::pair<size_t, callback_type> > waiters;
+        std::swap(waiters, read.waiters);
+        std::vector<value_type> values;
+        values.reserve(waiters.size());
+        for (const auto& w : waiters)
+            values.push_back(m_buffers[i][w.first]);
+        m_free.push_back(i);
+
+        for (size_t k = 0; k < waiters.size(); ++k)
+            waiters[k].second(values[k]);
+
+        return waiters.size();
+    }
 };
 
 //! \}
@@ -239,15 +239,50 @@ stxxl::vector_iterator<VectorConfig> materialize(
 //! Reads stream content and discards it.
 //! Useful where you do not need the processed stream anymore,
 //! but are just interested in side effects, or just for debugging.
+//! The elements are not dereferenced.
 //! \param in input stream
 template <typename StreamAlgorithm>
 void discard(StreamAlgorithm& in)
 {
     while (!in.empty())
-    {
-        *in;
         ++in;
-    }
+}
+
+/*! \internal
+ */
+namespace skip_local {
+
+//! streams providing a skip() method, e.g. vector_iterator2stream
+template <typename StreamAlgorithm>
+auto skip(StreamAlgorithm& in, size_t n, int)->decltype(in.skip(n))
+{
+    return in.skip(n);
+}
+
+//! all other streams are advanced element-wise
+template <typename StreamAlgorithm>
+size_t skip(StreamAlgorithm& in, size_t n, long)
+{
+    size_t i = 0;
+    for ( ; i < n && !in.empty(); ++i)
+        ++in;
+    return i;
+}
+
+} // namespace skip_local
+
+//! Skips the next n elements of a stream, or all remaining ones. The
+//! elements are not dereferenced. Streams reading an \c stxxl::vector
+//! (vector_iterator2stream, vector_iterator2stream_sr) do not read the
+//! blocks skipped over, hence reading a small part of a large vector costs
+//! I/O only for the part returned.
+//! \param in input stream
+//! \param n number of elements to skip
+//! \return number of elements skipped, less than n if the stream ran empty
+template <typename StreamAlgorithm>
+size_t skip(StreamAlgorithm& in, size_t n)
+{
+    return skip_local::skip(in, n, 0);
 }
 
 //! \}
@@ -0,0 +1,285 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/multiway_merge.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_MULTIWAY_MERGE_HEADER
+#define STXXL_STREAM_MULTIWAY_MERGE_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tlx/container/loser_tree.hpp>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     MULTIWAY MERGE                                                 //
+////////////////////////////////////////////////////////////////////////
+
+//! Inputs of a multiway_merge given as a std::vector of streams of the same
+//! type, the number of streams is determined at runtime.
+template <class Input>
+class vector_merge_inputs
+{
+    std::vector<Input>& m_inputs;
+
+public:
+    using value_type = typename Input::value_type;
+
+    explicit vector_merge_inputs(std::vector<Input>& inputs)
+        : m_inputs(inputs) { }
+
+    size_t size() const { return m_inputs.size(); }
+
+    bool empty(size_t i) const { return m_inputs[i].empty(); }
+
+    value_type deref(size_t i) const { return *m_inputs[i]; }
+
+    void advance(size_t i) { ++m_inputs[i]; }
+};
+
+//! Inputs of a multiway_merge given as streams of possibly different types
+//! with a common value_type, the number of streams is fixed at compile time.
+template <class... Inputs>
+class tuple_merge_inputs
+{
+public:
+    using value_type =
+        typename std::tuple_element<0, std::tuple<Inputs...> >::type::value_type;
+
+private:
+    using tuple_type = std::tuple<Inputs&...>;
+    using index_sequence = std::index_sequence_for<Inputs...>;
+
+    tuple_type m_inputs;
+
+    // dispatch a runtime index to the stream of the tuple via a table of
+    // function pointers
+
+    template <size_t I>
+    static bool empty_one(const tuple_type& t)
+    {
+        return std::get<I>(t).empty();
+    }
+
+    template <size_t I>
+    static value_type deref_one(const tuple_type& t)
+    {
+        return *std::get<I>(t);
+    }
+
+    template <size_t I>
+    static void advance_one(tuple_type& t)
+    {
+        ++std::get<I>(t);
+    }
+
+    template <size_t... Is>
+    static bool empty_dispatch(const tuple_type& t, size_t i,
+                               std::index_sequence<Is...>)
+    {
+        using fn_type = bool (*)(const tuple_type&);
+        static const fn_type table[] = { &empty_one<Is>... };
+        return table[i](t);
+    }
+
+    template <size_t... Is>
+    static value_type deref_dispatch(const tuple_type& t, size_t i,
+                                     std::index_sequence<Is...>)
+    {
+        using fn_type = value_type (*)(const tuple_type&);
+        static const fn_type table[] = { &deref_one<Is>... };
+        return table[i](t);
+    }
+
+    template <size_t... Is>
+    static void advance_dispatch(tuple_type& t, size_t i,
+                                 std::index_sequence<Is...>)
+    {
+        using fn_type = void (*)(tuple_type&);
+        static const fn_type table[] = { &advance_one<Is>... };
+        table[i](t);
+    }
+
+public:
+    explicit tuple_merge_inputs(Inputs&... inputs)
+        : m_inputs(inputs...) { }
+
+    size_t size() const { return sizeof ... (Inputs); }
+
+    bool empty(size_t i) const
+    {
+        return empty_dispatch(m_inputs, i, index_sequence());
+    }
+
+    value_type deref(size_t i) const
+    {
+        return deref_dispatch(m_inputs, i, index_sequence());
+    }
+
+    void advance(size_t i)
+    {
+        advance_dispatch(m_inputs, i, index_sequence());
+    }
+};
+
+/*!
+ * Merges several streams sorted with respect to Cmp into one sorted stream.
+ *
+ * The streams are merged lazily with a loser tree directly from the inputs,
+ * without writing them to disk as runs first. Each input is read only
+ * through its own stream, which provides the read buffer, e.g. a
+ * vector_iterator2stream with overlapped prefetching. The merge is stable:
+ * equal elements are delivered in the order of their inputs.
+ *
+ * For convenience use the stream::merge() functions instead of direct
+ * instantiation.
+ *
+ * \tparam Inputs vector_merge_inputs or tuple_merge_inputs
+ * \tparam Cmp comparison object of \ref StrictWeakOrdering
+ */
+template <class Inputs, class Cmp>
+class multiway_merge
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Inputs::value_type;
+
+private:
+    using loser_tree_type = tlx::LoserTreeCopy<true, value_type, Cmp>;
+    using source_type = typename loser_tree_type::Source;
+
+    Inputs m_inputs;
+    //! loser tree over the current elements of the inputs
+    loser_tree_type m_tree;
+    //! number of non-empty inputs
+    size_t m_remaining;
+    //! input holding the current element
+    size_t m_current;
+    //! copy of the current element, as inputs may return temporaries
+    value_type m_value;
+
+public:
+    multiway_merge(const Inputs& inputs, Cmp cmp = Cmp())
+        : m_inputs(inputs),
+          m_tree(static_cast<source_type>(inputs.size()), cmp),
+          m_remaining(0), m_current(0)
+    {
+        // the first insert initializes all keys, hence insert the non-empty
+        // inputs first
+        for (size_t i = 0; i < m_inputs.size(); ++i)
+        {
+            if (m_inputs.empty(i))
+                continue;
+            m_value = m_inputs.deref(i);
+            m_tree.insert_start(&m_value, static_cast<source_type>(i), false);
+            ++m_remaining;
+        }
+
+        if (m_remaining == 0)
+            return;
+
+        for (size_t i = 0; i < m_inputs.size(); ++i)
+        {
+            if (m_inputs.empty(i))
+                m_tree.insert_start(nullptr, static_cast<source_type>(i), true);
+        }
+
+        m_tree.init();
+        m_current = m_tree.min_source();
+        m_value = m_inputs.deref(m_current);
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_value;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    multiway_merge& operator ++ ()
+    {
+        assert(!empty());
+        m_inputs.advance(m_current);
+
+        if (m_inputs.empty(m_current))
+        {
+            m_tree.delete_min_insert(nullptr, true);
+            if (--m_remaining == 0)
+                return *this;
+        }
+        else
+        {
+            m_value = m_inputs.deref(m_current);
+            m_tree.delete_min_insert(&m_value, false);
+        }
+
+        const size_t next = m_tree.min_source();
+        if (next != m_current)
+        {
+            m_current = next;
+            m_value = m_inputs.deref(m_current);
+        }
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_remaining == 0;
+    }
+};
+
+//! Merges the given sorted streams, which may be of different types with a
+//! common value_type, see multiway_merge.
+//! \tparam Cmp comparison object of \ref StrictWeakOrdering
+//! \param inputs sorted streams, referenced by the merger
+template <class Cmp, class... Inputs>
+multiway_merge<tuple_merge_inputs<Inputs...>, Cmp>
+merge(Inputs&... inputs)
+{
+    static_assert(sizeof ... (Inputs) > 0, "merge() requires at least one input");
+    return multiway_merge<tuple_merge_inputs<Inputs...>, Cmp>(
+        tuple_merge_inputs<Inputs...>(inputs...));
+}
+
+//! Merges a runtime-sized vector of sorted streams, see multiway_merge.
+//! \tparam Cmp comparison object of \ref StrictWeakOrdering
+//! \param inputs sorted streams, the vector is referenced by the merger
+//! \param cmp comparison object
+template <class Cmp, class Input>
+multiway_merge<vector_merge_inputs<Input>, Cmp>
+merge(std::vector<Input>& inputs, Cmp cmp = Cmp())
+{
+    return multiway_merge<vector_merge_inputs<Input>, Cmp>(
+        vector_merge_inputs<Input>(inputs), cmp);
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_MULTIWAY_MERGE_HEADER
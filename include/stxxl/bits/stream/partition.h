@@ -0,0 +1,160 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/partition.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_PARTITION_HEADER
+#define STXXL_STREAM_PARTITION_HEADER
+
+#include <cassert>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/buffered_writer.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/parallel.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     PARTITION                                                      //
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Distributes the elements of a stream into k external buckets.
+ *
+ * Each element x is appended to the bucket \c classifier(x), which must be
+ * less than k = <tt>buckets.size()</tt>. The buckets keep the order of the
+ * input. Every bucket is filled block by block in its own buffer block, and
+ * full blocks are written through a single foxxll::buffered_writer pool,
+ * hence about <tt>k + nwrite_buffers + 1</tt> blocks of memory are used. The
+ * blocks become the contents of the bucket vectors, which can afterwards be
+ * read e.g. with streamify().
+ *
+ * The input is read in batches of one block, and if parallelism is enabled,
+ * the elements of a batch are classified concurrently. Hence the classifier
+ * must be safe to call from several threads.
+ *
+ * This is the distribution step of hash partitioned joins and distribution
+ * sorts.
+ *
+ * \param input input stream
+ * \param classifier function object mapping a value to its bucket number
+ * \param buckets \c stxxl::vector objects receiving the buckets, their
+ *        previous contents are discarded
+ * \param nwrite_buffers number of write buffers (blocks) shared by the
+ *        buckets, 0 for 2*D
+ */
+template <typename Input, typename Classifier, typename VectorType>
+void partition(Input& input, Classifier classifier,
+               std::vector<VectorType>& buckets, size_t nwrite_buffers = 0)
+{
+    constexpr bool debug = false;
+
+    using value_type = typename Input::value_type;
+    using block_type = typename VectorType::block_type;
+    using bid_type = typename VectorType::bid_type;
+    using alloc_strategy_type = typename VectorType::alloc_strategy_type;
+    using size_type = typename VectorType::size_type;
+
+    const size_t k = buckets.size();
+    if (k == 0)
+        throw foxxll::bad_parameter("stream::partition(): at least one bucket is required");
+
+    if (nwrite_buffers == 0)
+        nwrite_buffers = 2 * foxxll::config::get_instance()->disks_number();
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    foxxll::buffered_writer<block_type> writer(k + nwrite_buffers, nwrite_buffers);
+
+    // current buffer block, its fill and the written blocks of each bucket
+    std::vector<block_type*> blocks(k);
+    std::vector<size_t> fill(k, 0);
+    std::vector<std::vector<bid_type> > bids(k);
+
+    for (size_t b = 0; b < k; ++b)
+        blocks[b] = writer.get_free_block();
+
+    alloc_strategy_type alloc;
+
+    // allocates the next block of bucket b and hands its buffer to the
+    // writer, the block's index within the bucket is the allocation offset
+    // such that each bucket is striped over the disks like a vector
+    auto write_block = [&](size_t b) {
+                           bids[b].emplace_back();
+                           bm->new_block(alloc, bids[b].back(), bids[b].size() - 1);
+                           blocks[b] = writer.write(blocks[b], bids[b].back());
+                       };
+
+    std::vector<value_type> batch;
+    std::vector<size_t> batch_bucket(block_type::size);
+    batch.reserve(block_type::size);
+
+    while (!input.empty())
+    {
+        batch.clear();
+        for ( ; batch.size() < block_type::size && !input.empty(); ++input)
+            batch.push_back(*input);
+
+        const long nbatch = static_cast<long>(batch.size());
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+        for (long j = 0; j < nbatch; ++j)
+            batch_bucket[j] = classifier(batch[j]);
+
+        for (long j = 0; j < nbatch; ++j)
+        {
+            const size_t b = batch_bucket[j];
+            assert(b < k);
+
+            blocks[b]->elem[fill[b]] = batch[j];
+            if (++fill[b] == block_type::size)
+            {
+                write_block(b);
+                fill[b] = 0;
+            }
+        }
+    }
+
+    std::vector<size_type> sizes(k);
+    for (size_t b = 0; b < k; ++b)
+    {
+        sizes[b] = static_cast<size_type>(bids[b].size()) * block_type::size + fill[b];
+        if (fill[b] != 0)
+            write_block(b);
+
+        LOG << "partition(): bucket " << b << " has " << sizes[b] << " elements";
+    }
+
+    writer.flush();
+
+    for (size_t b = 0; b < k; ++b)
+    {
+        buckets[b].clear();
+        buckets[b].set_content(bids[b].begin(), bids[b].end(), sizes[b]);
+    }
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_PARTITION_HEADER
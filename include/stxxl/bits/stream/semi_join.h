@@ -0,0 +1,106 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/semi_join.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_SEMI_JOIN_HEADER
+#define STXXL_STREAM_SEMI_JOIN_HEADER
+
+#include <cassert>
+
+#include <stxxl/bits/common/bloom_filter.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     BLOOM FILTER SEMI JOIN                                         //
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Approximate semi-join of a large stream with a small key set.
+ *
+ * Passes on the elements of the input whose key, as extracted by
+ * KeyExtractor, may be contained in a Bloom filter built from the keys of
+ * the small side, e.g. a stxxl::blocked_bloom_filter filled by its
+ * insert_stream() method from a sorter or from the keys of an
+ * unordered_map. All elements with a partner pass, and only a small fraction
+ * of the others (the false positive rate of the filter), hence placing the
+ * operator before a sort shrinks the volume sorted and merged to roughly the
+ * matching fraction. The exact join must still be done downstream.
+ *
+ * \tparam Input type of the input stream
+ * \tparam KeyExtractor function object returning the key of an element
+ * \tparam Filter Bloom filter type with a contains(key) method
+ */
+template <class Input, class KeyExtractor, class Filter>
+class bloom_filter_semi_join
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    Input& m_input;
+    KeyExtractor m_key_extractor;
+    const Filter& m_filter;
+
+    //! skip to the next element which may have a partner
+    void skip()
+    {
+        while (!m_input.empty() && !m_filter.contains(m_key_extractor(*m_input)))
+            ++m_input;
+    }
+
+public:
+    bloom_filter_semi_join(Input& input, const Filter& filter,
+                           KeyExtractor key_extractor = KeyExtractor())
+        : m_input(input), m_key_extractor(key_extractor), m_filter(filter)
+    {
+        skip();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return *m_input;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    bloom_filter_semi_join& operator ++ ()
+    {
+        ++m_input;
+        skip();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_input.empty();
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_SEMI_JOIN_HEADER
@@ -0,0 +1,318 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/set_operations.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_SET_OPERATIONS_HEADER
+#define STXXL_STREAM_SET_OPERATIONS_HEADER
+
+#include <cassert>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     TWO WAY MERGE                                                  //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::merge algorithm.
+//!
+//! Merges two streams sorted with respect to Cmp. Equal elements of the first
+//! stream precede those of the second, i.e. the merge is stable.
+template <class Input1, class Input2, class Cmp>
+class two_way_merge
+{
+    Input1& in1;
+    Input2& in2;
+    Cmp cmp;
+    //! whether the current element is taken from the second input
+    bool from_second;
+
+    void select()
+    {
+        from_second = in1.empty() || (!in2.empty() && cmp(*in2, *in1));
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    two_way_merge(Input1& in1_, Input2& in2_, Cmp cmp_ = Cmp())
+        : in1(in1_), in2(in2_), cmp(cmp_)
+    {
+        select();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return from_second ? *in2 : *in1;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    two_way_merge& operator ++ ()
+    {
+        if (from_second)
+            ++in2;
+        else
+            ++in1;
+        select();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return in1.empty() && in2.empty();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET UNION                                                      //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::set_union algorithm.
+//!
+//! Outputs the elements of two sorted streams. An element occurring m times
+//! in the first and n times in the second stream is output max(m, n) times,
+//! the first m of them from the first stream.
+template <class Input1, class Input2, class Cmp>
+class set_union
+{
+    Input1& in1;
+    Input2& in2;
+    Cmp cmp;
+    //! the current element is taken from the first and/or the second input
+    bool take1, take2;
+
+    void select()
+    {
+        if (in1.empty() || in2.empty()) {
+            take1 = !in1.empty();
+            take2 = !in2.empty();
+        }
+        else {
+            take1 = !cmp(*in2, *in1);
+            take2 = !cmp(*in1, *in2);
+        }
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    set_union(Input1& in1_, Input2& in2_, Cmp cmp_ = Cmp())
+        : in1(in1_), in2(in2_), cmp(cmp_)
+    {
+        select();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return take1 ? *in1 : *in2;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    set_union& operator ++ ()
+    {
+        if (take1) ++in1;
+        if (take2) ++in2;
+        select();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return in1.empty() && in2.empty();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET INTERSECTION                                               //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::set_intersection algorithm.
+//!
+//! Outputs the elements of the first sorted stream that also occur in the
+//! second. An element occurring m times in the first and n times in the
+//! second stream is output min(m, n) times.
+template <class Input1, class Input2, class Cmp>
+class set_intersection
+{
+    Input1& in1;
+    Input2& in2;
+    Cmp cmp;
+
+    //! skip to the next element present in both inputs
+    void skip()
+    {
+        while (!in1.empty() && !in2.empty())
+        {
+            if (cmp(*in1, *in2))
+                ++in1;
+            else if (cmp(*in2, *in1))
+                ++in2;
+            else
+                return;
+        }
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    set_intersection(Input1& in1_, Input2& in2_, Cmp cmp_ = Cmp())
+        : in1(in1_), in2(in2_), cmp(cmp_)
+    {
+        skip();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return *in1;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    set_intersection& operator ++ ()
+    {
+        ++in1;
+        ++in2;
+        skip();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return in1.empty() || in2.empty();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET DIFFERENCE                                                 //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::set_difference algorithm.
+//!
+//! Outputs the elements of the first sorted stream that do not occur in the
+//! second. An element occurring m times in the first and n times in the
+//! second stream is output max(m - n, 0) times.
+template <class Input1, class Input2, class Cmp>
+class set_difference
+{
+    Input1& in1;
+    Input2& in2;
+    Cmp cmp;
+
+    //! skip to the next element of the first input absent in the second
+    void skip()
+    {
+        while (!in1.empty() && !in2.empty())
+        {
+            if (cmp(*in1, *in2))
+                return;
+
+            if (!cmp(*in2, *in1))
+                ++in1;
+            ++in2;
+        }
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    set_difference(Input1& in1_, Input2& in2_, Cmp cmp_ = Cmp())
+        : in1(in1_), in2(in2_), cmp(cmp_)
+    {
+        skip();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return *in1;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    set_difference& operator ++ ()
+    {
+        ++in1;
+        skip();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return in1.empty();
+    }
+};
+
+//! Equivalent to std::includes algorithm.
+//!
+//! Consumes two sorted streams until the result is known.
+//! \return true if every element of the second stream occurs in the first,
+//! counting multiplicities
+template <class Input1, class Input2, class Cmp>
+bool includes(Input1& in1, Input2& in2, Cmp cmp)
+{
+    while (!in2.empty())
+    {
+        if (in1.empty() || cmp(*in2, *in1))
+            return false;
+
+        if (!cmp(*in1, *in2))
+            ++in2;
+        ++in1;
+    }
+    return true;
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_SET_OPERATIONS_HEADER
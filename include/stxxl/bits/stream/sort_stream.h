@@ -33,6 +33,9 @@
 #include <stxxl/bits/algo/sort_base.h>
 #include <stxxl/bits/algo/sort_helper.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/huge_page_arena.h>
+#include <stxxl/bits/common/io_account.h>
+#include <stxxl/bits/common/settings.h>
 #include <stxxl/bits/config.h>
 #include <stxxl/bits/parallel.h>
 #include <stxxl/bits/stream/sorted_runs.h>
@@ -192,10 +195,13 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
     const size_t el_in_run = m2 * block_type::size;     // # el in a run
     LOG << "basic_runs_creator::compute_result m2=" << m2;
     size_t blocks1_length = 0, blocks2_length = 0;
+    // both run buffers, returned to the arena on all paths
+    huge_page_array<block_type> blocks;
     block_type* Blocks1 = nullptr;
 
 #ifndef STXXL_SMALL_INPUT_PSORT_OPT
-    Blocks1 = new block_type[m2 * 2];
+    blocks.allocate(m2 * 2);
+    Blocks1 = blocks.data();
 #else
     // push input element into small_run vector in result until it is full
     while (!input.empty() && blocks1_length != block_type::size)
@@ -207,7 +213,8 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
 
     if (blocks1_length == block_type::size && !input.empty())
     {
-        Blocks1 = new block_type[m2 * 2];
+        blocks.allocate(m2 * 2);
+        Blocks1 = blocks.data();
         std::copy(m_result->small_run.begin(), m_result->small_run.end(),
                   Blocks1[0].begin());
         m_result->small_run.clear();
@@ -235,7 +242,6 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         assert(m_result->small_run.empty());
         m_result->small_run.assign(Blocks1[0].begin(), Blocks1[0].begin() + blocks1_length);
         m_result->elements = blocks1_length;
-        delete[] Blocks1;
         return;
     }
 
@@ -267,7 +273,6 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         // return
         wait_all(write_reqs, write_reqs + cur_run_size);
         delete[] write_reqs;
-        delete[] Blocks1;
         return;
     }
 
@@ -316,8 +321,6 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         wait_all(write_reqs1, write_reqs1 + cur_run_size - m2);
         delete[] write_reqs1;
 
-        delete[] Blocks1;
-
         return;
     }
 
@@ -364,7 +367,6 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
 
     wait_all(write_reqs, write_reqs + m2);
     delete[] write_reqs;
-    delete[] ((Blocks1 < Blocks2) ? Blocks1 : Blocks2);
 }
 
 //! Forms sorted runs of data from a stream.
@@ -485,6 +487,9 @@ private:
     //! accumulation buffer that is currently being written to disk
     block_type* m_blocks2;
 
+    //! memory of both accumulation buffers, taken from the huge page arena
+    huge_page_array<block_type> m_buffer;
+
     //! reference to write requests transporting the last accumulation buffer
     //! to disk
     request_ptr* m_write_reqs;
@@ -492,6 +497,9 @@ private:
     //! run object containing block ids of the run being written to disk
     run_type run;
 
+    //! account counting the written runs, or nullptr
+    io_account* m_io_account = nullptr;
+
 protected:
     //!  fill the rest of the block with max values
     void fill_with_max_value(block_type* blocks, size_t num_blocks,
@@ -543,6 +551,10 @@ protected:
         // fill the rest of the last block with max values
         fill_with_max_value(m_blocks1, cur_run_size, m_cur_el);
 
+        if (m_io_account)
+            m_io_account->add_write(cur_run_size, cur_run_size * block_type::raw_size);
+
+        io_account::wait_timer wait(m_io_account);
         size_t i = 0;
         for ( ; i < cur_run_size; ++i)
         {
@@ -620,7 +632,8 @@ public:
     {
         if (!m_blocks1)
         {
-            m_blocks1 = new block_type[m_m2 * 2];
+            m_buffer.allocate(m_m2 * 2);
+            m_blocks1 = m_buffer.data();
             m_blocks2 = m_blocks1 + m_m2;
 
             m_write_reqs = new request_ptr[m_m2];
@@ -636,7 +649,7 @@ public:
 
         if (m_blocks1)
         {
-            delete[] ((m_blocks1 < m_blocks2) ? m_blocks1 : m_blocks2);
+            m_buffer.deallocate();
             m_blocks1 = m_blocks2 = nullptr;
 
             delete[] m_write_reqs;
@@ -669,13 +682,19 @@ public:
 
         foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
 
-        for (size_t i = 0; i < cur_run_blocks; ++i)
+        if (m_io_account)
+            m_io_account->add_write(cur_run_blocks, cur_run_blocks * block_type::raw_size);
+
         {
-            run[i].value = m_blocks1[i][0];
-            if (m_write_reqs[i].get())
-                m_write_reqs[i]->wait();
+            io_account::wait_timer wait(m_io_account);
+            for (size_t i = 0; i < cur_run_blocks; ++i)
+            {
+                run[i].value = m_blocks1[i][0];
+                if (m_write_reqs[i].get())
+                    m_write_reqs[i]->wait();
 
-            m_write_reqs[i] = m_blocks1[i].write(run[i].bid);
+                m_write_reqs[i] = m_blocks1[i].write(run[i].bid);
+            }
         }
 
         m_result->add_run(run, m_el_in_run);
@@ -707,6 +726,12 @@ public:
         return m_result->elements + m_cur_el;
     }
 
+    //! Sets the account counting the written runs, or nullptr.
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+    }
+
     //! return comparator object.
     const cmp_type & cmp() const
     {
@@ -1024,6 +1049,18 @@ private:
     //! prefetcher object
     prefetcher_type* m_prefetcher;
 
+    //! number of blocks at the front of m_consume_seq handed to a recycler
+    size_t m_recycled;
+
+    //! number of blocks of m_consume_seq read when the prefetcher was released
+    size_t m_consumed_at_release = 0;
+
+    //! number of blocks the prefetcher reads ahead
+    size_t m_prefetch_blocks = 0;
+
+    //! account counting the blocks read, or nullptr
+    io_account* m_io_account = nullptr;
+
     //! loser tree used for native merging
     loser_tree_type* m_losers;
 
@@ -1046,6 +1083,21 @@ private:
     {
         if (m_prefetcher)
         {
+            // the prefetcher is released before the merger is empty, keep
+            // its position for recycle_consumed_blocks()
+            m_consumed_at_release = m_prefetcher->pos();
+
+            if (m_io_account)
+            {
+                // blocks beyond the consumed ones were at most read ahead
+                const size_t consumed = m_consumed_at_release;
+                const size_t wasted = std::min(
+                    m_consume_seq.size() - consumed, m_prefetch_blocks);
+                m_io_account->add_prefetch(consumed + wasted);
+                m_io_account->add_read(
+                    consumed + wasted, (consumed + wasted) * block_type::raw_size);
+                m_io_account->add_wasted(wasted);
+            }
             delete m_losers;
 #if STXXL_PARALLEL_MULTIWAY_MERGE
             delete seqs;
@@ -1146,6 +1198,7 @@ public:
           m_buffer_block(new out_block_type),
           m_prefetch_seq(nullptr),
           m_prefetcher(nullptr),
+          m_recycled(0),
           m_losers(nullptr)
 #if STXXL_PARALLEL_MULTIWAY_MERGE
           , seqs(nullptr),
@@ -1170,6 +1223,13 @@ public:
         m_memory_to_use = memory_to_use;
     }
 
+    //! Sets the account counting the blocks read, or nullptr. The blocks
+    //! are counted when the prefetcher is released.
+    void set_io_account(io_account* account)
+    {
+        m_io_account = account;
+    }
+
     //! Initialize the runs merger object with a new round of sorted_runs.
     void initialize(const sorted_runs_type& sruns)
     {
@@ -1276,11 +1336,14 @@ public:
             m_prefetch_seq[i] = i;
 #endif //STXXL_SORT_OPTIMAL_PREFETCHING
 
+        m_prefetch_blocks = std::min(nruns + n_prefetch_buffers, prefetch_seq_size);
         m_prefetcher = new prefetcher_type(
             m_consume_seq.begin(),
             m_consume_seq.end(),
             m_prefetch_seq,
-            std::min(nruns + n_prefetch_buffers, prefetch_seq_size));
+            m_prefetch_blocks);
+        m_recycled = 0;
+        m_consumed_at_release = 0;
 
         if (do_parallel_merge())
         {
@@ -1316,6 +1379,29 @@ public:
         m_sruns = nullptr;         // release reference on result object
     }
 
+    //! Hands the blocks of the input runs which were already read by the
+    //! prefetcher to \c recycler, which takes over their ownership. Once the
+    //! merger is empty, all blocks have been read and are handed over, and
+    //! the sorted runs object no longer deallocates them.
+    template <typename BidRecycler>
+    void recycle_consumed_blocks(BidRecycler& recycler)
+    {
+        if (!m_sruns.valid())
+            return;
+
+        const size_t consumed =
+            m_prefetcher ? m_prefetcher->pos() : m_consumed_at_release;
+        recycler.push(m_consume_seq.begin() + m_recycled,
+                      m_consume_seq.begin() + consumed);
+        m_recycled = consumed;
+
+        if (empty())
+        {
+            assert(m_recycled == m_consume_seq.size());
+            m_sruns->runs.clear();
+        }
+    }
+
 public:
     //! Standard stream method.
     bool empty() const
@@ -1387,6 +1473,10 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
     size_t ndisks = foxxll::config::get_instance()->disks_number();
     size_t nwrite_buffers = 2 * ndisks;
+
+    // pool of consumed input blocks, used only if recycle_merge_blocks is set
+    sort_helper::bid_recycler<typename block_type::bid_type, alloc_strategy> recycler;
+    const bool recycle = SETTINGS::recycle_merge_blocks;
     size_t memory_for_write_buffers = nwrite_buffers * sizeof(block_type);
 
     // memory consumption of the recursive merger (uses block_type as
@@ -1444,9 +1534,11 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
                 const size_t blocks_in_new_run = static_cast<size_t>(foxxll::div_ceil(
                                                                          elements_in_new_run, block_type::size));
 
-                // allocate blocks for the new runs
+                // allocate blocks for the new runs, if recycling they are
+                // assigned while merging
                 new_runs.runs[cur_out_run].resize(blocks_in_new_run);
-                bm->new_blocks(alloc_strategy(), make_bid_iterator(new_runs.runs[cur_out_run].begin()), make_bid_iterator(new_runs.runs[cur_out_run].end()));
+                if (!recycle)
+                    bm->new_blocks(alloc_strategy(), make_bid_iterator(new_runs.runs[cur_out_run].begin()), make_bid_iterator(new_runs.runs[cur_out_run].end()));
 
                 // Construct temporary sorted_runs object as input into recursive merger.
                 // This sorted_runs is copied a subset of the over-large set of runs, which
@@ -1484,12 +1576,26 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
                     {
                         *out = *merger;
                         if ((cnt % block_type::size) == 0)     // have to write the trigger value
-                            new_runs.runs[cur_out_run][static_cast<size_t>(cnt / size_type(block_type::size))].value = *merger;
+                        {
+                            trigger_entry_type& te = new_runs.runs[cur_out_run][static_cast<size_t>(cnt / size_type(block_type::size))];
+                            te.value = *merger;
+
+                            // buf_ostream dereferences the BID only once the
+                            // block is full, so it can be assigned here
+                            if (recycle)
+                            {
+                                merger.recycle_consumed_blocks(recycler);
+                                recycler.pop(te.bid);
+                            }
+                        }
 
                         ++cnt, ++out, ++merger;
                     }
                     assert(merger.empty());
 
+                    if (recycle)
+                        merger.recycle_consumed_blocks(recycler);
+
                     while (cnt % block_type::size)
                     {
                         *out = m_cmp.max_value();
@@ -1525,6 +1631,8 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
         std::swap(nruns, new_nruns);
         m_sruns->swap(new_runs);
     }
+
+    LOG << "Blocks left in recycler: " << recycler.size();
 }
 
 //! Merges sorted runs.
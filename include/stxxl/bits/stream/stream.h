@@ -16,8 +16,12 @@
 #ifndef STXXL_STREAM_STREAM_HEADER
 #define STXXL_STREAM_STREAM_HEADER
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/meta/apply_tuple.hpp>
@@ -26,7 +30,9 @@
 #include <tlx/meta/call_foreach_tuple.hpp>
 
 #include <foxxll/common/error_handling.hpp>
+#include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_istream_reverse.hpp>
 #include <foxxll/mng/buf_ostream.hpp>
 
 #include <stxxl/vector>
@@ -120,12 +126,28 @@ class vector_iterator2stream
 
     using buf_istream_unique_ptr_type = std::unique_ptr<buf_istream_type>;
     mutable buf_istream_unique_ptr_type in;
+    size_t m_nbuffers;
 
     void delete_stream()
     {
         in.reset();      // delete object
     }
 
+    //! (re)create the prefetching stream at the block of m_current
+    void open_stream()
+    {
+        delete_stream(); // cancel prefetching of the old stream first
+
+        typename InputIterator::bids_container_iterator end_iter
+            = m_end.bid() + ((m_end.block_offset()) ? 1 : 0);
+
+        in.reset(new buf_istream_type(m_current.bid(), end_iter, m_nbuffers));
+
+        // skip the beginning of the block
+        for (size_t i = 0; i < m_current.block_offset(); ++i)
+            ++(*in);
+    }
+
 public:
     //! Standard stream typedef.
     using value_type = typename std::iterator_traits<InputIterator>::value_type;
@@ -133,27 +155,17 @@ public:
     vector_iterator2stream(InputIterator begin, InputIterator end,
                            size_t nbuffers = 0)
         : m_current(begin), m_end(end),
-          in(static_cast<buf_istream_type*>(nullptr))
+          in(static_cast<buf_istream_type*>(nullptr)),
+          m_nbuffers(nbuffers ? nbuffers :
+                     (2 * foxxll::config::get_instance()->disks_number()))
     {
         if (empty())
             return;
 
-        begin.flush();         // flush container
-        typename InputIterator::bids_container_iterator end_iter
-            = end.bid() + ((end.block_offset()) ? 1 : 0);
-
-        if (end_iter - begin.bid() > 0)
-        {
-            in.reset(new buf_istream_type(
-                         begin.bid(), end_iter, nbuffers ? nbuffers :
-                         (2 * foxxll::config::get_instance()->disks_number())));
-
-            InputIterator cur = begin - begin.block_offset();
+        // flush container, reading does not require exclusive blocks
+        typename InputIterator::const_iterator(begin).flush();
 
-            // skip the beginning of the block
-            for ( ; cur != begin; ++cur)
-                ++(*in);
-        }
+        open_stream();
     }
 
     //! non-copyable: delete copy-constructor
@@ -188,6 +200,35 @@ public:
         return *this;
     }
 
+    //! Skips the next n elements, or all remaining ones, without reading the
+    //! blocks in between: if the target lies in another block, the
+    //! prefetching stream is recreated at the target block.
+    //! \return number of elements skipped
+    size_t skip(size_t n)
+    {
+        const size_t remaining = static_cast<size_t>(m_end - m_current);
+        n = std::min(n, remaining);
+
+        if (n == remaining)
+        {
+            m_current = m_end;
+            delete_stream();
+            return n;
+        }
+
+        const InputIterator target = m_current + n;
+        if (target.bid() == m_current.bid())
+        {
+            for ( ; m_current != target; ++m_current)
+                ++(*in);
+            return n;
+        }
+
+        m_current = target;
+        open_stream();
+        return n;
+    }
+
     //! Standard stream method.
     bool empty() const
     {
@@ -316,6 +357,19 @@ public:
         return *this;
     }
 
+    //! Skips the next n elements, or all remaining ones.
+    //! \return number of elements skipped
+    size_t skip(size_t n)
+    {
+        if (vec_it_stream)
+            return vec_it_stream->skip(n);
+
+        size_t i = 0;
+        for ( ; i < n && !it_stream->empty(); ++i)
+            ++(*it_stream);
+        return i;
+    }
+
     //! Standard stream method.
     bool empty() const
     {
@@ -361,6 +415,314 @@ auto streamify_sr(
         stxxl::const_vector_iterator<VectorConfig> >(first, last, nbuffers);
 }
 
+////////////////////////////////////////////////////////////////////////
+//     STREAMIFY REVERSE                                              //
+////////////////////////////////////////////////////////////////////////
+
+//! Bidirectional iterator range to stream converter, which outputs the
+//! values from last - 1 down to first.
+//! \param first iterator, pointing to the first value
+//! \param last iterator, pointing to the last + 1 position, i.e. beyond the range
+//! \return an instance of a stream object
+template <typename BidirectionalIterator>
+auto streamify_reverse(BidirectionalIterator first, BidirectionalIterator last)
+{
+    return iterator2stream<std::reverse_iterator<BidirectionalIterator> >(
+        std::reverse_iterator<BidirectionalIterator>(last),
+        std::reverse_iterator<BidirectionalIterator>(first));
+}
+
+//! A model of stream that retrieves the data from an external \c
+//! stxxl::vector iterator range backwards, starting with the last value. The
+//! blocks are read with overlapping from the back. For convenience use \c
+//! streamify_reverse function instead of direct instantiation.
+template <typename InputIterator>
+class vector_iterator2stream_reverse
+{
+    InputIterator m_begin, m_current;
+    using block_type = typename InputIterator::block_type;
+    using buf_istream_type = foxxll::buf_istream_reverse<block_type,
+                                                         typename InputIterator::bids_container_iterator>;
+
+    using buf_istream_unique_ptr_type = std::unique_ptr<buf_istream_type>;
+    mutable buf_istream_unique_ptr_type in;
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename std::iterator_traits<InputIterator>::value_type;
+
+    vector_iterator2stream_reverse(InputIterator begin, InputIterator end,
+                                   size_t nbuffers = 0)
+        : m_begin(begin), m_current(end)
+    {
+        if (empty())
+            return;
+
+        // flush container, reading does not require exclusive blocks
+        typename InputIterator::const_iterator(begin).flush();
+
+        if (nbuffers == 0)
+            nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+
+        typename InputIterator::bids_container_iterator end_iter
+            = end.bid() + ((end.block_offset()) ? 1 : 0);
+
+        in.reset(new buf_istream_type(begin.bid(), end_iter, nbuffers));
+
+        // skip the values behind the end of the range in its block
+        if (end.block_offset() != 0)
+        {
+            for (size_t i = end.block_offset(); i != block_type::size; ++i)
+                ++(*in);
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    vector_iterator2stream_reverse(const vector_iterator2stream_reverse&) = delete;
+    //! non-copyable: delete assignment operator
+    vector_iterator2stream_reverse& operator = (const vector_iterator2stream_reverse&) = delete;
+    //! move-constructor: default
+    vector_iterator2stream_reverse(vector_iterator2stream_reverse&&) = default;
+    //! move-assignment operator: default
+    vector_iterator2stream_reverse& operator = (vector_iterator2stream_reverse&&) = default;
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        return **in;
+    }
+
+    const value_type* operator -> () const
+    {
+        return &(**in);
+    }
+
+    //! Standard stream method.
+    vector_iterator2stream_reverse& operator ++ ()
+    {
+        assert(m_begin != m_current);
+        --m_current;
+        ++(*in);
+        if (TLX_UNLIKELY(empty()))
+            in.reset();
+
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return (m_current == m_begin);
+    }
+};
+
+//! Input external \c stxxl::vector iterator range to reverse stream
+//! converter, which outputs the values from last - 1 down to first.
+//! \param first iterator, pointing to the first value
+//! \param last iterator, pointing to the last + 1 position, i.e. beyond the range
+//! \param nbuffers number of blocks used for overlapped reading (0 is default,
+//! which equals to (2 * number_of_disks)
+//! \return an instance of a stream object
+template <typename VectorConfig>
+auto streamify_reverse(
+    stxxl::vector_iterator<VectorConfig> first,
+    stxxl::vector_iterator<VectorConfig> last,
+    size_t nbuffers = 0)
+{
+    return vector_iterator2stream_reverse<stxxl::vector_iterator<VectorConfig> >(
+        first, last, nbuffers);
+}
+
+//! Input external \c stxxl::vector const iterator range to reverse stream
+//! converter, which outputs the values from last - 1 down to first.
+//! \param first const iterator, pointing to the first value
+//! \param last const iterator, pointing to the last + 1 position, i.e. beyond the range
+//! \param nbuffers number of blocks used for overlapped reading (0 is default,
+//! which equals to (2 * number_of_disks)
+//! \return an instance of a stream object
+template <typename VectorConfig>
+auto streamify_reverse(
+    stxxl::const_vector_iterator<VectorConfig> first,
+    stxxl::const_vector_iterator<VectorConfig> last,
+    size_t nbuffers = 0)
+{
+    return vector_iterator2stream_reverse<stxxl::const_vector_iterator<VectorConfig> >(
+        first, last, nbuffers);
+}
+
+////////////////////////////////////////////////////////////////////////
+//     STREAMIFY STRIDED                                              //
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * A model of stream that retrieves every stride-th value of an external \c
+ * stxxl::vector iterator range, starting with the first one.
+ *
+ * The blocks containing the selected values are determined in advance and
+ * only these are read, in order and with overlapping by a \c
+ * foxxll::block_prefetcher. Hence for strides larger than a block the I/O
+ * volume is proportional to the number of values output. For convenience use
+ * \c streamify_strided function instead of direct instantiation.
+ */
+template <typename InputIterator>
+class vector_strided2stream
+{
+    using block_type = typename InputIterator::block_type;
+    using bid_type = typename block_type::bid_type;
+    using bid_container_type = std::vector<bid_type>;
+    using prefetcher_type = foxxll::block_prefetcher<
+              block_type, typename bid_container_type::iterator>;
+
+    //! distance between the output values
+    size_t m_stride;
+    //! number of values still to output
+    size_t m_remaining;
+    //! position of the current value, relative to the first block
+    size_t m_pos;
+    //! blocks containing the selected values, in order
+    bid_container_type m_bids;
+    //! order of the prefetches, sequential
+    std::vector<size_t> m_prefetch_seq;
+    //! reads m_bids
+    std::unique_ptr<prefetcher_type> m_prefetcher;
+    //! block holding the current value
+    block_type* m_block;
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename std::iterator_traits<InputIterator>::value_type;
+
+    vector_strided2stream(InputIterator begin, InputIterator end,
+                          size_t stride, size_t nbuffers = 0)
+        : m_stride(stride), m_remaining(0), m_pos(begin.block_offset()),
+          m_block(nullptr)
+    {
+        if (stride == 0)
+            throw foxxll::bad_parameter("stream::streamify_strided(): stride must be at least 1");
+
+        if (begin == end)
+            return;
+
+        // flush container, reading does not require exclusive blocks
+        typename InputIterator::const_iterator(begin).flush();
+
+        const size_t n = static_cast<size_t>(end - begin);
+        m_remaining = (n + stride - 1) / stride;
+
+        // collect the distinct blocks of the selected values
+        size_t last_block = std::numeric_limits<size_t>::max();
+        for (size_t k = 0, pos = m_pos; k < m_remaining; ++k, pos += stride)
+        {
+            const size_t i_block = pos / block_type::size;
+            if (i_block != last_block)
+            {
+                m_bids.push_back(*(begin.bid() + i_block));
+                last_block = i_block;
+            }
+        }
+
+        if (nbuffers == 0)
+            nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        nbuffers = std::min(nbuffers, m_bids.size());
+
+        m_prefetch_seq.resize(m_bids.size());
+        for (size_t i = 0; i < m_prefetch_seq.size(); ++i)
+            m_prefetch_seq[i] = i;
+
+        LOG0 << "vector_strided2stream: reading " << m_bids.size()
+             << " blocks for " << m_remaining << " values";
+
+        m_prefetcher.reset(new prefetcher_type(
+                               m_bids.begin(), m_bids.end(),
+                               m_prefetch_seq.data(), nbuffers));
+        m_block = m_prefetcher->pull_block();
+    }
+
+    //! non-copyable: delete copy-constructor
+    vector_strided2stream(const vector_strided2stream&) = delete;
+    //! non-copyable: delete assignment operator
+    vector_strided2stream& operator = (const vector_strided2stream&) = delete;
+    //! move-constructor: default
+    vector_strided2stream(vector_strided2stream&&) = default;
+    //! move-assignment operator: default
+    vector_strided2stream& operator = (vector_strided2stream&&) = default;
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        return (*m_block)[m_pos % block_type::size];
+    }
+
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    vector_strided2stream& operator ++ ()
+    {
+        assert(!empty());
+        if (TLX_UNLIKELY(--m_remaining == 0))
+        {
+            m_prefetcher.reset();
+            m_block = nullptr;
+            return *this;
+        }
+
+        const size_t i_block = m_pos / block_type::size;
+        m_pos += m_stride;
+        // the next selected value is in the next block read
+        if (m_pos / block_type::size != i_block)
+            m_prefetcher->block_consumed(m_block);
+
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return (m_remaining == 0);
+    }
+};
+
+//! Input external \c stxxl::vector iterator range to stream converter, which
+//! outputs every stride-th value starting with first, reading only the blocks
+//! containing them.
+//! \param first iterator, pointing to the first value
+//! \param last iterator, pointing to the last + 1 position, i.e. beyond the range
+//! \param stride distance between the output values, at least 1
+//! \param nbuffers number of blocks used for overlapped reading (0 is default,
+//! which equals to (2 * number_of_disks)
+//! \return an instance of a stream object
+template <typename VectorConfig>
+auto streamify_strided(
+    stxxl::vector_iterator<VectorConfig> first,
+    stxxl::vector_iterator<VectorConfig> last,
+    size_t stride, size_t nbuffers = 0)
+{
+    return vector_strided2stream<stxxl::vector_iterator<VectorConfig> >(
+        first, last, stride, nbuffers);
+}
+
+//! Input external \c stxxl::vector const iterator range to stream converter,
+//! which outputs every stride-th value starting with first, reading only the
+//! blocks containing them.
+//! \param first const iterator, pointing to the first value
+//! \param last const iterator, pointing to the last + 1 position, i.e. beyond the range
+//! \param stride distance between the output values, at least 1
+//! \param nbuffers number of blocks used for overlapped reading (0 is default,
+//! which equals to (2 * number_of_disks)
+//! \return an instance of a stream object
+template <typename VectorConfig>
+auto streamify_strided(
+    stxxl::const_vector_iterator<VectorConfig> first,
+    stxxl::const_vector_iterator<VectorConfig> last,
+    size_t stride, size_t nbuffers = 0)
+{
+    return vector_strided2stream<stxxl::const_vector_iterator<VectorConfig> >(
+        first, last, stride, nbuffers);
+}
+
 ////////////////////////////////////////////////////////////////////////
 //     GENERATE                                                       //
 ////////////////////////////////////////////////////////////////////////
@@ -612,6 +974,11 @@ public:
 
 #include <stxxl/bits/stream/choose.h>
 #include <stxxl/bits/stream/materialize.h>
+#include <stxxl/bits/stream/multiway_merge.h>
+#include <stxxl/bits/stream/partition.h>
+#include <stxxl/bits/stream/semi_join.h>
+#include <stxxl/bits/stream/set_operations.h>
+#include <stxxl/bits/stream/tee.h>
 #include <stxxl/bits/stream/unique.h>
 
 #endif // !STXXL_STREAM_STREAM_HEADER
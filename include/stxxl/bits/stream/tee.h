@@ -0,0 +1,242 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/tee.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_TEE_HEADER
+#define STXXL_STREAM_TEE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+
+#include <stxxl/bits/containers/deque.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     TEE                                                            //
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Lets several consumers read the same input stream.
+ *
+ * Each consumer, obtained by consumer(), is a stream delivering all elements
+ * of the input, and the consumers may advance independently. Elements are
+ * pulled from the input once and kept until every consumer has passed them.
+ * The most recent elements are kept in an in-memory window of bounded size;
+ * if the consumers diverge further, the older elements are spilled to an
+ * external stxxl::deque and read back from there by the lagging consumers.
+ *
+ * Each consumer keeps a copy of its current element, hence references
+ * obtained from a consumer stay valid until it is advanced.
+ */
+template <class Input>
+class tee
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+    //! A model of stream delivering the elements of the tee's input.
+    class consumer_type
+    {
+    public:
+        //! Standard stream typedef.
+        using value_type = typename Input::value_type;
+
+        //! Standard stream method.
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_current;
+        }
+
+        //! Standard stream method.
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! Standard stream method.
+        consumer_type& operator ++ ()
+        {
+            assert(!empty());
+            ++m_pos;
+            m_tee->release();
+            m_empty = !m_tee->fetch(m_pos, m_current);
+            return *this;
+        }
+
+        //! Standard stream method.
+        bool empty() const
+        {
+            return m_empty;
+        }
+
+    private:
+        friend class tee;
+
+        explicit consumer_type(tee* t)
+            : m_tee(t), m_pos(0), m_empty(true) { }
+
+        //! the tee this consumer reads from
+        tee* m_tee;
+        //! position of the current element in the input
+        size_t m_pos;
+        //! copy of the current element
+        value_type m_current;
+        //! whether the input was exhausted at m_pos
+        bool m_empty;
+    };
+
+    /*!
+     * Creates a tee with the given number of consumers. All consumers are
+     * positioned at the first element of the input.
+     *
+     * \param input input stream, which is read only through the tee
+     * \param num_consumers number of consumers
+     * \param memory_to_use memory in bytes for the in-memory window
+     */
+    tee(Input& input, size_t num_consumers, size_t memory_to_use)
+        : m_input(input),
+          m_window_size(std::max<size_t>(1, memory_to_use / sizeof(value_type))),
+          m_spill_begin(0), m_window_begin(0), m_spilled(0)
+    {
+        if (num_consumers == 0)
+            throw foxxll::bad_parameter("stream::tee(): num_consumers must be at least 1");
+
+        m_consumers.reserve(num_consumers);
+        for (size_t i = 0; i < num_consumers; ++i)
+        {
+            m_consumers.push_back(consumer_type(this));
+            consumer_type& c = m_consumers.back();
+            c.m_empty = !fetch(0, c.m_current);
+        }
+    }
+
+    //! non-copyable: the consumers refer to the tee
+    tee(const tee&) = delete;
+    //! non-copyable: delete assignment operator
+    tee& operator = (const tee&) = delete;
+
+    //! Returns the i-th consumer stream.
+    consumer_type& consumer(size_t i)
+    {
+        assert(i < m_consumers.size());
+        return m_consumers[i];
+    }
+
+    //! Number of consumers.
+    size_t num_consumers() const
+    {
+        return m_consumers.size();
+    }
+
+    //! Number of elements which had to be spilled to external memory so far.
+    size_t spilled() const
+    {
+        return m_spilled;
+    }
+
+private:
+    //! the input stream
+    Input& m_input;
+    //! the consumer streams
+    std::vector<consumer_type> m_consumers;
+    //! maximum number of elements in the in-memory window
+    size_t m_window_size;
+
+    //! elements at positions [m_spill_begin, m_window_begin)
+    stxxl::deque<value_type> m_spill;
+    //! elements at positions [m_window_begin, m_window_begin + m_window.size())
+    std::deque<value_type> m_window;
+
+    //! position of the first element still needed
+    size_t m_spill_begin;
+    //! position of the first element in the in-memory window
+    size_t m_window_begin;
+    //! number of elements spilled
+    size_t m_spilled;
+
+    //! Copies the element at position pos to value, pulling it from the
+    //! input if no consumer has read it yet.
+    //! \return false if the input is exhausted at pos
+    bool fetch(size_t pos, value_type& value)
+    {
+        assert(pos >= m_spill_begin);
+
+        if (pos < m_window_begin)
+        {
+            value = m_spill[pos - m_spill_begin];
+            return true;
+        }
+
+        if (pos < m_window_begin + m_window.size())
+        {
+            value = m_window[pos - m_window_begin];
+            return true;
+        }
+
+        assert(pos == m_window_begin + m_window.size());
+
+        if (m_input.empty())
+            return false;
+
+        value = *m_input;
+        ++m_input;
+
+        m_window.push_back(value);
+        if (m_window.size() > m_window_size)
+        {
+            // some consumer still needs the oldest element, else it would
+            // have been released
+            m_spill.push_back(m_window.front());
+            m_window.pop_front();
+            ++m_window_begin;
+            ++m_spilled;
+        }
+
+        return true;
+    }
+
+    //! Drops all elements which every consumer has passed.
+    void release()
+    {
+        size_t min_pos = m_consumers[0].m_pos;
+        for (size_t i = 1; i < m_consumers.size(); ++i)
+            min_pos = std::min(min_pos, m_consumers[i].m_pos);
+
+        for ( ; m_spill_begin < min_pos && !m_spill.empty(); ++m_spill_begin)
+            m_spill.pop_front();
+
+        for ( ; m_window_begin < min_pos && !m_window.empty(); ++m_window_begin)
+            m_window.pop_front();
+
+        if (m_spill.empty())
+            m_spill_begin = m_window_begin;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_TEE_HEADER
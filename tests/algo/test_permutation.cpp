@@ -0,0 +1,86 @@
+/***************************************************************************
+ *  tests/algo/test_permutation.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_permutation.cpp
+//! This is an example of how to use \c stxxl::sort_permutation() and
+//! \c stxxl::apply_permutation()
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/permutation>
+#include <stxxl/vector>
+
+#include <key_with_padding.h>
+#include <test_helpers.h>
+
+using KeyType = uint64_t;
+constexpr size_t RecordSize = 64;
+using my_type = key_with_padding<KeyType, RecordSize, true>;
+using get_key = my_type::key_extract;
+
+int main()
+{
+    using vector_type = stxxl::vector<my_type, 4, stxxl::lru_pager<4> >;
+    using index_vector_type = stxxl::vector<uint64_t>;
+
+    const size_t memory_to_use = 32 * STXXL_DEFAULT_BLOCK_SIZE(my_type);
+    const uint64_t n_records = 5 * 16 * uint64_t(STXXL_DEFAULT_BLOCK_SIZE(my_type)) / sizeof(my_type) + 13;
+
+    vector_type v(n_records);
+    // few distinct keys to exercise stability
+    random_fill_vector(v, [](uint64_t x) { return my_type(x % 1000); });
+
+    LOG1 << "Computing sorted permutation...";
+    index_vector_type perm;
+    stxxl::sort_permutation(v.cbegin(), v.cend(), get_key(), perm, memory_to_use);
+
+    die_unless(perm.size() == n_records);
+
+    LOG1 << "Checking permutation...";
+    {
+        std::vector<bool> seen(n_records, false);
+        index_vector_type::bufreader_type reader(perm);
+        uint64_t prev = 0;
+        for (uint64_t i = 0; !reader.empty(); ++reader, ++i)
+        {
+            const uint64_t p = *reader;
+            die_unless(p < n_records);
+            die_unless(!seen[p]);
+            seen[p] = true;
+
+            if (i > 0) {
+                die_unless(v[prev].key <= v[p].key);
+                if (v[prev].key == v[p].key)
+                    die_unless(prev < p);
+            }
+            prev = p;
+        }
+    }
+
+    LOG1 << "Applying permutation...";
+    vector_type out(n_records);
+    stxxl::apply_permutation(v.cbegin(), v.cend(), perm.cbegin(), perm.cend(),
+                             out.begin(), memory_to_use);
+
+    LOG1 << "Checking output...";
+    die_unless(stxxl::is_sorted(out.cbegin(), out.cend()));
+    for (uint64_t i = 0; i < n_records; ++i)
+    {
+        die_unless(out[i].key == v[perm[i]].key);
+        die_unless(out[i].key == out[i].key_copy);
+    }
+
+    LOG1 << "OK";
+
+    return 0;
+}
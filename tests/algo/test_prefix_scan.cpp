@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  tests/algo/test_prefix_scan.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_prefix_scan.cpp
+//! This is an example of how to use \c stxxl::inclusive_scan(),
+//! \c stxxl::exclusive_scan() and \c stxxl::segmented_scan()
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/scan>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+
+void fill(vector_type& v, std::vector<value_type>& ref, size_t n)
+{
+    std::mt19937_64 rng(n);
+    std::uniform_int_distribution<value_type> distr(0, 1000);
+    ref.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        ref[i] = distr(rng);
+
+    v.resize(n);
+    std::copy(ref.begin(), ref.end(), v.begin());
+}
+
+void check_equal(const vector_type& v, const std::vector<value_type>& ref)
+{
+    die_unless(v.size() == ref.size());
+
+    vector_type::bufreader_type reader(v);
+    for (size_t i = 0; i < ref.size(); ++i, ++reader)
+        die_unless(*reader == ref[i]);
+}
+
+//! scan the range [begin, end) of a vector with n elements
+void test_prefix_scan(size_t n, size_t begin, size_t end)
+{
+    LOG1 << "n=" << n << " begin=" << begin << " end=" << end;
+
+    vector_type v;
+    std::vector<value_type> ref;
+
+    {
+        fill(v, ref, n);
+        stxxl::inclusive_scan(v.begin() + begin, v.begin() + end);
+        std::partial_sum(ref.begin() + begin, ref.begin() + end, ref.begin() + begin);
+        check_equal(v, ref);
+    }
+    {
+        // max is associative but not commutative with respect to position
+        auto op = [](const value_type& a, const value_type& b) {
+                      return std::max(a, b);
+                  };
+        fill(v, ref, n);
+        stxxl::inclusive_scan(v.begin() + begin, v.begin() + end, op);
+        std::partial_sum(ref.begin() + begin, ref.begin() + end, ref.begin() + begin, op);
+        check_equal(v, ref);
+    }
+    {
+        fill(v, ref, n);
+        value_type total = stxxl::exclusive_scan(
+            v.begin() + begin, v.begin() + end, value_type(42));
+
+        value_type sum = 42;
+        for (size_t i = begin; i < end; ++i)
+        {
+            value_type x = ref[i];
+            ref[i] = sum;
+            sum += x;
+        }
+        die_unless(total == sum);
+        check_equal(v, ref);
+    }
+    {
+        auto is_segment_start = [](const value_type& x) { return x % 97 == 0; };
+
+        fill(v, ref, n);
+        stxxl::segmented_scan(v.begin() + begin, v.begin() + end,
+                              is_segment_start, std::plus<value_type>());
+
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            if (!is_segment_start(ref[i]))
+                ref[i] += ref[i - 1];
+        }
+        check_equal(v, ref);
+    }
+}
+
+int main()
+{
+    const size_t block_size = vector_type::block_type::size;
+
+    test_prefix_scan(0, 0, 0);
+    test_prefix_scan(100, 10, 90);
+    test_prefix_scan(3 * block_size, 0, 3 * block_size);
+    test_prefix_scan(64 * block_size + 17, 0, 64 * block_size + 17);
+    test_prefix_scan(64 * block_size + 17, 5, 63 * block_size + 3);
+    test_prefix_scan(256 * block_size, block_size, 255 * block_size);
+
+    return 0;
+}
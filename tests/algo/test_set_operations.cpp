@@ -0,0 +1,121 @@
+/***************************************************************************
+ *  tests/algo/test_set_operations.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_set_operations.cpp
+//! This is an example of how to use \c stxxl::merge(), \c stxxl::set_union(),
+//! \c stxxl::set_intersection(), \c stxxl::set_difference() and
+//! \c stxxl::includes() on sorted vectors
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/set_operations>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+using cmp_type = std::less<value_type>;
+
+void fill_sorted(vector_type& v, std::vector<value_type>& ref,
+                 size_t n, value_type range, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<value_type> distr(0, range);
+    ref.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        ref[i] = distr(rng);
+    std::sort(ref.begin(), ref.end());
+
+    v.resize(n);
+    std::copy(ref.begin(), ref.end(), v.begin());
+}
+
+void check_equal(vector_type::const_iterator begin, vector_type::const_iterator end,
+                 const std::vector<value_type>& ref)
+{
+    die_unless(static_cast<size_t>(end - begin) == ref.size());
+
+    vector_type::bufreader_type reader(begin, end);
+    for (size_t i = 0; i < ref.size(); ++i, ++reader)
+        die_unless(*reader == ref[i]);
+}
+
+void test_set_operations(size_t n1, size_t n2, value_type range, size_t offset)
+{
+    LOG1 << "n1=" << n1 << " n2=" << n2 << " range=" << range << " offset=" << offset;
+
+    std::mt19937_64 rng(n1 + n2 + range);
+    vector_type a, b;
+    std::vector<value_type> ra, rb, rout;
+    fill_sorted(a, ra, n1, range, rng);
+    fill_sorted(b, rb, n2, range, rng);
+
+    // write behind offset to exercise unaligned output
+    vector_type out(offset + n1 + n2);
+    cmp_type cmp;
+
+    {
+        vector_type::iterator end = stxxl::merge(
+            a.begin(), a.end(), b.begin(), b.end(), out.begin() + offset, cmp);
+        rout.clear();
+        std::merge(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(rout), cmp);
+        check_equal(out.cbegin() + offset, end, rout);
+    }
+    {
+        vector_type::iterator end = stxxl::set_union(
+            a.begin(), a.end(), b.begin(), b.end(), out.begin(), cmp);
+        rout.clear();
+        std::set_union(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(rout), cmp);
+        check_equal(out.cbegin(), end, rout);
+    }
+    {
+        vector_type::iterator end = stxxl::set_intersection(
+            a.begin(), a.end(), b.begin(), b.end(), out.begin(), cmp);
+        rout.clear();
+        std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(rout), cmp);
+        check_equal(out.cbegin(), end, rout);
+    }
+    {
+        vector_type::iterator end = stxxl::set_difference(
+            a.begin(), a.end(), b.begin(), b.end(), out.begin(), cmp);
+        rout.clear();
+        std::set_difference(ra.begin(), ra.end(), rb.begin(), rb.end(), std::back_inserter(rout), cmp);
+        check_equal(out.cbegin(), end, rout);
+    }
+
+    die_unless(stxxl::includes(a.begin(), a.end(), b.begin(), b.end(), cmp)
+               == std::includes(ra.begin(), ra.end(), rb.begin(), rb.end(), cmp));
+
+    // b is a subset of the union
+    vector_type::iterator uend = stxxl::set_union(
+        a.begin(), a.end(), b.begin(), b.end(), out.begin(), cmp);
+    die_unless(stxxl::includes(out.begin(), uend, b.begin(), b.end(), cmp));
+}
+
+int main()
+{
+    test_set_operations(0, 0, 10, 0);
+    test_set_operations(1000, 0, 100, 0);
+    test_set_operations(0, 1000, 100, 3);
+    // many duplicates
+    test_set_operations(100000, 70000, 1000, 0);
+    test_set_operations(100000, 70000, 1000, 17);
+    // few duplicates
+    test_set_operations(300000, 250000, 1000000000, 511);
+
+    return 0;
+}
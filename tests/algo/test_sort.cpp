@@ -72,6 +72,15 @@ int main()
     LOG1 << "Checking order...";
     die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
 
+    LOG1 << "Sorting again, reusing consumed blocks in the merge...";
+    random_fill_vector(v, [](uint64_t x) -> my_type { return my_type(1 + (x % 0xfffffff)); });
+    stxxl::SETTINGS::recycle_merge_blocks = true;
+    stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+    stxxl::SETTINGS::recycle_merge_blocks = false;
+
+    LOG1 << "Checking order...";
+    die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
     LOG1 << "Done, output size=" << v.size();
 
     std::cout << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
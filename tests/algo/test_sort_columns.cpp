@@ -0,0 +1,144 @@
+/***************************************************************************
+ *  tests/algo/test_sort_columns.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_sort_columns.cpp
+//! This is an example of how to use \c stxxl::sort_columns() to sort a table
+//! stored as one \c stxxl::vector per column.
+
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/permutation>
+#include <stxxl/vector>
+
+int main(int argc, char* argv[])
+{
+    using key_vector_type = stxxl::vector<uint32_t>;
+    using row_vector_type = stxxl::vector<uint64_t>;
+    using value_vector_type = stxxl::vector<double>;
+
+    const size_t memory_to_use = 32 * 4096 * stxxl::sort_memory_usage_factor();
+    const uint64_t n_rows = 40 * 4096 / sizeof(uint32_t) + 13;
+
+    key_vector_type keys(n_rows);
+    row_vector_type rows(n_rows);
+    value_vector_type values(n_rows);
+
+    // few distinct keys to exercise stability
+    for (uint64_t i = 0; i < n_rows; ++i)
+    {
+        keys[i] = static_cast<uint32_t>((i * 7919) % 1000);
+        rows[i] = i;
+        values[i] = keys[i] * 0.5;
+    }
+
+    LOG1 << "Sorting columns...";
+    stxxl::sort_columns(keys, stxxl::comparator<uint32_t>(), memory_to_use,
+                        rows, values);
+
+    LOG1 << "Checking columns...";
+    die_unequal(keys.size(), n_rows);
+    die_unequal(rows.size(), n_rows);
+    die_unequal(values.size(), n_rows);
+    {
+        std::vector<bool> seen(n_rows, false);
+        key_vector_type::bufreader_type key_reader(keys);
+        row_vector_type::bufreader_type row_reader(rows);
+        value_vector_type::bufreader_type value_reader(values);
+        uint32_t prev_key = 0;
+        uint64_t prev_row = 0;
+        for (uint64_t i = 0; i < n_rows; ++i, ++key_reader, ++row_reader, ++value_reader)
+        {
+            const uint64_t row = *row_reader;
+            die_unless(row < n_rows);
+            die_unless(!seen[row]);
+            seen[row] = true;
+
+            die_unequal(*key_reader, static_cast<uint32_t>((row * 7919) % 1000));
+            die_unequal(*value_reader, *key_reader * 0.5);
+
+            if (i > 0) {
+                die_unless(prev_key <= *key_reader);
+                if (prev_key == *key_reader)
+                    die_unless(prev_row < row);
+            }
+            prev_key = *key_reader;
+            prev_row = row;
+        }
+    }
+
+    LOG1 << "Checking size mismatch...";
+    row_vector_type short_column(n_rows - 1);
+    bool thrown = false;
+    try {
+        stxxl::sort_columns(keys, stxxl::comparator<uint32_t>(), memory_to_use,
+                            short_column);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    LOG1 << "Checking insufficient memory for a payload column...";
+    using wide_vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<8>, 1024* 1024>;
+    wide_vector_type wide_column(n_rows);
+    for (uint64_t i = 0; i < n_rows; ++i)
+        keys[i] = static_cast<uint32_t>(n_rows - i);
+    thrown = false;
+    try {
+        stxxl::sort_columns(keys, stxxl::comparator<uint32_t>(), memory_to_use,
+                            rows, wide_column);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+    for (uint64_t i = 0; i < n_rows; ++i)
+        die_unequal(keys[i], static_cast<uint32_t>(n_rows - i));
+
+    LOG1 << "Checking a file-backed payload column...";
+    {
+        const std::string path = (argc > 1) ? argv[1] : "sort_columns";
+        foxxll::file_ptr file = foxxll::create_file(
+            "syscall", path,
+            foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR
+            | foxxll::file::TRUNC);
+        {
+            row_vector_type file_rows(file);
+            file_rows.resize(n_rows);
+            for (uint64_t i = 0; i < n_rows; ++i)
+                file_rows[i] = i;
+
+            // the keys are descending
+            stxxl::sort_columns(keys, stxxl::comparator<uint32_t>(), memory_to_use,
+                                file_rows);
+
+            die_unless(file_rows.get_file() == file);
+            for (uint64_t i = 0; i < n_rows; ++i)
+                die_unequal(file_rows[i], n_rows - 1 - i);
+        }
+
+        // the file holds the sorted column
+        row_vector_type reopened(file);
+        die_unequal(reopened.size(), n_rows);
+        for (uint64_t i = 0; i < n_rows; ++i)
+            die_unequal(reopened[i], n_rows - 1 - i);
+    }
+
+    LOG1 << "OK";
+
+    return 0;
+}
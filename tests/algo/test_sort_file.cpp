@@ -0,0 +1,194 @@
+/***************************************************************************
+ *  tests/algo/test_sort_file.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+// the sort subtool of stxxl_tool, see tools/sort_file.cpp
+extern int do_sort(int argc, char* argv[]);
+
+static void write_file(const std::string& path, const std::string& data)
+{
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    die_unless(f);
+    die_unequal(std::fwrite(data.data(), 1, data.size(), f), data.size());
+    die_unequal(std::fclose(f), 0);
+}
+
+static std::string read_file(const std::string& path)
+{
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    die_unless(f);
+    std::string data;
+    char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.append(buffer, n);
+    die_unless(!std::ferror(f));
+    std::fclose(f);
+    return data;
+}
+
+static int run_sort(std::vector<std::string> args)
+{
+    args.insert(args.begin(), "sort");
+    std::vector<char*> argv;
+    for (std::string& a : args)
+        argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    return do_sort(static_cast<int>(args.size()), argv.data());
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string prefix = (argc > 1) ? argv[1] : "sort_file";
+    const std::string input = prefix + ".in", output = prefix + ".out";
+
+    // binary records of 12 bytes with a signed 4-byte key at offset 4
+    {
+        const size_t n_records = 10000;
+        std::mt19937 rng(42);
+        std::vector<int32_t> keys(n_records);
+        std::string data(12 * n_records, 0);
+        for (size_t i = 0; i < n_records; ++i)
+        {
+            keys[i] = static_cast<int32_t>(rng() % 2000) - 1000;
+            const uint32_t row = static_cast<uint32_t>(i);
+            std::memcpy(&data[12 * i], &row, 4);
+            std::memcpy(&data[12 * i + 4], &keys[i], 4);
+            std::memcpy(&data[12 * i + 8], &row, 4);
+        }
+        write_file(input, data);
+
+        die_unequal(run_sort({ input, output, "-s", "12", "-o", "4", "-w", "4",
+                               "-t", "int", "-M", "64MiB" }), 0);
+
+        const std::string sorted = read_file(output);
+        die_unequal(sorted.size(), data.size());
+
+        std::vector<size_t> count(n_records, 0);
+        int32_t last = INT32_MIN;
+        for (size_t i = 0; i < n_records; ++i)
+        {
+            uint32_t row, row2;
+            int32_t key;
+            std::memcpy(&row, &sorted[12 * i], 4);
+            std::memcpy(&key, &sorted[12 * i + 4], 4);
+            std::memcpy(&row2, &sorted[12 * i + 8], 4);
+            die_unless(row < n_records);
+            die_unequal(row, row2);
+            die_unequal(key, keys[row]);
+            die_unless(last <= key);
+            last = key;
+            ++count[row];
+        }
+        for (size_t i = 0; i < n_records; ++i)
+            die_unequal(count[i], 1u);
+
+        // a size which is not a multiple of the record size is rejected
+        write_file(input, data.substr(0, data.size() - 5));
+        die_unless(run_sort({ input, output, "-s", "12", "-M", "64MiB" }) != 0);
+    }
+
+    // text lines sorted numerically by their second field, the last line has
+    // no newline
+    {
+        write_file(input,
+                   "c\t10\tx\n"
+                   "a\t-2.5\ty\n"
+                   "b\t3\n"
+                   "\n"
+                   "d\t100\tz\n"
+                   "e\t3e1");
+
+        die_unequal(run_sort({ input, output, "-k", "2", "-n", "-M", "64MiB" }), 0);
+        die_unequal(read_file(output),
+                    std::string("a\t-2.5\ty\n"
+                                "\n"
+                                "b\t3\n"
+                                "c\t10\tx\n"
+                                "e\t3e1\n"
+                                "d\t100\tz\n"));
+
+        // whole lines in descending byte order
+        die_unequal(run_sort({ input, output, "-r", "-M", "64MiB" }), 0);
+        die_unequal(read_file(output),
+                    std::string("e\t3e1\n"
+                                "d\t100\tz\n"
+                                "c\t10\tx\n"
+                                "b\t3\n"
+                                "a\t-2.5\ty\n"
+                                "\n"));
+    }
+
+    // many short lines and a few lines longer than the slot, some of them
+    // longer than 16 KiB and with keys which only differ after the part of
+    // the key kept in the slot
+    {
+        std::vector<std::string> lines;
+        for (size_t i = 0; i < 5000; ++i)
+            lines.push_back(std::to_string((i * 7919) % 5000));
+        const std::string common(100, 'x');
+        for (size_t i = 0; i < 20; ++i)
+        {
+            const std::string fill(20000 + 1000 * (i % 7), static_cast<char>('a' + i % 5));
+            lines.push_back(common + fill + std::to_string(i));
+        }
+        std::shuffle(lines.begin(), lines.end(), std::mt19937(7));
+
+        std::string data;
+        for (const std::string& l : lines)
+            data += l + '\n';
+        write_file(input, data);
+
+        die_unequal(run_sort({ input, output, "-M", "64MiB" }), 0);
+
+        std::vector<std::string> sorted = lines;
+        std::sort(sorted.begin(), sorted.end());
+        std::string expected;
+        for (const std::string& l : sorted)
+            expected += l + '\n';
+        die_unequal(read_file(output), expected);
+
+        // descending by the second field, which is long for the long lines
+        for (size_t i = 0; i < lines.size(); ++i)
+            lines[i] = std::to_string(i) + '\t' + lines[i] + '_' + std::to_string(i);
+        data.clear();
+        for (const std::string& l : lines)
+            data += l + '\n';
+        write_file(input, data);
+
+        die_unequal(run_sort({ input, output, "-k", "2", "-r", "-M", "64MiB" }), 0);
+
+        sorted = lines;
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const std::string& a, const std::string& b) {
+                      return a.substr(a.find('\t') + 1) > b.substr(b.find('\t') + 1);
+                  });
+        expected.clear();
+        for (const std::string& l : sorted)
+            expected += l + '\n';
+        die_unequal(read_file(output), expected);
+    }
+
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+ *  tests/common/test_huge_page_arena.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/huge_page_arena.h>
+
+struct counted
+{
+    static size_t alive;
+    size_t value;
+
+    counted() : value(42) { ++alive; }
+    ~counted() { --alive; }
+};
+
+size_t counted::alive = 0;
+
+void test_arena()
+{
+    stxxl::huge_page_arena* arena = stxxl::huge_page_arena::get_instance();
+    const size_t size = 3 * stxxl::huge_page_arena::huge_page_size + 17;
+
+    char* a = static_cast<char*>(arena->allocate(size));
+    die_unless(reinterpret_cast<uintptr_t>(a) % 4096 == 0);
+    std::memset(a, 1, size);
+    arena->deallocate(a, size);
+
+#if STXXL_HAVE_HUGE_PAGES
+    // freed buffers of the same rounded size are reused
+    die_unequal(arena->cached_bytes(), 4 * stxxl::huge_page_arena::huge_page_size);
+    char* b = static_cast<char*>(arena->allocate(size + 100));
+    die_unequal(a, b);
+    die_unequal(arena->cached_bytes(), 0u);
+    die_unless(reinterpret_cast<uintptr_t>(b) % stxxl::huge_page_arena::huge_page_size == 0);
+    die_unequal(arena->num_reused(), 1u);
+    die_unequal(arena->num_hugetlb() + arena->num_transparent(), 1u);
+    arena->deallocate(b, size + 100);
+
+    // shrinking the cache unmaps the buffers
+    arena->set_cache_limit(0);
+    die_unequal(arena->cached_bytes(), 0u);
+    char* c = static_cast<char*>(arena->allocate(size));
+    arena->deallocate(c, size);
+    die_unequal(arena->cached_bytes(), 0u);
+    arena->set_cache_limit(size_t(1) << 30);
+#endif
+
+    // small buffers bypass the arena
+    void* small = arena->allocate(1000);
+    die_unless(reinterpret_cast<uintptr_t>(small) % 4096 == 0);
+    arena->deallocate(small, 1000);
+    die_unequal(arena->cached_bytes(), 0u);
+}
+
+void test_array()
+{
+    {
+        stxxl::huge_page_array<counted> array(1000000);
+        die_unequal(array.size(), 1000000u);
+        die_unequal(counted::alive, 1000000u);
+        for (size_t i = 0; i < array.size(); ++i)
+            die_unequal(array[i].value, 42u);
+
+        stxxl::huge_page_array<counted> other;
+        other.swap(array);
+        die_unequal(array.size(), 0u);
+        die_unequal(other.size(), 1000000u);
+
+        other.allocate(10);
+        die_unequal(counted::alive, 10u);
+    }
+    die_unequal(counted::alive, 0u);
+    stxxl::huge_page_arena::get_instance()->release();
+}
+
+void test_allocator()
+{
+    using vector_type = std::vector<uint64_t, stxxl::huge_page_allocator<uint64_t> >;
+    stxxl::huge_page_arena* arena = stxxl::huge_page_arena::get_instance();
+    const size_t n = stxxl::huge_page_arena::huge_page_size / sizeof(uint64_t) + 5;
+
+    vector_type a(n, 7);
+    const uint64_t* data = a.data();
+
+    // moves and swaps keep the buffer
+    vector_type b(std::move(a));
+    die_unequal(b.data(), data);
+    vector_type c(10, 1);
+    c.swap(b);
+    die_unequal(c.data(), data);
+    die_unequal(c[n - 1], 7u);
+
+    // the large buffer is cached and reused, the small one is not
+    c = vector_type();
+    b = vector_type();
+#if STXXL_HAVE_HUGE_PAGES
+    die_unequal(arena->cached_bytes(), 2 * stxxl::huge_page_arena::huge_page_size);
+    vector_type d(n);
+    die_unequal(d.data(), data);
+#endif
+    arena->release();
+}
+
+int main()
+{
+    test_arena();
+    test_array();
+    test_allocator();
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,109 @@
+/***************************************************************************
+ *  tests/common/test_io_account.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <sstream>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/sorter>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+constexpr size_t block_size = 4096;
+constexpr size_t block_items = block_size / sizeof(value_type);
+
+void test_vector()
+{
+    stxxl::io_account* account = stxxl::io_accounts::get_instance()->get("vector");
+
+    // two pages of one block each, such that the pages are evicted
+    using vector_type = stxxl::vector<value_type, 1, stxxl::lru_pager<2>, block_size>;
+    vector_type vec(16 * block_items);
+    vec.set_io_account(account);
+    die_unequal(vec.get_io_account(), account);
+
+    for (size_t i = 0; i < vec.size(); ++i)
+        vec[i] = i;
+    die_unless(account->blocks_written() > 0);
+    die_unequal(account->bytes_written(), account->blocks_written() * block_size);
+
+    for (size_t i = 0; i < vec.size(); ++i)
+        die_unequal(vec[i], i);
+    die_unless(account->blocks_read() > 0);
+    die_unequal(account->bytes_read(), account->blocks_read() * block_size);
+
+    // detached vectors are not counted
+    const uint64_t written = account->blocks_written();
+    vec.set_io_account(nullptr);
+    for (size_t i = 0; i < vec.size(); ++i)
+        vec[i] = i + 1;
+    die_unequal(account->blocks_written(), written);
+}
+
+void test_sorter()
+{
+    stxxl::io_account* account = stxxl::io_accounts::get_instance()->get("sorter");
+
+    using cmp_type = stxxl::comparator<value_type>;
+    stxxl::sorter<value_type, cmp_type, block_size> sorter(
+        cmp_type(), 16 * block_size * stxxl::sort_memory_usage_factor());
+    sorter.set_io_account(account);
+
+    const size_t n = 64 * block_items;
+    for (size_t i = 0; i < n; ++i)
+        sorter.push((i * 7919) % n);
+    sorter.sort();
+
+    // all runs were written
+    die_unless(account->blocks_written() >= n / block_items);
+
+    for (size_t i = 0; i < n; ++i, ++sorter)
+        die_unequal(*sorter, i);
+
+    // reads are counted when the merger releases its prefetcher
+    sorter.finish_clear();
+    die_unequal(account->blocks_read(), account->blocks_prefetched());
+    die_unless(account->blocks_read() >= n / block_items);
+}
+
+void test_registry()
+{
+    stxxl::io_accounts* accounts = stxxl::io_accounts::get_instance();
+    stxxl::io_account* a = accounts->get("registry");
+    die_unequal(accounts->get("registry"), a);
+    die_unless(accounts->get("other") != a);
+
+    a->add_read(2, 8192);
+    a->add_wait(0.5);
+    die_unequal(a->blocks_read(), 2u);
+    die_unless(a->wait_time() > 0.49 && a->wait_time() < 0.51);
+
+    std::ostringstream oss;
+    accounts->print(oss);
+    die_unless(oss.str().find("registry: read 2 blocks (8192 bytes)") != std::string::npos);
+
+    a->reset();
+    die_unequal(a->blocks_read(), 0u);
+    die_unequal(a->wait_time(), 0.0);
+
+    accounts->print_at_exit(false);
+}
+
+int main()
+{
+    test_vector();
+    test_sorter();
+    test_registry();
+
+    LOG1 << "Test passed.";
+    return 0;
+}
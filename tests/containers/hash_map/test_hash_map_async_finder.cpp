@@ -0,0 +1,113 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_hash_map_async_finder.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl.h>
+#include <stxxl/comparator>
+
+#include <hash_fib.h>
+
+using cmp = stxxl::comparator<int>;
+using unordered_map = stxxl::unordered_map<int, int, hash_fib, cmp, 4* 1024, 4>;
+
+int main()
+{
+    const size_t mem_to_sort = 32 * 1024 * 1024;
+    const int n_values = 200000;
+
+    unordered_map map;
+    stxxl::io_account* account = stxxl::io_accounts::get_instance()->get("async_finder");
+    map.set_io_account(account);
+
+    std::vector<std::pair<int, int> > values;
+    for (int k = 0; k < n_values; k += 2)
+        values.emplace_back(k, 3 * k);
+    map.insert(values.begin(), values.end(), mem_to_sort);
+
+    // buffered insertions and erasures are answered internally
+    map.insert_oblivious(std::make_pair(n_values + 1, 7));
+    map.erase_oblivious(10);
+
+    const uint64_t reads = account->blocks_read();
+
+    std::vector<int> result(n_values + 2, -1);
+    size_t n_callbacks = 0;
+    {
+        unordered_map::async_finder finder(map, 8);
+        for (int k = 0; k < n_values + 2; ++k)
+        {
+            finder.async_find(
+                k, [&result, &n_callbacks, k](const unordered_map::value_type* v) {
+                    ++n_callbacks;
+                    if (v) {
+                        die_unequal(v->first, k);
+                        result[k] = v->second;
+                    }
+                });
+            die_unless(finder.in_flight() <= 8);
+            if (k % 64 == 0)
+                finder.poll();
+        }
+        finder.wait_all();
+        die_unequal(finder.in_flight(), 0u);
+    }
+
+    die_unequal(n_callbacks, static_cast<size_t>(n_values + 2));
+    for (int k = 0; k < n_values; ++k)
+    {
+        if (k % 2 == 0 && k != 10)
+            die_unequal(result[k], 3 * k);
+        else
+            die_unequal(result[k], -1);
+    }
+    die_unequal(result[n_values + 1], 7);
+
+    // the values did not all fit into the block cache
+    die_unless(account->blocks_read() > reads);
+
+    // callbacks issue the next lookups, also while all buffers are in flight
+    for (size_t max_in_flight : { 1, 4 })
+    {
+        unordered_map::async_finder finder(map, max_in_flight);
+        size_t n_chained = 0;
+        const size_t n_chain = 2000;
+
+        std::function<void(int)> chain =
+            [&](int k) {
+                finder.async_find(
+                    k, [&, k](const unordered_map::value_type* v) {
+                        if (k % 2 == 0 && k != 10) {
+                            die_unless(v != nullptr);
+                            die_unequal(v->second, 3 * k);
+                        }
+                        else if (k < n_values) {
+                            die_unless(v == nullptr);
+                        }
+                        if (++n_chained < n_chain)
+                            chain(static_cast<int>((static_cast<uint64_t>(k) * 7919 + 1) % n_values));
+                    });
+            };
+
+        for (size_t i = 0; i < 2 * max_in_flight; ++i)
+            chain(static_cast<int>(i * 1013));
+        finder.wait_all();
+        die_unless(n_chained >= n_chain);
+        die_unequal(finder.in_flight(), 0u);
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -150,6 +150,29 @@ bool test_block_cache()
     die_unless(cache.size() == cache_size / 2);
     die_unless(cache2.size() == cache_size);
     die_unless(cache2.get_subblock(bids[6], 1) == a_subblock);
+
+    // append subblocks asynchronously, refilling the same subblock buffer
+    // while the previous write may be in flight
+    subblock_type* appended = new subblock_type;
+    for (unsigned i_block = 20; i_block < 20 + cache_size + 2; i_block++) {
+        for (unsigned i_subblock = 0; i_subblock < 4; i_subblock++) {
+            for (unsigned i_value = 0; i_value < subblock_size; i_value++)
+                (*appended)[i_value] = value_type(i_block, i_subblock);
+            cache2.write_subblock(bids[i_block], i_subblock, *appended);
+        }
+    }
+    // the last written subblock is cached
+    die_unequal((*cache2.get_subblock(bids[21 + cache_size], 3))[1].second, 3);
+    cache2.flush();
+    cache2.clear();
+    for (unsigned i_block = 20; i_block < 20 + cache_size + 2; i_block++) {
+        for (unsigned i_subblock = 0; i_subblock < 4; i_subblock++) {
+            subblock_type* subblock = cache2.get_subblock(bids[i_block], i_subblock);
+            die_unequal((*subblock)[subblock_size - 1].first, static_cast<int>(i_block));
+            die_unequal((*subblock)[subblock_size - 1].second, static_cast<int>(i_subblock));
+        }
+    }
+    delete appended;
     delete block;
 
     LOG1 << "Passed Block-Cache Test";
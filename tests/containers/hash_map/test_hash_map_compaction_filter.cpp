@@ -0,0 +1,128 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_hash_map_compaction_filter.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl.h>
+#include <stxxl/comparator>
+
+#include <hash_fib.h>
+
+using cmp = stxxl::comparator<int>;
+
+//! the mapped value is a timestamp
+using unordered_map = stxxl::unordered_map<int, int, hash_fib, cmp, 4* 1024, 4>;
+using ref_type = std::map<int, int>;
+
+void check_equal(const unordered_map& map, const ref_type& ref)
+{
+    die_unequal(map.size(), ref.size());
+
+    size_t n = 0;
+    for (unordered_map::const_iterator it = map.begin(); it != map.end(); ++it)
+    {
+        ref_type::const_iterator rit = ref.find(it->first);
+        die_unless(rit != ref.end());
+        die_unequal(it->second, rit->second);
+        ++n;
+    }
+    die_unequal(n, ref.size());
+}
+
+//! expires entries older than now, and refreshes the others
+struct expire
+{
+    int now;
+
+    bool operator () (const int& /* key */, int& timestamp) const
+    {
+        if (timestamp < now)
+            return false;
+        ++timestamp;
+        return true;
+    }
+};
+
+//! applies expire to the reference
+void expire_ref(ref_type& ref, int now)
+{
+    for (ref_type::iterator it = ref.begin(); it != ref.end(); )
+    {
+        if (it->second < now)
+            it = ref.erase(it);
+        else
+            ++(it++)->second;
+    }
+}
+
+int main()
+{
+    const size_t mem_to_sort = 32 * 1024 * 1024;
+    const int n_values = 50000;
+
+    unordered_map map;
+    const unordered_map& cmap = map;
+    ref_type ref;
+
+    std::vector<std::pair<int, int> > values;
+    for (int k = 0; k < n_values; ++k)
+        values.emplace_back(k, k % 100);
+    map.insert(values.begin(), values.end(), mem_to_sort);
+    ref.insert(values.begin(), values.end());
+
+    // buffered values are filtered when merged as well
+    for (int k = n_values; k < n_values + 1000; ++k)
+    {
+        map.insert_oblivious(std::make_pair(k, k % 100));
+        ref[k] = k % 100;
+    }
+    check_equal(map, ref);
+
+    unordered_map::const_iterator expired = cmap.find(10);
+    unordered_map::const_iterator kept = cmap.find(n_values + 50);
+    die_unequal(kept->second, 50);
+
+    // rehash rewrites all values
+    map.compaction_filter(expire { 30 });
+    map.rehash(map.bucket_count());
+    expire_ref(ref, 30);
+    check_equal(map, ref);
+
+    die_unless(expired == map.end());
+    die_unequal(kept->first, n_values + 50);
+    die_unequal(kept->second, 51);
+
+    // bulk insertion filters both the stored and the new values
+    values.clear();
+    for (int k = n_values + 1000; k < 2 * n_values; ++k)
+        values.emplace_back(k, k % 100);
+    map.compaction_filter(expire { 60 });
+    map.insert(values.begin(), values.end(), mem_to_sort);
+    expire_ref(ref, 60);
+    for (const auto& v : values)
+    {
+        if (v.second >= 60)
+            ref[v.first] = v.second + 1;
+    }
+    check_equal(map, ref);
+
+    // without filter values are kept
+    map.compaction_filter(unordered_map::compaction_filter_type());
+    map.rehash(map.bucket_count());
+    check_equal(map, ref);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_hash_map_linear_hashing.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl.h>
+#include <stxxl/bits/containers/hash_map/hash_map.h>
+#include <stxxl/comparator>
+
+#include <hash_fib.h>
+
+using cmp = stxxl::comparator<int>;
+using value_type = std::pair<int, int>;
+
+using hash_map = stxxl::hash_map::hash_map<int, int, hash_fib, cmp, 4* 1024, 4>;
+using const_iterator = hash_map::const_iterator;
+using ref_type = std::unordered_map<int, int>;
+
+void check_equal(const hash_map& map, const ref_type& ref, int max_key)
+{
+    die_unequal(map.size(), ref.size());
+
+    for (int k = 0; k < max_key; k += 3)
+    {
+        const_iterator it = map.find(k);
+        ref_type::const_iterator rit = ref.find(k);
+        die_unequal(it != map.end(), rit != ref.end());
+        if (rit != ref.end())
+            die_unequal((*it).second, rit->second);
+    }
+
+    // each value is visited once
+    std::vector<bool> seen(max_key, false);
+    size_t n = 0;
+    for (const_iterator it = map.begin(); it != map.end(); ++it)
+    {
+        const int key = (*it).first;
+        die_unless(!seen[key]);
+        seen[key] = true;
+        die_unequal(ref.find(key)->second, (*it).second);
+        ++n;
+    }
+    die_unequal(n, ref.size());
+}
+
+int main()
+{
+    const int n_values = 200000;
+
+    std::vector<int> keys(n_values);
+    for (int i = 0; i < n_values; ++i)
+        keys[i] = i;
+    std::mt19937 randgen(13);
+    std::shuffle(keys.begin(), keys.end(), randgen);
+
+    hash_map map;
+    const hash_map& cmap = map;
+    ref_type ref;
+
+    map.insert(value_type(keys[0], 0));
+    ref[keys[0]] = 0;
+    const_iterator cit = cmap.find(keys[0]);
+
+    // the buffer does not overflow: the table grows one bucket at a time by
+    // splitting, which keeps the load factor
+    size_t n_buckets = map.bucket_count();
+    for (int i = 1; i < n_values; ++i)
+    {
+        die_unless(map.insert(value_type(keys[i], i)).second);
+        ref[keys[i]] = i;
+
+        die_unless(map.bucket_count() <= n_buckets + 1);
+        die_unless(map.load_factor() <= map.opt_load_factor());
+        n_buckets = map.bucket_count();
+    }
+    LOG1 << "buckets after growing: " << n_buckets;
+    die_unless(n_buckets > 128);
+
+    // the iterator was moved along by all splits of its bucket
+    die_unequal((*cit).first, keys[0]);
+    die_unequal((*cit).second, 0);
+
+    check_equal(map, ref, n_values);
+
+    // erase some values, then rebuild the whole table
+    for (int i = 0; i < n_values; i += 2)
+    {
+        die_unequal(map.erase(keys[i]), 1u);
+        ref.erase(keys[i]);
+    }
+    check_equal(map, ref, n_values);
+
+    map.rehash();
+    check_equal(map, ref, n_values);
+
+    // a small buffer mixes splits with rebuilds on buffer overflow
+    map.max_buffer_size(4096 * sizeof(value_type));
+    for (int i = 0; i < n_values; i += 2)
+    {
+        map.insert_oblivious(value_type(keys[i], -i));
+        ref[keys[i]] = -i;
+    }
+    check_equal(map, ref, n_values);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
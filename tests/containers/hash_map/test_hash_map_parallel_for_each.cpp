@@ -0,0 +1,109 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_hash_map_parallel_for_each.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl.h>
+#include <stxxl/comparator>
+
+#include <hash_fib.h>
+
+using cmp = stxxl::comparator<int>;
+
+using unordered_map = stxxl::unordered_map<int, int, hash_fib, cmp, 4* 1024, 4>;
+
+//! counts the visits of each key and sums up the mapped values
+struct visitor
+{
+    std::vector<std::atomic<int> >& visits;
+    std::atomic<long>& sum;
+
+    void operator () (const unordered_map::value_type& v) const
+    {
+        ++visits[v.first];
+        sum += v.second;
+    }
+};
+
+//! checks that parallel_for_each visits exactly the values a serial scan does
+void check(const unordered_map& map, int max_key, size_t num_threads)
+{
+    std::vector<std::atomic<int> > visits(max_key);
+    for (auto& v : visits)
+        v = 0;
+    std::atomic<long> sum(0);
+
+    map.parallel_for_each(visitor { visits, sum }, num_threads);
+
+    std::vector<int> ref(max_key, 0);
+    long ref_sum = 0;
+    for (unordered_map::const_iterator it = map.begin(); it != map.end(); ++it)
+    {
+        ++ref[it->first];
+        ref_sum += it->second;
+    }
+
+    for (int k = 0; k < max_key; ++k)
+        die_unequal(visits[k].load(), ref[k]);
+    die_unequal(sum.load(), ref_sum);
+}
+
+int main()
+{
+    const size_t mem_to_sort = 32 * 1024 * 1024;
+    const int n_values = 100000;
+
+    unordered_map map;
+
+    // an empty map
+    check(map, n_values, 0);
+
+    std::vector<std::pair<int, int> > values;
+    for (int k = 0; k < n_values; k += 2)
+        values.emplace_back(k, k);
+    map.insert(values.begin(), values.end(), mem_to_sort);
+
+    // buffered values, overridden values and deletions are merged
+    for (int k = 1; k < 2000; k += 2)
+        map.insert_oblivious(std::make_pair(k, k));
+    for (int k = 0; k < 1000; k += 4)
+        map.insert_oblivious(std::make_pair(k, -k));
+    for (int k = 2000; k < 3000; k += 2)
+        map.erase(k);
+
+    check(map, n_values, 0);
+    check(map, n_values, 1);
+    check(map, n_values, 3);
+
+    // also with a number of buckets which is not a power of two
+    map.rehash(map.bucket_count() + 37);
+    check(map, n_values, 0);
+
+    // most ranges start with buckets without external values, whose block
+    // index lies past the last block
+    unordered_map sparse;
+    std::vector<std::pair<int, int> > few;
+    for (int k = 0; k < 16; ++k)
+        few.emplace_back(k, k);
+    sparse.insert(few.begin(), few.end(), mem_to_sort);
+    for (int k = 16; k < 5000; ++k)
+        sparse.insert_oblivious(std::make_pair(k, k));
+
+    check(sparse, n_values, 3);
+    check(sparse, n_values, 8);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
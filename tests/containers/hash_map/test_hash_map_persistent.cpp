@@ -0,0 +1,135 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_hash_map_persistent.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl.h>
+#include <stxxl/comparator>
+
+struct hash_int
+{
+    size_t operator () (int key) const
+    {
+        // a simple integer hash function
+        return static_cast<size_t>(key * 2654435761u);
+    }
+};
+
+using cmp = stxxl::comparator<int>;
+
+using unordered_map = stxxl::unordered_map<int, int, hash_int, cmp, 4* 1024, 4>;
+using ref_type = std::map<int, int>;
+
+foxxll::file_ptr open_file(const char* fn, bool truncate)
+{
+    return foxxll::create_file(
+        "syscall", fn,
+        foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR
+        | (truncate ? foxxll::file::TRUNC : 0));
+}
+
+void check_equal(const unordered_map& map, const ref_type& ref)
+{
+    die_unequal(map.size(), ref.size());
+
+    for (int k = 0; k < 100000; k += 7)
+    {
+        unordered_map::const_iterator it = map.find(k);
+        ref_type::const_iterator rit = ref.find(k);
+        die_unequal(it != map.end(), rit != ref.end());
+        if (rit != ref.end())
+            die_unequal(it->second, rit->second);
+    }
+
+    size_t n = 0;
+    for (unordered_map::const_iterator it = map.begin(); it != map.end(); ++it)
+    {
+        die_unequal(ref.find(it->first)->second, it->second);
+        ++n;
+    }
+    die_unequal(n, ref.size());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " tempfile" << std::endl;
+        return -1;
+    }
+
+    const size_t mem_to_sort = 32 * 1024 * 1024;
+    ref_type ref;
+
+    // bulk insert into external memory, then buffer a few changes
+    {
+        unordered_map map(open_file(argv[1], true));
+        die_unless(map.persistent());
+        die_unless(map.empty());
+
+        std::vector<std::pair<int, int> > values;
+        for (int k = 0; k < 100000; k += 2)
+            values.emplace_back(k, k + 1);
+        map.insert(values.begin(), values.end(), mem_to_sort);
+        ref.insert(values.begin(), values.end());
+
+        for (int k = 1; k < 1000; k += 2)
+        {
+            map.insert_oblivious(std::make_pair(k, k));
+            ref[k] = k;
+        }
+        for (int k = 2000; k < 3000; k += 2)
+        {
+            map.erase(k);
+            ref.erase(k);
+        }
+        check_equal(map, ref);
+    }
+
+    // reopen, the buffered changes and deletions are restored
+    {
+        unordered_map map(open_file(argv[1], false));
+        check_equal(map, ref);
+
+        map[5001] = 17;
+        ref[5001] = 17;
+        map.sync();
+
+        // rebuilding moves all values to new blocks in the file
+        map.rehash(map.bucket_count() * 2);
+        check_equal(map, ref);
+    }
+
+    {
+        unordered_map map(open_file(argv[1], false));
+        check_equal(map, ref);
+
+        map.clear();
+        ref.clear();
+        map[42] = 43;
+        ref[42] = 43;
+    }
+
+    {
+        unordered_map map(open_file(argv[1], false));
+        check_equal(map, ref);
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *  tests/containers/test_map_cache_resize.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_map_cache_resize.cpp
+//! This is an example of resizing the caches of a \c stxxl::map at runtime
+//! and of pinning the upper levels of the tree.
+
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = unsigned int;
+using data_type = unsigned int;
+using cmp = stxxl::comparator<key_type>;
+
+#define BLOCK_SIZE (4 * 1024)
+
+using map_type = stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE>;
+
+const key_type n = 200000;
+
+//! random lookups, the map contains the even keys k with data k / 2
+void lookup(const map_type& map, unsigned seed)
+{
+    std::mt19937 randgen(seed);
+    std::uniform_int_distribution<key_type> distr(0, 2 * n);
+
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        const key_type k = distr(randgen);
+        map_type::const_iterator it = map.find(k);
+        die_unequal(it != map.end(), k % 2 == 0);
+        if (k % 2 == 0)
+            die_unequal(it->second, k / 2);
+    }
+}
+
+int main()
+{
+    // small nodes and leaves, such that the tree has inner node levels
+    map_type map(16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+    const map_type& cmap = map;
+
+    die_unequal(map.pinned_fraction(), 0.5);
+
+    for (key_type i = 0; i < n; ++i)
+        map[2 * i] = i;
+    lookup(cmap, 1);
+
+    // the statistics report the pinned nodes and the hits per level
+    {
+        std::ostringstream os;
+        map.print_statistics(os);
+        LOG1 << os.str();
+        die_unless(os.str().find("Pinned blocks") != std::string::npos);
+        die_unless(os.str().find("Level 2 found blocks") != std::string::npos);
+    }
+
+    // grow the caches, then shrink them below their contents, which writes
+    // back the modified nodes and leaves in excess
+    map.resize_caches(64 * BLOCK_SIZE, 64 * BLOCK_SIZE);
+    lookup(cmap, 2);
+    for (key_type i = 0; i < n; i += 3)
+        map[2 * i] = i;
+
+    map.resize_caches(8 * BLOCK_SIZE, 4 * BLOCK_SIZE);
+    lookup(cmap, 3);
+
+    // without pinning and with the whole cache reserved for the upper levels
+    map.pinned_fraction(0.0);
+    lookup(cmap, 4);
+    map.pinned_fraction(1.0);
+    lookup(cmap, 5);
+    for (key_type i = 0; i < n; i += 5)
+        map[2 * i] = i;
+    lookup(cmap, 6);
+
+    die_unequal(map.size(), n);
+
+    bool thrown = false;
+    try {
+        map.pinned_fraction(1.5);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  tests/containers/test_map_cursor.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_map_cursor.cpp
+//! This is an example of unregistered cursors and range scans with
+//! for_range() on a \c stxxl::map.
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = unsigned int;
+using data_type = unsigned int;
+using cmp = stxxl::comparator<key_type>;
+
+#define BLOCK_SIZE (4 * 1024)
+
+using map_type = stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE>;
+
+int main()
+{
+    const key_type n = 100000;
+
+    map_type map(64 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+
+    // even keys 0, 2, ..., 2n - 2
+    for (key_type i = 0; i < n; ++i)
+        map[2 * i] = i;
+
+    // range scans
+    {
+        key_type expected = 1000;
+        map.for_range(1000, 51001, [&](const map_type::value_type& v) {
+                          die_unequal(v.first, expected);
+                          die_unequal(v.second, expected / 2);
+                          expected += 2;
+                      });
+        die_unequal(expected, 51002u);
+
+        size_t count = 0;
+        map.for_range(0, 2 * n, [&](const map_type::value_type&) { ++count; });
+        die_unequal(count, map.size());
+
+        count = 0;
+        map.for_range(7, 7, [&](const map_type::value_type&) { ++count; });
+        map.for_range(2 * n, 4 * n, [&](const map_type::value_type&) { ++count; });
+        die_unequal(count, 0u);
+    }
+
+    // full scan with a cursor
+    {
+        map_type::cursor_type c = map.lower_bound_cursor(0);
+        key_type expected = 0;
+        for ( ; !c.empty(); ++c)
+        {
+            die_unequal(c->first, expected);
+            expected += 2;
+        }
+        die_unequal(expected, 2 * n);
+    }
+
+    // cursors positioned between keys
+    {
+        map_type::cursor_type c = map.lower_bound_cursor(1001);
+        die_unless(!c.empty());
+        die_unequal(c->first, 1002u);
+
+        die_unless(map.lower_bound_cursor(2 * n).empty());
+    }
+
+    // cursors survive modifications of the map
+    {
+        map_type::cursor_type c = map.lower_bound_cursor(5000);
+        die_unequal(c->first, 5000u);
+
+        // shift the elements of the leaf
+        map[4999] = 0;
+        die_unequal(c->first, 5000u);
+
+        // erase the current element, the cursor moves on
+        map.erase(5000);
+        die_unequal(c->first, 5002u);
+
+        // split leaves by inserting odd keys
+        for (key_type k = 3001; k < 9001; k += 2)
+            map[k] = 0;
+        die_unequal(c->first, 5002u);
+        ++c;
+        die_unequal(c->first, 5003u);
+
+        // fuse leaves by erasing a large range
+        for (key_type k = 5004; k < 60000; ++k)
+            map.erase(k);
+        ++c;
+        die_unequal(c->first, 60000u);
+
+        // scan to the end
+        size_t count = 0;
+        for ( ; !c.empty(); ++c)
+            ++count;
+        die_unequal(count, static_cast<size_t>(n - 30000));
+
+        // clear() deallocates all leaves
+        map_type::cursor_type d = map.lower_bound_cursor(100000);
+        map.clear();
+        die_unless(d.empty());
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
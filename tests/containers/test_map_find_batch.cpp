@@ -0,0 +1,104 @@
+/***************************************************************************
+ *  tests/containers/test_map_find_batch.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_map_find_batch.cpp
+//! This is an example of batched lookups with find_batch() on a
+//! \c stxxl::map.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = unsigned int;
+using data_type = unsigned int;
+using cmp = stxxl::comparator<key_type>;
+
+#define BLOCK_SIZE (4 * 1024)
+
+using map_type = stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE>;
+
+void check_batch(const map_type& map, const std::vector<key_type>& keys)
+{
+    std::vector<std::pair<bool, data_type> > out;
+    map.find_batch(keys, out);
+    die_unequal(out.size(), keys.size());
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        // the map contains the even keys k with data k / 2
+        const bool expected = (keys[i] % 2 == 0) && (keys[i] < 400000);
+        die_unequal(out[i].first, expected);
+        if (expected)
+            die_unequal(out[i].second, keys[i] / 2);
+    }
+}
+
+int main()
+{
+    const key_type n = 200000;
+
+    // small nodes and leaves, such that the tree has inner node levels
+    map_type map(16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+
+    for (key_type i = 0; i < n; ++i)
+        map[2 * i] = i;
+
+    // empty batch
+    check_batch(map, std::vector<key_type>());
+
+    // random sorted batch with duplicates and missing keys
+    {
+        std::mt19937 randgen(42);
+        std::uniform_int_distribution<key_type> distr(0, 2 * n + 100);
+
+        std::vector<key_type> keys(50000);
+        for (key_type& k : keys)
+            k = distr(randgen);
+        std::sort(keys.begin(), keys.end());
+
+        check_batch(map, keys);
+    }
+
+    // dense batch touching all leaves
+    {
+        std::vector<key_type> keys;
+        for (key_type k = 0; k < 2 * n + 10; k += 3)
+            keys.push_back(k);
+
+        check_batch(map, keys);
+    }
+
+    // batch after erasing keys, which leaves stale splitters
+    for (key_type k = 1000; k < 300000; k += 2)
+        map.erase(k);
+
+    {
+        std::vector<key_type> keys;
+        for (key_type k = 900; k < 300100; k += 7)
+            keys.push_back(k);
+
+        std::vector<std::pair<bool, data_type> > out;
+        map.find_batch(keys, out);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const bool expected = (keys[i] % 2 == 0) && (keys[i] < 1000 || keys[i] >= 300000);
+            die_unequal(out[i].first, expected);
+        }
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
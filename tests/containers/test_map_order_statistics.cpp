@@ -0,0 +1,138 @@
+/***************************************************************************
+ *  tests/containers/test_map_order_statistics.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_map_order_statistics.cpp
+//! This is an example of rank and select queries on a \c stxxl::map which
+//! keeps order statistics.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = unsigned int;
+using data_type = unsigned int;
+using cmp = stxxl::comparator<key_type>;
+
+#define BLOCK_SIZE (4 * 1024)
+
+using map_type = stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE,
+                            foxxll::simple_random, true>;
+
+// forced instantiation
+template class stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE,
+                          foxxll::simple_random, true>;
+
+//! checks the queries against the sorted keys contained in the map
+void check_queries(const map_type& map, const std::vector<key_type>& keys)
+{
+    die_unequal(map.size(), keys.size());
+
+    std::mt19937 randgen(7);
+    const key_type max_key = keys.empty() ? 10 : keys.back() + 10;
+    std::uniform_int_distribution<key_type> distr(0, max_key);
+
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        const key_type k = distr(randgen);
+        const size_t expected_rank =
+            std::lower_bound(keys.begin(), keys.end(), k) - keys.begin();
+        die_unequal(map.rank(k), expected_rank);
+
+        const key_type l = distr(randgen);
+        const size_t expected_count = (k < l)
+                                      ? std::lower_bound(keys.begin(), keys.end(), l) - keys.begin() - expected_rank
+                                      : 0;
+        die_unequal(map.count_range(k, l), expected_count);
+    }
+
+    for (size_t i = 0; i < keys.size(); i += 97)
+    {
+        map_type::const_iterator it = map.nth(i);
+        die_unless(it != map.end());
+        die_unequal(it->first, keys[i]);
+    }
+    if (!keys.empty())
+        die_unequal(map.nth(keys.size() - 1)->first, keys.back());
+    die_unless(map.nth(keys.size()) == map.end());
+}
+
+int main()
+{
+    const size_t n = 200000;
+
+    // insert keys in random order, splitting leaves and nodes
+    std::vector<key_type> keys(n);
+    for (size_t i = 0; i < n; ++i)
+        keys[i] = static_cast<key_type>(3 * i);
+
+    std::mt19937 randgen(42);
+    std::shuffle(keys.begin(), keys.end(), randgen);
+
+    map_type map(16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+    for (const key_type& k : keys)
+        map[k] = k;
+
+    std::sort(keys.begin(), keys.end());
+    check_queries(map, keys);
+
+    // erase two thirds of the keys, fusing and balancing leaves and nodes
+    {
+        std::vector<key_type> remaining;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (i % 3 == 1)
+                remaining.push_back(keys[i]);
+            else
+                map.erase(keys[i]);
+        }
+        keys.swap(remaining);
+    }
+    check_queries(map, keys);
+
+    // erasing a missing key changes no counts
+    map.erase(1);
+    check_queries(map, keys);
+
+    // bulk construction from a sorted range
+    {
+        std::vector<std::pair<key_type, data_type> > values;
+        for (size_t i = 0; i < n; ++i)
+            values.emplace_back(static_cast<key_type>(2 * i), 0);
+
+        map_type bulk(values.begin(), values.end(),
+                      16 * BLOCK_SIZE, 16 * BLOCK_SIZE, true);
+
+        std::vector<key_type> bulk_keys;
+        for (const auto& v : values)
+            bulk_keys.push_back(v.first);
+        check_queries(bulk, bulk_keys);
+
+        // inserting after bulk construction
+        for (key_type k = 1; k < 20001; k += 2)
+        {
+            bulk[k] = 0;
+            bulk_keys.push_back(k);
+        }
+        std::sort(bulk_keys.begin(), bulk_keys.end());
+        check_queries(bulk, bulk_keys);
+    }
+
+    map.clear();
+    check_queries(map, std::vector<key_type>());
+
+    LOG1 << "Test passed.";
+    return 0;
+}
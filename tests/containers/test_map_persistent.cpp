@@ -0,0 +1,164 @@
+/***************************************************************************
+ *  tests/containers/test_map_persistent.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_map_persistent.cpp
+//! This is an example of a \c stxxl::map bound to a file, which is reopened
+//! with its contents.
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = unsigned int;
+using data_type = unsigned int;
+using cmp = stxxl::comparator<key_type>;
+
+#define BLOCK_SIZE (4 * 1024)
+
+using map_type = stxxl::map<key_type, data_type, cmp, BLOCK_SIZE, BLOCK_SIZE>;
+using ref_type = std::map<key_type, data_type>;
+
+foxxll::file_ptr open_file(const char* fn, bool truncate)
+{
+    return foxxll::create_file(
+        "syscall", fn,
+        foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR
+        | (truncate ? foxxll::file::TRUNC : 0));
+}
+
+void check_equal(const map_type& map, const ref_type& ref)
+{
+    die_unequal(map.size(), ref.size());
+
+    map_type::const_iterator it = map.begin();
+    for (const auto& v : ref)
+    {
+        die_unless(it != map.end());
+        die_unequal(it->first, v.first);
+        die_unequal(it->second, v.second);
+        ++it;
+    }
+    die_unless(it == map.end());
+
+    for (key_type k = 0; k < 1000; ++k)
+        die_unequal(map.find(k) != map.end(), ref.find(k) != ref.end());
+}
+
+void modify(map_type& map, ref_type& ref, unsigned seed, size_t n)
+{
+    std::mt19937 randgen(seed);
+    std::uniform_int_distribution<key_type> distr(0, 500000);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const key_type k = distr(randgen);
+        if (i % 4 == 3)
+        {
+            map.erase(k);
+            ref.erase(k);
+        }
+        else
+        {
+            map[k] = static_cast<data_type>(i);
+            ref[k] = static_cast<data_type>(i);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " tempfile" << std::endl;
+        return -1;
+    }
+
+    ref_type ref;
+
+    // fill a new map, which is written by the destructor
+    {
+        map_type map(open_file(argv[1], true), 16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+        die_unless(map.persistent());
+        die_unless(map.empty());
+        modify(map, ref, 1, 100000);
+        check_equal(map, ref);
+    }
+
+    // reopen, modify and sync explicitly
+    {
+        map_type map(open_file(argv[1], false), 16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+        check_equal(map, ref);
+
+        modify(map, ref, 2, 50000);
+        map.sync();
+        check_equal(map, ref);
+
+        // changes after sync() are written by the destructor
+        modify(map, ref, 3, 1000);
+    }
+
+    {
+        map_type map(open_file(argv[1], false), 16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+        check_equal(map, ref);
+
+        // erase most elements, leaves and nodes are freed in the file
+        std::vector<key_type> keys;
+        for (const auto& v : ref)
+            keys.push_back(v.first);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (i % 8 != 0)
+            {
+                map.erase(keys[i]);
+                ref.erase(keys[i]);
+            }
+        }
+        check_equal(map, ref);
+    }
+
+    // the freed blocks are reused
+    {
+        map_type map(open_file(argv[1], false), 16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+        check_equal(map, ref);
+        modify(map, ref, 4, 20000);
+        check_equal(map, ref);
+    }
+
+    // bulk construction discards the previous contents of the file
+    {
+        std::vector<std::pair<key_type, data_type> > values;
+        for (key_type k = 0; k < 200000; ++k)
+            values.emplace_back(3 * k, k);
+
+        map_type map(open_file(argv[1], false), values.begin(), values.end(),
+                     16 * BLOCK_SIZE, 16 * BLOCK_SIZE, true);
+
+        ref.clear();
+        ref.insert(values.begin(), values.end());
+        check_equal(map, ref);
+    }
+    {
+        map_type map(open_file(argv[1], false), 16 * BLOCK_SIZE, 16 * BLOCK_SIZE);
+        check_equal(map, ref);
+        die_unequal(map.lower_bound(301)->first, 303u);
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *  tests/containers/test_vector_async.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type, 2, stxxl::lru_pager<2> >;
+
+static const size_t block_size = vector_type::block_type::size;
+
+int main()
+{
+    const size_t n = 256 * block_size - 7;
+
+    vector_type v(n);
+    {
+        vector_type::bufwriter_type writer(v);
+        for (size_t i = 0; i < n; ++i)
+            writer << value_type(i);
+    }
+
+    // a cached, dirty page is answered from the page cache
+    v[5] = 42;
+
+    stxxl::io_account* account = stxxl::io_accounts::get_instance()->get("async_reader");
+    v.set_io_account(account);
+
+    std::mt19937_64 rng(1234);
+    std::vector<size_t> indexes(8 * n / block_size);
+    for (size_t& i : indexes)
+        i = rng() % n;
+    indexes.push_back(5);
+
+    size_t n_callbacks = 0;
+    {
+        vector_type::async_reader_type reader(v, 16);
+        for (const size_t& i : indexes)
+        {
+            reader.async_get(
+                i, [&n_callbacks, i](const value_type& value) {
+                    ++n_callbacks;
+                    die_unequal(value, i == 5 ? 42 : i);
+                });
+            die_unless(reader.in_flight() <= 16);
+            reader.poll();
+        }
+        reader.wait_all();
+        die_unequal(reader.in_flight(), 0u);
+    }
+    die_unequal(n_callbacks, indexes.size());
+
+    // at most one block read per lookup, shared by lookups of the same block
+    die_unless(account->blocks_read() > 0);
+    die_unless(account->blocks_read() <= indexes.size());
+    die_unequal(account->bytes_read(), account->blocks_read() * block_size * sizeof(value_type));
+
+    // callbacks issue the next lookups, also while all buffers are in flight
+    for (size_t max_in_flight : { 1, 4 })
+    {
+        vector_type::async_reader_type reader(v, max_in_flight);
+        size_t n_chained = 0;
+        const size_t n_chain = 1000;
+
+        std::function<void(size_t)> chain =
+            [&](size_t i) {
+                reader.async_get(
+                    i, [&, i](const value_type& value) {
+                        die_unequal(value, i == 5 ? 42 : i);
+                        if (++n_chained < n_chain)
+                            chain((i * 7919 + 3 * block_size) % n);
+                    });
+            };
+
+        for (size_t k = 0; k < 2 * max_in_flight; ++k)
+            chain(k * 17 * block_size % n);
+        reader.wait_all();
+        die_unless(n_chained >= n_chain);
+        die_unequal(reader.in_flight(), 0u);
+    }
+
+    LOG1 << "Test passed.";
+    return 0;
+}
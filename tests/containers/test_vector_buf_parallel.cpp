@@ -0,0 +1,134 @@
+/***************************************************************************
+ *  tests/containers/test_vector_buf_parallel.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/vector>
+
+using vector_type = stxxl::vector<uint64_t>;
+using bufwriter_type = vector_type::bufwriter_type;
+
+static const size_t block_size = vector_type::block_type::size;
+
+void check_vector(const vector_type& v)
+{
+    vector_type::bufreader_type reader(v);
+    for (uint64_t i = 0; i < v.size(); ++i, ++reader)
+        die_unequal(*reader, i);
+}
+
+//! checks that fn throws an Exception
+template <typename Exception, typename Functor>
+void check_throws(Functor fn)
+{
+    bool thrown = false;
+    try {
+        fn();
+    }
+    catch (const Exception&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+}
+
+//! the vector grows several times, with blocks allocated in the background
+void test_growing(size_t size)
+{
+    vector_type vec;
+    {
+        bufwriter_type writer(vec);
+        for (uint64_t i = 0; i < size; ++i)
+            writer << i;
+    }
+    die_unequal(vec.size(), size);
+    check_vector(vec);
+
+    // append to the vector, the blocks of a growth which does not happen are
+    // released
+    {
+        bufwriter_type writer(vec.end());
+        for (uint64_t i = size; i < size + size / 2 + 17; ++i)
+            writer << i;
+    }
+    die_unequal(vec.size(), size + size / 2 + 17);
+    check_vector(vec);
+}
+
+//! disjoint ranges of the vector are written by several threads
+void test_parallel(size_t size, size_t num_threads)
+{
+    vector_type vec(size);
+
+    // ranges are multiples of blocks, the last one ends at the vector's end
+    const size_t nblocks = (size + block_size - 1) / block_size;
+    std::vector<std::unique_ptr<bufwriter_type> > writers;
+    std::vector<size_t> begins;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        const size_t begin = std::min(size, t * nblocks / num_threads * block_size);
+        const size_t end = std::min(size, (t + 1) * nblocks / num_threads * block_size);
+        writers.emplace_back(
+            new bufwriter_type(vec.begin() + begin, vec.begin() + end, 4));
+        begins.push_back(begin);
+    }
+    begins.push_back(size);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]() {
+                for (uint64_t i = begins[t]; i < begins[t + 1]; ++i)
+                    *writers[t] << i;
+                writers[t]->finish();
+            });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    writers.clear();
+
+    die_unequal(vec.size(), size);
+    check_vector(vec);
+
+    // the writers do not write beyond their range
+    {
+        bufwriter_type writer(vec.begin(), vec.begin() + block_size);
+        for (uint64_t i = 0; i < block_size; ++i)
+            writer << i;
+        check_throws<std::out_of_range>([&]() { writer << 0; });
+    }
+    check_vector(vec);
+
+    // ranges must be block aligned
+    check_throws<foxxll::bad_parameter>(
+        [&]() { bufwriter_type writer(vec.begin() + 1, vec.end()); });
+    check_throws<foxxll::bad_parameter>(
+        [&]() { bufwriter_type writer(vec.begin(), vec.begin() + block_size + 1); });
+}
+
+int main()
+{
+    test_growing(64 * block_size + 123);
+    test_parallel(64 * block_size + 123, 4);
+    test_parallel(3 * block_size, 8);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  tests/containers/test_vector_cow.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example containers/test_vector_cow.cpp
+//! This is an example of copy-on-write sharing of blocks between
+//! \c stxxl::vector copies and slices.
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/shared_blocks.h>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type, 2, stxxl::lru_pager<2> >;
+
+static const size_t block_size = vector_type::block_type::size;
+
+//! check that v[i] == i + offset, except for the position of a changed value
+void check_contents(const vector_type& v, value_type offset,
+                    size_t changed_pos = size_t(-1), value_type changed_value = 0)
+{
+    vector_type::bufreader_type reader(v);
+    for (size_t i = 0; i < v.size(); ++i, ++reader)
+    {
+        if (i == changed_pos)
+            die_unless(*reader == changed_value);
+        else
+            die_unless(*reader == i + offset);
+    }
+}
+
+int main()
+{
+    stxxl::shared_blocks* sb = stxxl::shared_blocks::get_instance();
+
+    const size_t nblocks = 64;
+    const size_t n = nblocks * block_size - 7;
+
+    vector_type v(n);
+    {
+        vector_type::bufwriter_type writer(v);
+        for (size_t i = 0; i < n; ++i)
+            writer << value_type(i);
+    }
+
+    {
+        // copy shares all blocks
+        vector_type c(v);
+        die_unless(c.size() == v.size());
+        die_unless(sb->size() == nblocks);
+        check_contents(c, 0);
+
+        // a write to one element copies only the blocks of its page
+        v[3 * block_size + 5] = 42;
+        v.flush();
+        die_unless(sb->size() >= nblocks - 2);
+        die_unless(sb->size() < nblocks);
+        check_contents(v, 0, 3 * block_size + 5, 42);
+        check_contents(c, 0);
+
+        // writing through the copy leaves the original unchanged
+        c[0] = 23;
+        check_contents(c, 0, 0, 23);
+        check_contents(v, 0, 3 * block_size + 5, 42);
+
+        // overwrite the original with direct block access
+        {
+            vector_type::bufwriter_type writer(v);
+            for (size_t i = 0; i < n; ++i)
+                writer << value_type(i + 1000);
+        }
+        die_unless(sb->size() == 0);
+        check_contents(v, 1000);
+        check_contents(c, 0, 0, 23);
+    }
+    die_unless(sb->size() == 0);
+
+    {
+        // block aligned slice shares blocks
+        vector_type s = v.subvector(2 * block_size, 10 * block_size + 3);
+        die_unless(s.size() == 8 * block_size + 3);
+        die_unless(sb->size() == 9);
+        check_contents(s, 1000 + 2 * block_size);
+
+        s[block_size] = 7;
+        check_contents(s, 1000 + 2 * block_size, block_size, 7);
+        check_contents(v, 1000);
+
+        // unaligned slice copies elements
+        vector_type u;
+        u.assign(v.cbegin() + 5, v.cbegin() + 5 + 3 * block_size);
+        die_unless(u.size() == 3 * block_size);
+        check_contents(u, 1005);
+
+        // assign a whole vector
+        u.assign(v.cbegin(), v.cend());
+        die_unless(u.size() == v.size());
+        check_contents(u, 1000);
+
+        // release the original first, the copies keep the blocks alive
+        v.clear();
+        check_contents(u, 1000);
+        check_contents(s, 1000 + 2 * block_size, block_size, 7);
+    }
+    die_unless(sb->size() == 0);
+
+    LOG1 << "Copy-on-write test passed.";
+
+    return 0;
+}
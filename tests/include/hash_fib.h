@@ -0,0 +1,28 @@
+/***************************************************************************
+ *  tests/include/hash_fib.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_TESTS_HASH_FIB_HEADER
+#define STXXL_TESTS_HASH_FIB_HEADER
+
+#include <cstddef>
+#include <cstdint>
+
+//! Fibonacci hashing of int keys, which spreads the keys over the high bits
+//! used by the hash_map's linear hashing.
+struct hash_fib
+{
+    size_t operator () (int key) const
+    {
+        return static_cast<size_t>(
+            static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+#endif // !STXXL_TESTS_HASH_FIB_HEADER
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *  tests/stream/test_multiway_merge.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_multiway_merge.cpp
+//! This is an example of how to merge sorted streams directly with
+//! \c stxxl::stream::merge()
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+//! key and number of the input
+using value_type = std::pair<uint32_t, uint32_t>;
+using vector_type = stxxl::vector<value_type>;
+using stream_type = stxxl::stream::vector_iterator2stream<vector_type::const_iterator>;
+
+//! compares keys only, so stability can be checked by the input numbers
+struct key_less
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a.first < b.first;
+    }
+};
+
+void fill_sorted(vector_type& v, size_t n, uint32_t input, std::mt19937& rng)
+{
+    std::uniform_int_distribution<uint32_t> distr(0, 1000);
+    std::vector<value_type> tmp(n);
+    for (size_t i = 0; i < n; ++i)
+        tmp[i] = value_type(distr(rng), input);
+    std::sort(tmp.begin(), tmp.end());
+
+    v.resize(n);
+    std::copy(tmp.begin(), tmp.end(), v.begin());
+}
+
+//! checks that the merged stream is sorted by key and stable
+template <typename Stream>
+void check_merged(Stream& merged, size_t n)
+{
+    size_t count = 0;
+    value_type prev(0, 0);
+    for ( ; !merged.empty(); ++merged, ++count)
+    {
+        die_unless(prev.first < merged->first ||
+                   (prev.first == merged->first && prev.second <= merged->second));
+        prev = *merged;
+    }
+    die_unless(count == n);
+}
+
+void test_variadic(size_t n0, size_t n1, size_t n2)
+{
+    LOG1 << "variadic n0=" << n0 << " n1=" << n1 << " n2=" << n2;
+
+    std::mt19937 rng(n0 + n1 + n2);
+    vector_type v0, v1;
+    fill_sorted(v0, n0, 0, rng);
+    fill_sorted(v1, n1, 1, rng);
+
+    std::vector<value_type> v2(n2);
+    std::copy(v1.cbegin(), v1.cbegin() + std::min(n1, n2), v2.begin());
+    for (size_t i = std::min(n1, n2); i < n2; ++i)
+        v2[i] = value_type(1001, 2);
+    for (value_type& x : v2)
+        x.second = 2;
+
+    stream_type s0(v0.cbegin(), v0.cend());
+    stream_type s1(v1.cbegin(), v1.cend());
+    // an input of a different stream type
+    auto s2 = stxxl::stream::streamify(v2.begin(), v2.end());
+
+    auto merged = stxxl::stream::merge<key_less>(s0, s1, s2);
+    check_merged(merged, n0 + n1 + n2);
+}
+
+void test_runtime(size_t k, size_t n)
+{
+    LOG1 << "runtime k=" << k << " n=" << n;
+
+    std::mt19937 rng(static_cast<uint32_t>(k + n));
+    std::vector<vector_type> vectors(k);
+    size_t total = 0;
+    for (size_t i = 0; i < k; ++i)
+    {
+        // every third input is empty
+        const size_t ni = (i % 3 == 1) ? 0 : n + i;
+        fill_sorted(vectors[i], ni, static_cast<uint32_t>(i), rng);
+        total += ni;
+    }
+
+    std::vector<stream_type> streams;
+    streams.reserve(k);
+    for (size_t i = 0; i < k; ++i)
+        streams.emplace_back(vectors[i].cbegin(), vectors[i].cend());
+
+    auto merged = stxxl::stream::merge<key_less>(streams);
+    check_merged(merged, total);
+}
+
+int main()
+{
+    test_variadic(0, 0, 0);
+    test_variadic(10000, 0, 7);
+    test_variadic(10000, 20000, 5000);
+
+    test_runtime(1, 1000);
+    test_runtime(2, 0);
+    test_runtime(5, 3000);
+    test_runtime(17, 10000);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/***************************************************************************
+ *  tests/stream/test_partition.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_partition.cpp
+//! This is an example of how to distribute a stream into buckets with
+//! \c stxxl::stream::partition()
+
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+
+//! stream of the first n numbers
+class first_n
+{
+public:
+    using value_type = ::value_type;
+
+    explicit first_n(size_t n) : m_value(0), m_n(n) { }
+
+    const value_type& operator * () const { return m_value; }
+
+    first_n& operator ++ ()
+    {
+        ++m_value;
+        return *this;
+    }
+
+    bool empty() const { return m_value >= m_n; }
+
+private:
+    value_type m_value;
+    size_t m_n;
+};
+
+void test_partition(size_t n, size_t k)
+{
+    LOG1 << "n=" << n << " k=" << k;
+
+    first_n input(n);
+    std::vector<vector_type> buckets(k);
+
+    // skewed classifier: bucket 0 receives about half of the elements
+    auto classifier = [k](const value_type& x) -> size_t {
+                          return (x % 2 == 0) ? 0 : (x / 2) % k;
+                      };
+
+    stxxl::stream::partition(input, classifier, buckets);
+
+    size_t total = 0;
+    for (size_t b = 0; b < k; ++b)
+    {
+        // each bucket holds its elements in input order
+        value_type prev = 0;
+        bool first = true;
+
+        auto in = stxxl::stream::streamify(buckets[b].cbegin(), buckets[b].cend());
+        for ( ; !in.empty(); ++in)
+        {
+            die_unless(classifier(*in) == b);
+            die_unless(first || prev < *in);
+            prev = *in;
+            first = false;
+        }
+        total += buckets[b].size();
+    }
+    die_unless(total == n);
+}
+
+int main()
+{
+    test_partition(0, 3);
+    test_partition(1000, 1);
+    test_partition(100000, 7);
+    test_partition(1000000, 64);
+
+    return 0;
+}
@@ -58,16 +58,10 @@ using SortedRunsType = CreateRunsAlg::sorted_runs_type;
 // forced instantiation
 template class stxxl::stream::runs_merger<SortedRunsType, Cmp>;
 
-int main()
+void test_push_sort(unsigned input_size, size_t runs_memory, size_t merger_memory)
 {
-#if STXXL_PARALLEL_MULTIWAY_MERGE
-    LOG1 << "STXXL_PARALLEL_MULTIWAY_MERGE";
-#endif
-
-    unsigned input_size = (10 * megabyte / sizeof(value_type));
-
     Cmp c;
-    CreateRunsAlg SortedRuns(c, 10 * megabyte);
+    CreateRunsAlg SortedRuns(c, runs_memory);
     value_type checksum_before(0);
 
     std::mt19937 rnd;
@@ -84,7 +78,7 @@ int main()
     die_unless(stxxl::stream::check_sorted_runs(Runs, Cmp()));
 
     // merge the runs
-    stxxl::stream::runs_merger<SortedRunsType, Cmp> merger(Runs, Cmp(), 10 * megabyte);
+    stxxl::stream::runs_merger<SortedRunsType, Cmp> merger(Runs, Cmp(), merger_memory);
     stxxl::vector<value_type, 4, stxxl::lru_pager<8> > array;
     LOG1 << input_size << " " << Runs->elements;
     LOG1 << "checksum before: " << checksum_before;
@@ -99,6 +93,26 @@ int main()
     die_unless(stxxl::is_sorted(array.cbegin(), array.cend(), Cmp()));
     die_unless(checksum_before == checksum_after);
     die_unless(merger.empty());
+}
+
+int main()
+{
+#if STXXL_PARALLEL_MULTIWAY_MERGE
+    LOG1 << "STXXL_PARALLEL_MULTIWAY_MERGE";
+#endif
+
+    unsigned input_size = (10 * megabyte / sizeof(value_type));
+
+    test_push_sort(input_size, 10 * megabyte, 10 * megabyte);
+
+    // many small runs force recursive merging, which then reuses the blocks
+    // of the merged runs for its output. The second sort allocates blocks
+    // again, which exposes blocks freed twice by the first one.
+    stxxl::SETTINGS::recycle_merge_blocks = true;
+    test_push_sort(input_size, 256 * 1024, 128 * 1024);
+    test_push_sort(input_size, 256 * 1024, 128 * 1024);
+    stxxl::SETTINGS::recycle_merge_blocks = false;
+    test_push_sort(input_size, 256 * 1024, 128 * 1024);
 
     return 0;
 }
@@ -0,0 +1,93 @@
+/***************************************************************************
+ *  tests/stream/test_semi_join.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_semi_join.cpp
+//! This is an example of how to prefilter a large stream by a small key set
+//! with \c stxxl::stream::bloom_filter_semi_join
+
+#include <random>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using key_type = uint64_t;
+using value_type = std::pair<key_type, uint64_t>;
+using vector_type = stxxl::vector<value_type>;
+using filter_type = stxxl::blocked_bloom_filter<key_type>;
+
+struct key_extractor
+{
+    key_type operator () (const value_type& v) const { return v.first; }
+};
+
+void test_semi_join(size_t nkeys, size_t n)
+{
+    LOG1 << "nkeys=" << nkeys << " n=" << n;
+
+    std::mt19937_64 rng(nkeys + n);
+    std::uniform_int_distribution<key_type> distr(0, 1000 * nkeys);
+
+    std::vector<key_type> keys(nkeys);
+    for (key_type& k : keys)
+        k = distr(rng);
+    std::unordered_set<key_type> key_set(keys.begin(), keys.end());
+
+    filter_type filter(nkeys);
+    auto key_stream = stxxl::stream::streamify(keys.begin(), keys.end());
+    filter.insert_stream(key_stream);
+
+    // every tenth element has a partner
+    vector_type big(n);
+    size_t nmatching = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const key_type k = (i % 10 == 0) ? keys[i % nkeys] : distr(rng);
+        big[i] = value_type(k, i);
+        nmatching += key_set.count(k);
+    }
+
+    auto in = stxxl::stream::streamify(big.cbegin(), big.cend());
+    stxxl::stream::bloom_filter_semi_join<decltype(in), key_extractor, filter_type>
+    semi_join(in, filter);
+
+    size_t npassed = 0, nfound = 0;
+    uint64_t prev = 0;
+    for ( ; !semi_join.empty(); ++semi_join, ++npassed)
+    {
+        // order is preserved
+        die_unless(npassed == 0 || prev < semi_join->second);
+        prev = semi_join->second;
+        nfound += key_set.count(semi_join->first);
+    }
+
+    LOG1 << "matching=" << nmatching << " passed=" << npassed
+         << " filter bytes=" << filter.size_bytes();
+
+    // no false negatives, few false positives
+    die_unless(nfound == nmatching);
+    die_unless(npassed - nmatching <= (n - nmatching) / 20);
+}
+
+int main()
+{
+    test_semi_join(1, 1000);
+    test_semi_join(1000, 100000);
+    test_semi_join(100000, 1000000);
+
+    return 0;
+}
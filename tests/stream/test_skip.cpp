@@ -0,0 +1,94 @@
+/***************************************************************************
+ *  tests/stream/test_skip.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_skip.cpp
+//! This is an example of how to read pages of a vector with
+//! \c stxxl::stream::skip
+
+#include <algorithm>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+using sr_stream_type = stxxl::stream::vector_iterator2stream_sr<
+          vector_type::const_iterator>;
+
+//! read pages of page_size elements after skipping gap elements each
+template <typename Stream>
+void test_pages(Stream& in, size_t begin, size_t n, size_t page_size, size_t gap)
+{
+    size_t pos = begin;
+    while (!in.empty())
+    {
+        for (size_t i = 0; i < page_size && !in.empty(); ++i, ++in, ++pos)
+            die_unless(*in == pos);
+
+        const size_t skipped = stxxl::stream::skip(in, gap);
+        die_unless(skipped == std::min(gap, n - pos));
+        pos += skipped;
+    }
+    die_unless(pos == n);
+}
+
+int main()
+{
+    const size_t block_size = vector_type::block_type::size;
+    const size_t n = 100 * block_size + 13;
+
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+
+    const size_t gaps[] = { 0, 1, block_size - 3, block_size, 7 * block_size + 5 };
+
+    for (size_t gap : gaps)
+    {
+        LOG1 << "gap=" << gap;
+        {
+            auto in = stxxl::stream::streamify(v.cbegin() + 5, v.cend());
+            test_pages(in, 5, n, 100, gap);
+        }
+        {
+            sr_stream_type in(v.cbegin(), v.cend());
+            test_pages(in, 0, n, block_size + 1, gap);
+        }
+        {
+            // small range served by iterator2stream
+            sr_stream_type in(v.cbegin() + 7, v.cbegin() + 107);
+            test_pages(in, 7, 107, 10, gap);
+        }
+        {
+            // generic streams are advanced element-wise
+            stxxl::stream::counter<value_type> counter;
+            die_unless(stxxl::stream::skip(counter, gap) == gap);
+            die_unless(*counter == gap);
+        }
+    }
+
+    {
+        // skipping everything ends the stream
+        auto in = stxxl::stream::streamify(v.cbegin(), v.cend());
+        die_unless(stxxl::stream::skip(in, 2 * n) == n);
+        die_unless(in.empty());
+
+        auto in2 = stxxl::stream::streamify(v.cbegin(), v.cend());
+        stxxl::stream::discard(in2);
+        die_unless(in2.empty());
+    }
+
+    return 0;
+}
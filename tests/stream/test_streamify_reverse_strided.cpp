@@ -0,0 +1,119 @@
+/***************************************************************************
+ *  tests/stream/test_streamify_reverse_strided.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_streamify_reverse_strided.cpp
+//! This is an example of how to read a vector backwards with
+//! \c stxxl::stream::streamify_reverse and every k-th value with
+//! \c stxxl::stream::streamify_strided
+
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io/iostats.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+
+template <typename Stream>
+void check_reverse(Stream& in, size_t begin, size_t end)
+{
+    size_t pos = end;
+    for ( ; !in.empty(); ++in)
+        die_unequal(*in, --pos);
+    die_unequal(pos, begin);
+}
+
+void test_strided(const vector_type& v, size_t begin, size_t end, size_t stride)
+{
+    const size_t block_size = vector_type::block_type::size;
+
+    // the blocks containing the selected values
+    size_t nblocks = 0;
+    for (size_t pos = begin; pos < end; pos += stride)
+    {
+        if (pos == begin || pos / block_size != (pos - stride) / block_size)
+            ++nblocks;
+    }
+
+    foxxll::stats_data before(*foxxll::stats::get_instance());
+
+    size_t pos = begin;
+    {
+        auto in = stxxl::stream::streamify_strided(
+            v.cbegin() + begin, v.cbegin() + end, stride);
+        for ( ; !in.empty(); ++in, pos += stride)
+            die_unequal(*in, pos);
+    }
+    die_unless(pos >= end && pos < end + stride);
+
+    foxxll::stats_data after(*foxxll::stats::get_instance());
+    LOG1 << "stride=" << stride << " blocks=" << nblocks
+         << " reads=" << (after - before).get_read_count();
+    die_unequal((after - before).get_read_count(), nblocks);
+}
+
+int main()
+{
+    const size_t block_size = vector_type::block_type::size;
+    const size_t n = 100 * block_size + 13;
+
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+
+    // generic iterators
+    {
+        std::vector<value_type> w(v.cbegin(), v.cbegin() + 1000);
+        auto in = stxxl::stream::streamify_reverse(w.begin(), w.end());
+        check_reverse(in, 0, 1000);
+    }
+
+    // reverse ranges within one block and across blocks, partial at both ends
+    {
+        auto in = stxxl::stream::streamify_reverse(v.cbegin(), v.cend());
+        check_reverse(in, 0, n);
+    }
+    {
+        auto in = stxxl::stream::streamify_reverse(v.begin() + 5, v.begin() + 17);
+        check_reverse(in, 5, 17);
+    }
+    {
+        auto in = stxxl::stream::streamify_reverse(
+            v.cbegin() + block_size - 3, v.cbegin() + 3 * block_size);
+        check_reverse(in, block_size - 3, 3 * block_size);
+    }
+    {
+        auto in = stxxl::stream::streamify_reverse(v.cbegin() + 7, v.cbegin() + 7);
+        die_unless(in.empty());
+    }
+
+    // strided ranges read only the blocks they need
+    v.flush();
+
+    const size_t strides[] = {
+        1, 3, block_size - 1, block_size, block_size + 1, 10 * block_size + 7
+    };
+    for (size_t stride : strides)
+    {
+        test_strided(v, 0, n, stride);
+        test_strided(v, 11, n - 5, stride);
+    }
+    test_strided(v, 9, 9, 2);
+
+    LOG1 << "Test passed.";
+    return 0;
+}
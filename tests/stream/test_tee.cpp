@@ -0,0 +1,112 @@
+/***************************************************************************
+ *  tests/stream/test_tee.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example stream/test_tee.cpp
+//! This is an example of how to read one stream with several consumers
+//! using \c stxxl::stream::tee
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+using input_type = stxxl::stream::counter<value_type>;
+
+//! stream of the first n numbers
+class first_n
+{
+public:
+    using value_type = ::value_type;
+
+    explicit first_n(size_t n) : m_counter(0), m_n(n) { }
+
+    const value_type& operator * () const { return *m_counter; }
+
+    first_n& operator ++ ()
+    {
+        ++m_counter;
+        return *this;
+    }
+
+    bool empty() const { return *m_counter >= m_n; }
+
+private:
+    input_type m_counter;
+    size_t m_n;
+};
+
+//! consumers advancing in lock step need no spilling
+void test_lock_step(size_t n, size_t k)
+{
+    first_n input(n);
+    stxxl::stream::tee<first_n> t(input, k, 16 * sizeof(value_type));
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t c = 0; c < k; ++c)
+        {
+            die_unless(!t.consumer(c).empty());
+            die_unless(*t.consumer(c) == i);
+            ++t.consumer(c);
+        }
+    }
+
+    for (size_t c = 0; c < k; ++c)
+        die_unless(t.consumer(c).empty());
+
+    die_unless(t.spilled() == 0);
+}
+
+//! the first consumer runs ahead, the others follow at different speeds
+void test_diverging(size_t n, size_t window)
+{
+    first_n input(n);
+    stxxl::stream::tee<first_n> t(input, 3, window * sizeof(value_type));
+
+    auto& fast = t.consumer(0);
+    auto& medium = t.consumer(1);
+    auto& slow = t.consumer(2);
+
+    for (size_t i = 0; i < n / 2; ++i, ++fast)
+        die_unless(*fast == i);
+
+    for (size_t i = 0; i < n / 4; ++i, ++medium)
+        die_unless(*medium == i);
+
+    for (size_t i = n / 2; i < n; ++i, ++fast)
+        die_unless(*fast == i);
+    die_unless(fast.empty());
+
+    for (size_t i = 0; i < n; ++i, ++slow)
+        die_unless(*slow == i);
+    die_unless(slow.empty());
+
+    for (size_t i = n / 4; i < n; ++i, ++medium)
+        die_unless(*medium == i);
+    die_unless(medium.empty());
+
+    LOG1 << "n=" << n << " window=" << window << " spilled=" << t.spilled();
+    die_unless(n <= window || t.spilled() == n - window);
+}
+
+int main()
+{
+    test_lock_step(0, 2);
+    test_lock_step(1000, 1);
+    test_lock_step(100000, 4);
+
+    test_diverging(1000, 2000);
+    test_diverging(1000000, 1000);
+
+    return 0;
+}
@@ -0,0 +1,811 @@
+/***************************************************************************
+ *  tools/sort_file.cpp
+ *
+ *  Sort a file of fixed-width binary records or of text lines.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+/*
+ * The input is read in batches, which are parsed into records by parallel
+ * threads and pushed into a stxxl::sorter, which forms the sorted runs. The
+ * merged output is streamed directly into the output file.
+ *
+ * Records are kept in fixed-size slots. For binary records the size class is
+ * chosen from the record size. For text it is chosen from the distribution
+ * of the line lengths: lines longer than the slot only keep the start of
+ * their key and their position in the input, they are read again from the
+ * input when the output is written. Long lines whose keys are equal in the
+ * part kept are ordered by their full keys at that point, which requires the
+ * longest line and each such run of lines to fit into internal memory. Each
+ * record carries an order preserving 64-bit prefix of its key, such that most
+ * comparisons do not touch the record's data.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/timer.hpp>
+
+#include <stxxl/bits/common/cmdline.h>
+#include <stxxl/bits/config.h>
+#include <stxxl/bits/parallel.h>
+#include <stxxl/sorter>
+
+using foxxll::external_size_type;
+
+namespace {
+
+//! how the key of a record is interpreted
+enum class key_type { unsigned_int, signed_int, bytes, number };
+
+//! parameters of the sort
+struct sort_options
+{
+    //! text lines instead of binary records
+    bool text = false;
+    //! size of a binary record
+    size_t record_size = 0;
+    //! position and width of the key in a binary record
+    size_t key_offset = 0, key_width = 0;
+    //! text field containing the key, 1-based, 0 is the whole line
+    size_t field = 0;
+    //! separator of the text fields
+    char delimiter = '\t';
+    //! interpretation of the key
+    key_type type = key_type::bytes;
+    //! sort in descending order
+    bool reverse = false;
+    //! number of records parsed in parallel
+    size_t batch_size = 0;
+    //! memory of the sorter
+    size_t memory = 0;
+    //! length of the longest line of a text input
+    size_t longest_line = 0;
+};
+
+//! the slot sizes of records
+const size_t slot_sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 4096, 16384 };
+const size_t num_slot_sizes = sizeof(slot_sizes) / sizeof(slot_sizes[0]);
+
+//! A record in a slot of Capacity bytes. A text line longer than the slot
+//! keeps only the start of its key in data.
+template <size_t Capacity>
+struct sort_record
+{
+    static constexpr size_t capacity = Capacity;
+
+    //! order preserving prefix of the key, or the whole numeric key
+    uint64_t prefix;
+    //! position of a text line in the input
+    uint64_t offset;
+    //! length of the record
+    uint32_t length;
+    //! position of the key in the record and its full length
+    uint32_t key_begin, key_length;
+    //! orders the sentinels before and after all records
+    uint8_t rank;
+    //! contents of the record, or the start of the key of a long line
+    char data[Capacity];
+
+    //! whether the record is a text line not held in data
+    bool is_long() const { return length > Capacity; }
+
+    //! start of the key in data
+    const char* key() const { return is_long() ? data : data + key_begin; }
+
+    //! number of key bytes in data
+    uint32_t key_held() const
+    { return std::min(key_length, static_cast<uint32_t>(Capacity)); }
+};
+
+template <typename Record>
+class record_less
+{
+public:
+    record_less(bool numeric, bool reverse)
+        : m_numeric(numeric), m_reverse(reverse) { }
+
+    bool operator () (const Record& a, const Record& b) const
+    {
+        if (a.rank != b.rank)
+            return a.rank < b.rank;
+        return m_reverse ? less(b, a) : less(a, b);
+    }
+
+    Record min_value() const
+    {
+        Record r = Record();
+        r.rank = 0;
+        return r;
+    }
+
+    Record max_value() const
+    {
+        Record r = Record();
+        r.rank = 2;
+        return r;
+    }
+
+    //! compares two full keys like operator ()
+    bool operator () (const char* a, size_t a_length,
+                      const char* b, size_t b_length) const
+    {
+        return m_reverse ? less(b, b_length, a, a_length)
+               : less(a, a_length, b, b_length);
+    }
+
+private:
+    bool m_numeric, m_reverse;
+
+    static bool less(const char* a, size_t a_length,
+                     const char* b, size_t b_length)
+    {
+        const int c = std::memcmp(a, b, std::min(a_length, b_length));
+        if (c != 0)
+            return c < 0;
+        return a_length < b_length;
+    }
+
+    bool less(const Record& a, const Record& b) const
+    {
+        if (a.prefix != b.prefix)
+            return a.prefix < b.prefix;
+        if (m_numeric)
+            return false;
+
+        // keys longer than the slot are equal if their held parts are, they
+        // are ordered by file_sorter::write()
+        const uint32_t a_length = std::min<uint32_t>(a.key_length, Record::capacity + 1);
+        const uint32_t b_length = std::min<uint32_t>(b.key_length, Record::capacity + 1);
+        const int c = std::memcmp(
+            a.key(), b.key(), std::min(a.key_held(), b.key_held()));
+        if (c != 0)
+            return c < 0;
+        return a_length < b_length;
+    }
+};
+
+//! big-endian value of the first 8 bytes of a key, padded with zeros
+uint64_t bytes_prefix(const char* key, size_t length)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        prefix <<= 8;
+        if (i < length)
+            prefix |= static_cast<unsigned char>(key[i]);
+    }
+    return prefix;
+}
+
+//! order preserving mapping of a little-endian integer to uint64_t
+uint64_t integer_prefix(const char* key, size_t width, bool is_signed)
+{
+    uint64_t value = 0;
+    for (size_t i = width; i-- > 0; )
+        value = (value << 8) | static_cast<unsigned char>(key[i]);
+    if (!is_signed)
+        return value;
+
+    // sign-extend, then move negative values below the positive ones
+    const size_t shift = 64 - 8 * width;
+    const int64_t signed_value = static_cast<int64_t>(value << shift) >> shift;
+    return static_cast<uint64_t>(signed_value) ^ (uint64_t(1) << 63);
+}
+
+//! order preserving mapping of a number in text to uint64_t, text which is
+//! no number is read as 0 like by sort -n
+uint64_t number_prefix(const char* key, size_t length)
+{
+    char buffer[64];
+    length = std::min(length, sizeof(buffer) - 1);
+    std::memcpy(buffer, key, length);
+    buffer[length] = 0;
+
+    double value = std::strtod(buffer, nullptr);
+    if (value == 0)
+        value = 0; // merges -0.0 and 0.0
+
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if (bits & (uint64_t(1) << 63))
+        return ~bits;
+    return bits | (uint64_t(1) << 63);
+}
+
+//! the prefix of a key
+uint64_t key_prefix(const char* key, size_t length, const sort_options& opt)
+{
+    switch (opt.type)
+    {
+    case key_type::unsigned_int:
+        return integer_prefix(key, length, false);
+    case key_type::signed_int:
+        return integer_prefix(key, length, true);
+    case key_type::bytes:
+        return bytes_prefix(key, length);
+    case key_type::number:
+        return number_prefix(key, length);
+    }
+    return 0;
+}
+
+//! copies a binary record
+template <typename Record>
+void parse_binary(Record& r, const char* input, const sort_options& opt)
+{
+    r.rank = 1;
+    r.offset = 0;
+    r.length = static_cast<uint32_t>(opt.record_size);
+    std::memcpy(r.data, input, opt.record_size);
+    r.key_begin = static_cast<uint32_t>(opt.key_offset);
+    r.key_length = static_cast<uint32_t>(opt.key_width);
+    r.prefix = key_prefix(r.data + r.key_begin, r.key_length, opt);
+}
+
+//! finds the key field of a text line
+void find_key(const char* line, size_t length, const sort_options& opt,
+              size_t& begin, size_t& end)
+{
+    begin = 0, end = length;
+    if (opt.field != 0)
+    {
+        for (size_t f = 1; f < opt.field && begin < length; ++f)
+        {
+            const void* next = std::memchr(line + begin, opt.delimiter, length - begin);
+            begin = next ? static_cast<const char*>(next) - line + 1 : length;
+        }
+        const void* next = std::memchr(line + begin, opt.delimiter, length - begin);
+        end = next ? static_cast<const char*>(next) - line : length;
+    }
+}
+
+//! copies a text line at offset of the input, or the start of its key if the
+//! line does not fit the slot
+template <typename Record>
+void parse_line(Record& r, const char* line, size_t length,
+                external_size_type offset, const sort_options& opt)
+{
+    size_t begin, end;
+    find_key(line, length, opt, begin, end);
+
+    r.rank = 1;
+    r.offset = offset;
+    r.length = static_cast<uint32_t>(length);
+    r.key_begin = static_cast<uint32_t>(begin);
+    r.key_length = static_cast<uint32_t>(end - begin);
+    r.prefix = key_prefix(line + begin, end - begin, opt);
+
+    if (r.is_long())
+        std::memcpy(r.data, line + begin, r.key_held());
+    else
+        std::memcpy(r.data, line, length);
+}
+
+//! lengths of the lines of a text file
+struct line_stats
+{
+    size_t longest = 0;
+    external_size_type num_lines = 0;
+    //! number and total length of the lines longer than each slot size
+    external_size_type num_longer[num_slot_sizes] = { };
+    external_size_type bytes_longer[num_slot_sizes] = { };
+
+    void add(size_t length)
+    {
+        longest = std::max(longest, length);
+        ++num_lines;
+        for (size_t i = 0; i < num_slot_sizes && length > slot_sizes[i]; ++i)
+        {
+            ++num_longer[i];
+            bytes_longer[i] += length;
+        }
+    }
+};
+
+//! collects the line lengths of the file, returns false on a read error
+bool scan_lines(std::FILE* in, line_stats& stats)
+{
+    std::vector<char> buffer(4 * 1024 * 1024);
+    size_t current = 0;
+    size_t n;
+    while ((n = std::fread(buffer.data(), 1, buffer.size(), in)) > 0)
+    {
+        const char* p = buffer.data(), * end = p + n;
+        while (const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p)))
+        {
+            stats.add(current + (nl - p));
+            current = 0;
+            p = nl + 1;
+        }
+        current += end - p;
+    }
+    if (std::ferror(in))
+        return false;
+
+    if (current != 0)
+        stats.add(current);
+    std::rewind(in);
+    return true;
+}
+
+/*!
+ * Chooses the slot size for text lines. Every line takes a slot, lines longer
+ * than the slot are additionally read again from the input, which is counted
+ * as a random access plus their length.
+ */
+size_t text_slot_size(const line_stats& stats)
+{
+    // bytes of sequential I/O which take as long as a random access
+    const double seek_cost = 64 * 1024;
+    const size_t header = sizeof(sort_record<16>) - 16;
+
+    size_t best = 0;
+    double best_cost = 0;
+    for (size_t i = 0; i < num_slot_sizes; ++i)
+    {
+        const double cost =
+            static_cast<double>(stats.num_lines) * static_cast<double>(slot_sizes[i] + header)
+            + static_cast<double>(stats.num_longer[i]) * seek_cost
+            + static_cast<double>(stats.bytes_longer[i]);
+        if (i == 0 || cost < best_cost)
+            best = i, best_cost = cost;
+        if (stats.num_longer[i] == 0)
+            break;
+    }
+
+    LOG1 << "Using slots of " << slot_sizes[best] << " bytes, "
+         << stats.num_longer[best] << " longer lines are read again";
+    return slot_sizes[best];
+}
+
+//! reads length bytes at offset of the file
+bool read_at(std::FILE* in, external_size_type offset, size_t length, char* data)
+{
+#if STXXL_WINDOWS
+    if (_fseeki64(in, static_cast<__int64>(offset), SEEK_SET) != 0)
+        return false;
+#else
+    if (fseeko(in, static_cast<off_t>(offset), SEEK_SET) != 0)
+        return false;
+#endif
+    return std::fread(data, 1, length, in) == length;
+}
+
+template <typename Record>
+class file_sorter
+{
+public:
+    using sorter_type = stxxl::sorter<Record, record_less<Record> >;
+
+    explicit file_sorter(const sort_options& opt)
+        : m_opt(opt),
+          m_less(opt.type == key_type::number, opt.reverse),
+          m_sorter(m_less, opt.memory),
+          m_batch(opt.batch_size)
+    { }
+
+    //! reads, parses and pushes all records of the input, returns false on
+    //! malformed input or read errors
+    bool read(std::FILE* in)
+    {
+        return m_opt.text ? read_text(in) : read_binary(in);
+    }
+
+    //! writes the records in sorted order, long lines are read again from
+    //! the input
+    bool write(std::FILE* out, std::FILE* in)
+    {
+        std::vector<char> line;
+        std::vector<std::vector<char> > group;
+
+        m_sorter.sort();
+        while (!m_sorter.empty())
+        {
+            const Record& r = *m_sorter;
+            if (!r.is_long())
+            {
+                if (!write_line(out, r.data, r.length))
+                    return false;
+                ++m_sorter;
+            }
+            else if (r.key_length <= Record::capacity || m_opt.type == key_type::number)
+            {
+                line.resize(r.length);
+                if (!read_at(in, r.offset, r.length, line.data()) ||
+                    !write_line(out, line.data(), r.length))
+                    return false;
+                ++m_sorter;
+            }
+            else if (!write_long_keys(out, in, group))
+                return false;
+        }
+        return true;
+    }
+
+    external_size_type size() const
+    {
+        return m_sorter.size();
+    }
+
+private:
+    const sort_options& m_opt;
+    record_less<Record> m_less;
+    sorter_type m_sorter;
+    std::vector<Record> m_batch;
+
+    void push_batch(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            m_sorter.push(m_batch[i]);
+    }
+
+    bool write_line(std::FILE* out, const char* data, size_t length)
+    {
+        if (std::fwrite(data, 1, length, out) != length)
+            return false;
+        return !m_opt.text || std::fputc('\n', out) != EOF;
+    }
+
+    //! writes the run of lines whose keys are longer than the slot and equal
+    //! in the part held, ordered by their full keys. The run is held in
+    //! internal memory.
+    bool write_long_keys(std::FILE* out, std::FILE* in,
+                         std::vector<std::vector<char> >& group)
+    {
+        const Record first = *m_sorter;
+        group.clear();
+        for ( ; !m_sorter.empty() && m_sorter->key_length > Record::capacity &&
+              !m_less(first, *m_sorter); ++m_sorter)
+        {
+            group.emplace_back(m_sorter->length);
+            if (!read_at(in, m_sorter->offset, m_sorter->length, group.back().data()))
+                return false;
+        }
+
+        std::stable_sort(
+            group.begin(), group.end(),
+            [this](const std::vector<char>& a, const std::vector<char>& b) {
+                size_t a_begin, a_end, b_begin, b_end;
+                find_key(a.data(), a.size(), m_opt, a_begin, a_end);
+                find_key(b.data(), b.size(), m_opt, b_begin, b_end);
+                return m_less(a.data() + a_begin, a_end - a_begin,
+                              b.data() + b_begin, b_end - b_begin);
+            });
+
+        for (const std::vector<char>& l : group)
+        {
+            if (!write_line(out, l.data(), l.size()))
+                return false;
+        }
+        return true;
+    }
+
+    bool read_binary(std::FILE* in)
+    {
+        const size_t record_size = m_opt.record_size;
+        std::vector<char> buffer(m_batch.size() * record_size);
+
+        size_t n;
+        while ((n = std::fread(buffer.data(), 1, buffer.size(), in)) > 0)
+        {
+            if (n % record_size != 0)
+            {
+                LOG1 << "The input size is not a multiple of the record size.";
+                return false;
+            }
+            const long num_records = static_cast<long>(n / record_size);
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+            for (long i = 0; i < num_records; ++i)
+                parse_binary(m_batch[i], buffer.data() + i * record_size, m_opt);
+
+            push_batch(static_cast<size_t>(num_records));
+        }
+        if (std::ferror(in))
+        {
+            LOG1 << "Error reading the input: " << strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool read_text(std::FILE* in)
+    {
+        // the buffer holds at least one line, including the longest
+        std::vector<char> buffer(4 * 1024 * 1024 + m_opt.longest_line + 1);
+        std::vector<size_t> line_begin;
+        size_t filled = 0;
+        // position of the buffer in the input
+        external_size_type offset = 0;
+
+        while (true)
+        {
+            const size_t n = std::fread(
+                buffer.data() + filled, 1, buffer.size() - filled, in);
+            if (n == 0 && std::ferror(in))
+            {
+                LOG1 << "Error reading the input: " << strerror(errno);
+                return false;
+            }
+            const bool eof = (n == 0);
+            filled += n;
+
+            // find the complete lines, and the last one at the end of file
+            line_begin.clear();
+            const char* begin = buffer.data();
+            const char* p = begin, * end = begin + filled;
+            line_begin.push_back(0);
+            while (const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p)))
+            {
+                p = nl + 1;
+                line_begin.push_back(p - begin);
+            }
+            if (eof && p != end)
+                line_begin.push_back(filled + 1);
+
+            const size_t num_lines = line_begin.size() - 1;
+            for (size_t first = 0; first < num_lines; first += m_batch.size())
+            {
+                const long count = static_cast<long>(
+                    std::min(m_batch.size(), num_lines - first));
+
+#if STXXL_PARALLEL
+#pragma omp parallel for
+#endif
+                for (long i = 0; i < count; ++i)
+                {
+                    const size_t b = line_begin[first + i];
+                    const size_t e = line_begin[first + i + 1] - 1;
+                    parse_line(m_batch[i], begin + b, e - b, offset + b, m_opt);
+                }
+
+                push_batch(static_cast<size_t>(count));
+            }
+
+            if (eof)
+                return true;
+
+            // keep the incomplete line
+            const size_t used = std::min(line_begin.back(), filled);
+            std::memmove(buffer.data(), buffer.data() + used, filled - used);
+            filled -= used;
+            offset += used;
+        }
+    }
+};
+
+template <size_t Capacity>
+int sort_file(const sort_options& opt, std::FILE* in, const std::string& output)
+{
+    using record_type = sort_record<Capacity>;
+
+    sort_options options = opt;
+    if (options.batch_size == 0)
+    {
+        options.batch_size = std::max<size_t>(
+            1, std::min<size_t>(opt.memory / 8, 64 * 1024 * 1024) / sizeof(record_type));
+    }
+    // the batch and the input buffer are taken from the sorter's memory
+    options.memory -= std::min(
+        options.memory / 2, 2 * options.batch_size * sizeof(record_type));
+
+    foxxll::timer timer(true);
+
+    file_sorter<record_type> sorter(options);
+    if (!sorter.read(in))
+        return -1;
+
+    const external_size_type size = sorter.size();
+    LOG1 << "Formed runs of " << size << " records in "
+         << timer.seconds() << " s";
+
+    std::FILE* out = std::fopen(output.c_str(), "wb");
+    if (!out)
+    {
+        LOG1 << "Cannot open output file " << output << ": " << strerror(errno);
+        return -1;
+    }
+    std::vector<char> out_buffer(4 * 1024 * 1024);
+    std::setvbuf(out, out_buffer.data(), _IOFBF, out_buffer.size());
+
+    const bool written = sorter.write(out, in);
+    if (std::fclose(out) != 0 || !written)
+    {
+        LOG1 << "Error writing output file " << output << ": " << strerror(errno);
+        return -1;
+    }
+
+    LOG1 << "Sorted " << size << " records in "
+         << timer.seconds() << " s";
+    return 0;
+}
+
+//! runs sort_file() with the smallest slot size holding records of size
+int sort_file_dispatch(const sort_options& opt, size_t size,
+                       std::FILE* in, const std::string& output)
+{
+    if (size <= 16)
+        return sort_file<16>(opt, in, output);
+    if (size <= 32)
+        return sort_file<32>(opt, in, output);
+    if (size <= 64)
+        return sort_file<64>(opt, in, output);
+    if (size <= 128)
+        return sort_file<128>(opt, in, output);
+    if (size <= 256)
+        return sort_file<256>(opt, in, output);
+    if (size <= 512)
+        return sort_file<512>(opt, in, output);
+    if (size <= 1024)
+        return sort_file<1024>(opt, in, output);
+    if (size <= 4096)
+        return sort_file<4096>(opt, in, output);
+    if (size <= 16384)
+        return sort_file<16384>(opt, in, output);
+
+    LOG1 << "Records of " << size << " bytes are not supported, "
+         << "the maximum is 16 KiB.";
+    return -1;
+}
+
+} // namespace
+
+int do_sort(int argc, char* argv[])
+{
+    // parse command line
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(
+        "Sort a file of fixed-width binary records or of newline-delimited "
+        "text lines. Records are parsed by parallel threads, sorted using all "
+        "disks configured for STXXL and written to the output file. Without "
+        "--record-size, the input is sorted as text lines.");
+
+    std::string input, output;
+    cp.add_param_string("input", input, "File to sort");
+    cp.add_param_string("output", output, "File to write the sorted records to");
+
+    unsigned record_size = 0, key_offset = 0, key_width = 0;
+    cp.add_uint('s', "record-size", record_size,
+                "Size of the binary records in bytes");
+    cp.add_uint('o', "key-offset", key_offset,
+                "Offset of the key in a binary record, default: 0");
+    cp.add_uint('w', "key-width", key_width,
+                "Width of the key in a binary record in bytes, default: 8 for "
+                "integers, the rest of the record otherwise");
+
+    std::string type = "bytes";
+    cp.add_string('t', "key-type", type,
+                  "Type of the key: uint or int (little-endian integers of "
+                  "1, 2, 4 or 8 bytes), bytes (lexicographic), or number "
+                  "(decimal number in text), default: bytes");
+
+    unsigned field = 0;
+    cp.add_uint('k', "field", field,
+                "Text field containing the key, starting at 1, default: the "
+                "whole line");
+
+    std::string delimiter = "\t";
+    cp.add_string('d', "delimiter", delimiter,
+                  "Character separating the text fields, default: tab");
+
+    bool numeric = false;
+    cp.add_flag('n', "numeric", numeric,
+                "Compare text keys as decimal numbers, same as --key-type number");
+
+    bool reverse = false;
+    cp.add_flag('r', "reverse", reverse, "Sort in descending order");
+
+    size_t memory = 1024 * 1024 * 1024;
+    cp.add_bytes('M', "ram", memory,
+                 "Amount of RAM to use when sorting, default: 1 GiB");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    sort_options opt;
+    opt.text = (record_size == 0);
+    opt.record_size = record_size;
+    opt.key_offset = key_offset;
+    opt.field = field;
+    opt.reverse = reverse;
+    opt.memory = memory;
+
+    if (type == "uint")
+        opt.type = key_type::unsigned_int;
+    else if (type == "int")
+        opt.type = key_type::signed_int;
+    else if (type == "bytes")
+        opt.type = numeric ? key_type::number : key_type::bytes;
+    else if (type == "number")
+        opt.type = key_type::number;
+    else {
+        LOG1 << "Unknown key type " << type;
+        return -1;
+    }
+
+    if (delimiter.size() != 1)
+    {
+        LOG1 << "The delimiter must be a single character.";
+        return -1;
+    }
+    opt.delimiter = delimiter[0];
+
+    if (opt.text)
+    {
+        if (opt.type == key_type::unsigned_int || opt.type == key_type::signed_int)
+        {
+            LOG1 << "Integer keys are only supported for binary records, "
+                 << "use --key-type number for text.";
+            return -1;
+        }
+    }
+    else
+    {
+        if (opt.type == key_type::number)
+        {
+            LOG1 << "Number keys are only supported for text.";
+            return -1;
+        }
+        if (opt.type == key_type::unsigned_int || opt.type == key_type::signed_int)
+            opt.key_width = key_width ? key_width : 8;
+        else
+            opt.key_width = key_width ? key_width : record_size - std::min(key_offset, record_size);
+
+        if ((opt.type == key_type::unsigned_int || opt.type == key_type::signed_int) &&
+            opt.key_width != 1 && opt.key_width != 2 &&
+            opt.key_width != 4 && opt.key_width != 8)
+        {
+            LOG1 << "Integer keys must be 1, 2, 4 or 8 bytes wide.";
+            return -1;
+        }
+        if (opt.key_width == 0 || opt.key_offset + opt.key_width > opt.record_size)
+        {
+            LOG1 << "The key must lie within the record.";
+            return -1;
+        }
+    }
+
+    std::FILE* in = std::fopen(input.c_str(), "rb");
+    if (!in)
+    {
+        LOG1 << "Cannot open input file " << input << ": " << strerror(errno);
+        return -1;
+    }
+
+    size_t size = opt.record_size;
+    if (opt.text)
+    {
+        line_stats stats;
+        if (!scan_lines(in, stats))
+        {
+            LOG1 << "Error reading input file " << input << ": " << strerror(errno);
+            std::fclose(in);
+            return -1;
+        }
+        LOG1 << "Longest line has " << stats.longest << " bytes";
+        opt.longest_line = stats.longest;
+        size = text_slot_size(stats);
+    }
+
+    const int result = sort_file_dispatch(opt, size, in, output);
+    std::fclose(in);
+    return result;
+}
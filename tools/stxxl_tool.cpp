@@ -52,6 +52,7 @@ extern int benchmark_sort(int argc, char* argv[]);
 extern int benchmark_pqueue(int argc, char* argv[]);
 extern int do_mlock(int argc, char* argv[]);
 extern int do_mallinfo(int argc, char* argv[]);
+extern int do_sort(int argc, char* argv[]);
 
 struct SubTool
 {
@@ -75,6 +76,11 @@ struct SubTool subtools[] = {
         "benchmark_pqueue", &benchmark_pqueue, false,
         "Benchmark priority queue implementation using sequence of operations."
     },
+    {
+        "sort", &do_sort, false,
+        "Sort a file of fixed-width binary records or of text lines by a key, "
+        "using parallel threads for parsing and all disks for the runs."
+    },
     {
         "mlock", &do_mlock, true,
         "Lock physical memory."